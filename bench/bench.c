@@ -0,0 +1,1158 @@
+#include "catalog_cache.h"
+#include "catalog_merge.h"
+#include "draw.h"
+#include "filter.h"
+#include "model.h"
+#include "pkg_search.h"
+#include "search_worker.h"
+#include "sort_order.h"
+#include "synthetic.h"
+#include "thread_pool.h"
+#include "trigram.h"
+#include "utils.h"
+
+#include <dirent.h>
+#include <getopt.h>
+#include <linux/limits.h>
+#include <regex.h>
+#include <notcurses/notcurses.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/// @brief Version of the JSON layout, bump on any change
+#define BENCH_SCHEMA 1
+
+#define DEFAULT_REPEATS 7
+#define MAX_SIZES 16
+#define SEED 0x5eed
+
+// Rows of the offscreen list plane
+#define LIST_ROWS 40
+#define LIST_COLS 120
+
+// Packages updated, removed and installed each by the pkgdb patch benchmark
+#define PATCH_CHANGES 16
+
+// Every n-th package is installed in the upgrades benchmark, every other one
+// of those in an older version
+#define UPGRADES_INSTALLED 4
+
+static const uint32_t default_sizes[] = {1000, 10000, 50000, 200000};
+
+/* ============= Timing ============= */
+
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+  return (x > y) - (x < y);
+}
+
+typedef struct bench_t {
+  size_t repeats;
+  size_t threads; // Most threads of the scaling benchmark
+  bool first; // No result was printed yet
+
+} bench_t;
+
+// Print string as JSON, queries and names don't need more than this
+static void print_json_string(const char *str) {
+  putchar('"');
+  for (; *str; str++) {
+    if (*str == '"' || *str == '\\')
+      putchar('\\');
+    putchar(*str);
+  }
+  putchar('"');
+}
+
+// Print one result, `samples` are sorted in place
+static void report(bench_t *bench, const char *name, uint32_t packages,
+                   const char *param, uint64_t *samples, size_t count,
+                   uint64_t items) {
+  qsort(samples, count, sizeof(uint64_t), compare_u64);
+
+  printf("%s\n    {\"name\": ", bench->first ? "" : ",");
+  print_json_string(name);
+  printf(", \"packages\": %u, \"param\": ", packages);
+  print_json_string(param ? param : "");
+  printf(", \"repeats\": %zu, \"median_ns\": %llu, \"min_ns\": %llu, "
+         "\"max_ns\": %llu, \"items\": %llu}",
+         count, (unsigned long long)samples[count / 2],
+         (unsigned long long)samples[0],
+         (unsigned long long)samples[count - 1], (unsigned long long)items);
+
+  bench->first = false;
+  fflush(stdout);
+}
+
+/* ============= Catalog load ============= */
+
+// Resident set of the process in bytes, 0 if unknown
+static size_t resident_bytes(void) {
+  FILE *statm = fopen("/proc/self/statm", "r");
+  if (!statm)
+    return 0;
+
+  unsigned long size = 0, resident = 0;
+  if (fscanf(statm, "%lu %lu", &size, &resident) != 2)
+    resident = 0;
+  fclose(statm);
+
+  return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// Keep the most the resident set grew by since `before`
+static void track_growth(size_t before, size_t *grown) {
+  size_t after = resident_bytes();
+  if (after > before && after - before > *grown)
+    *grown = after - before;
+}
+
+// Details every package of a repository index carries
+#define LOAD_MAINTAINER "Orphaned <orphan@voidlinux.org>"
+#define LOAD_HOMEPAGE "https://example.org/project"
+#define LOAD_LICENSE "MIT"
+
+// How search callbacks stored packages before the catalog had arenas: array
+// grown by one element and every field strdup'd
+static void *load_strdup(const search_result_t *catalog) {
+  package_info_t *packages = NULL;
+  for (uint32_t i = 0; i < catalog->count; i++) {
+    package_info_t *grown = realloc(packages, (i + 1) * sizeof(*packages));
+    if (!grown)
+      break;
+    packages = grown;
+
+    const char *short_desc = search_result_short_desc(catalog, i);
+    packages[i] = (package_info_t){
+        .pkgver = strdup(search_result_pkgver(catalog, i)),
+        .short_desc = strdup(short_desc),
+        .long_desc = strdup(short_desc),
+        .maintainer = strdup(LOAD_MAINTAINER),
+        .homepage = strdup(LOAD_HOMEPAGE),
+        .license = strdup(LOAD_LICENSE),
+    };
+  }
+  return packages;
+}
+
+static void unload_strdup(void *loaded, uint32_t count) {
+  package_info_t *packages = loaded;
+  for (uint32_t i = 0; packages && i < count; i++) {
+    free(packages[i].pkgver);
+    free(packages[i].short_desc);
+    free(packages[i].long_desc);
+    free(packages[i].maintainer);
+    free(packages[i].homepage);
+    free(packages[i].license);
+  }
+  free(packages);
+}
+
+// What search callbacks store now, details are loaded on demand
+static search_result_t *load_catalog(const search_result_t *catalog) {
+  search_result_t *result = calloc(1, sizeof(search_result_t));
+  for (uint32_t i = 0; result && i < catalog->count; i++) {
+    package_entry_t *pkg =
+        search_result_append(result, search_result_pkgver(catalog, i),
+                             search_result_short_desc(catalog, i));
+    if (!pkg)
+      break;
+    pkg->state = catalog->packages[i].state;
+    pkg->installed_size = catalog->packages[i].installed_size;
+    pkg->install_date = catalog->packages[i].install_date;
+  }
+  return result;
+}
+
+static void *load_arena(const search_result_t *catalog) {
+  return load_catalog(catalog);
+}
+
+static void unload_arena(void *loaded, uint32_t count) {
+  (void)count;
+  search_result_cleanup(loaded);
+}
+
+// Offsets of the fields every package entry had before they were loaded on
+// demand, into `details` of the catalog
+typedef struct entry_details_t {
+  uint32_t long_desc;
+  uint32_t maintainer;
+  uint32_t homepage;
+  uint32_t license;
+
+} entry_details_t;
+
+typedef struct detailed_catalog_t {
+  search_result_t *catalog;
+  entry_details_t *details; // As many as the entries have room for
+
+} detailed_catalog_t;
+
+// Arena catalog that still copies details of every package, like it did
+// before `get_package_info` loaded them for the selected one
+static void *load_details(const search_result_t *catalog) {
+  detailed_catalog_t *loaded = calloc(1, sizeof(detailed_catalog_t));
+  search_result_t *result = loaded ? load_catalog(catalog) : NULL;
+  if (!result) {
+    free(loaded);
+    return NULL;
+  }
+  loaded->catalog = result;
+
+  entry_details_t *details =
+      malloc((result->cap > 0 ? result->cap : 1) * sizeof(entry_details_t));
+  for (uint32_t i = 0; details && i < result->count; i++) {
+    details[i] = (entry_details_t){
+        .long_desc = string_arena_push(&result->details,
+                                       search_result_short_desc(result, i)),
+        .maintainer = string_arena_push(&result->details, LOAD_MAINTAINER),
+        .homepage = string_arena_push(&result->details, LOAD_HOMEPAGE),
+        .license = string_arena_push(&result->details, LOAD_LICENSE),
+    };
+  }
+  loaded->details = details;
+  return loaded;
+}
+
+static void unload_details(void *loaded, uint32_t count) {
+  detailed_catalog_t *detailed = loaded;
+  (void)count;
+  if (!detailed)
+    return;
+
+  search_result_cleanup(detailed->catalog);
+  free(detailed->details);
+  free(detailed);
+}
+
+typedef void *(*load_fn)(const search_result_t *catalog);
+typedef void (*unload_fn)(void *loaded, uint32_t count);
+
+// Loading every package the way search callbacks do, items are the bytes the
+// resident set grew by while the catalog was alive, the most of all repeats.
+// Heap freed by earlier benchmarks is reused, run a single size per process
+// for exact numbers, e.g. `-s 15000`
+static void bench_load(bench_t *bench, const search_result_t *catalog,
+                       const char *name, load_fn load, unload_fn unload) {
+  uint64_t samples[bench->repeats];
+  size_t grown = 0;
+
+  for (size_t r = 0; r < bench->repeats; r++) {
+    size_t before = resident_bytes();
+    uint64_t start = now_ns();
+    void *loaded = load(catalog);
+    samples[r] = now_ns() - start;
+    track_growth(before, &grown);
+    unload(loaded, catalog->count);
+  }
+  report(bench, name, catalog->count, NULL, samples, bench->repeats, grown);
+}
+
+// From the smallest catalog to the largest, so that each one grows the heap
+static void bench_catalog_load(bench_t *bench,
+                               const search_result_t *catalog) {
+  bench_load(bench, catalog, "catalog/load/arena", load_arena, unload_arena);
+  bench_load(bench, catalog, "catalog/load/details", load_details,
+             unload_details);
+  bench_load(bench, catalog, "catalog/load/strdup", load_strdup,
+             unload_strdup);
+}
+
+/* ============= Startup ============= */
+
+// Cache files written by the benchmark, then the directories
+static void remove_cache(const char *dir) {
+  char xui[PATH_MAX];
+  snprintf(xui, sizeof(xui), "%s/xui", dir);
+
+  DIR *files = opendir(xui);
+  if (files) {
+    struct dirent *entry;
+    while ((entry = readdir(files))) {
+      if (entry->d_name[0] != '.')
+        unlinkat(dirfd(files), entry->d_name, 0);
+    }
+    closedir(files);
+  }
+
+  rmdir(xui);
+  rmdir(dir);
+}
+
+// Start without a catalog cache and with one: the catalog is either loaded
+// and written to the cache, or mapped from it. Cache lives in a temporary
+// $XDG_CACHE_HOME. Items are the bytes the resident set grew by
+static void bench_startup(bench_t *bench, const search_result_t *catalog) {
+  char dir[] = "/tmp/xui-bench.XXXXXX";
+  if (!mkdtemp(dir))
+    return;
+
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  char *saved = xdg ? strdup(xdg) : NULL;
+  setenv("XDG_CACHE_HOME", dir, 1);
+
+  uint64_t samples[bench->repeats];
+  size_t grown = 0;
+  bool cached = true;
+  for (size_t r = 0; r < bench->repeats; r++) {
+    size_t before = resident_bytes();
+    uint64_t start = now_ns();
+    search_result_t *result = load_catalog(catalog);
+    cached = cached && catalog_cache_write(result, SEED);
+    samples[r] = now_ns() - start;
+
+    track_growth(before, &grown);
+    search_result_cleanup(result);
+  }
+  report(bench, "startup/cold", catalog->count, NULL, samples,
+         bench->repeats, grown);
+
+  // Mapping checks every entry, faulting in the records and pkgvers
+  grown = 0;
+  for (size_t r = 0; cached && r < bench->repeats; r++) {
+    size_t before = resident_bytes();
+    uint64_t start = now_ns();
+    search_result_t *result = catalog_cache_map(catalog->repo_type, SEED);
+    samples[r] = now_ns() - start;
+
+    track_growth(before, &grown);
+    cached = result != NULL;
+    search_result_cleanup(result);
+  }
+  if (cached)
+    report(bench, "startup/warm", catalog->count, NULL, samples,
+           bench->repeats, grown);
+
+  remove_cache(dir);
+
+  if (saved)
+    setenv("XDG_CACHE_HOME", saved, 1);
+  else
+    unsetenv("XDG_CACHE_HOME");
+  free(saved);
+}
+
+/* ============= Filter ============= */
+
+// Every pass starts from the whole catalog
+static void bench_filter_fresh(bench_t *bench, const search_result_t *catalog,
+                               const trigram_index_t *index, const char *name,
+                               const char *query, MATCH_MODE mode) {
+  filter_t filter;
+  if (!filter_init(&filter, catalog, index))
+    return;
+
+  uint64_t samples[bench->repeats];
+  for (size_t r = 0; r < bench->repeats; r++) {
+    filter_reset(&filter);
+    uint64_t start = now_ns();
+    filter_run(&filter, query, mode);
+    samples[r] = now_ns() - start;
+  }
+
+  report(bench, name, catalog->count, query, samples, bench->repeats,
+         filter.count);
+  filter_cleanup(&filter);
+}
+
+// What the literal prefilter saves: the same pattern through plain regexec
+// on both columns of every package, through `filter_run` with the literal
+// checks alone, and with the trigram candidates of the longest literal too
+static void bench_regex_prefilter(bench_t *bench,
+                                  const search_result_t *catalog,
+                                  const trigram_index_t *index,
+                                  const char *pattern) {
+  regex_t regex;
+  if (regcomp(&regex, pattern, REG_EXTENDED | REG_NOSUB | REG_ICASE) != 0)
+    return;
+
+  uint64_t samples[bench->repeats];
+  uint64_t matches = 0;
+  for (size_t r = 0; r < bench->repeats; r++) {
+    matches = 0;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < catalog->count; i++) {
+      matches +=
+          regexec(&regex, search_result_pkgver(catalog, i), 0, NULL, 0) ==
+              0 ||
+          regexec(&regex, search_result_short_desc(catalog, i), 0, NULL,
+                  0) == 0;
+    }
+    samples[r] = now_ns() - start;
+  }
+  regfree(&regex);
+
+  report(bench, "filter/regex/regexec", catalog->count, pattern, samples,
+         bench->repeats, matches);
+  bench_filter_fresh(bench, catalog, NULL, "filter/regex/literals", pattern,
+                     MATCH_REGEX);
+  bench_filter_fresh(bench, catalog, index, "filter/regex/trigram", pattern,
+                     MATCH_REGEX);
+}
+
+// Query typed character by character, each sample is the whole word
+static void bench_filter_typing(bench_t *bench,
+                                const search_result_t *catalog,
+                                const trigram_index_t *index,
+                                const char *name, const char *query,
+                                MATCH_MODE mode) {
+  filter_t filter;
+  if (!filter_init(&filter, catalog, index))
+    return;
+
+  size_t len = strlen(query);
+  char prefix[FILTER_QUERY_MAX];
+
+  uint64_t samples[bench->repeats];
+  for (size_t r = 0; r < bench->repeats; r++) {
+    filter_reset(&filter);
+    uint64_t start = now_ns();
+    for (size_t i = 1; i <= len; i++) {
+      memcpy(prefix, query, i);
+      prefix[i] = '\0';
+      filter_run(&filter, prefix, mode);
+
+      // Worker ranks the first page before publishing
+      filter_result_cleanup(filter_publish(&filter, LIST_ROWS));
+    }
+    samples[r] = now_ns() - start;
+  }
+
+  report(bench, name, catalog->count, query, samples, bench->repeats,
+         filter.count);
+  filter_cleanup(&filter);
+}
+
+// 1, 2, 4... threads and the most of them
+static size_t next_threads(size_t threads, size_t most) {
+  return threads < most && threads * 2 > most ? most : threads * 2;
+}
+
+// Fresh pass split across 1, 2, 4... threads up to `bench->threads`, the
+// calling thread included. Passes below the parallel threshold stay serial
+static void bench_filter_threads(bench_t *bench,
+                                 const search_result_t *catalog,
+                                 const char *name, const char *query,
+                                 MATCH_MODE mode) {
+  for (size_t threads = 1; threads <= bench->threads;
+       threads = next_threads(threads, bench->threads)) {
+    filter_t filter;
+    if (!filter_init(&filter, catalog, NULL))
+      return;
+
+    thread_pool_t *pool = threads > 1 ? thread_pool_create(threads - 1) : NULL;
+    filter.pool = pool;
+
+    uint64_t samples[bench->repeats];
+    for (size_t r = 0; r < bench->repeats; r++) {
+      filter_reset(&filter);
+      uint64_t start = now_ns();
+      filter_run(&filter, query, mode);
+      samples[r] = now_ns() - start;
+    }
+
+    char param[32];
+    snprintf(param, sizeof(param), "%zu", pool ? pool->count + 1 : 1);
+    report(bench, name, catalog->count, param, samples, bench->repeats,
+           filter.count);
+
+    filter_cleanup(&filter);
+    thread_pool_destroy(pool);
+  }
+}
+
+// What `filter_elements` and `filter_poll` do: submit to the search worker
+// and wait for the published result
+static void bench_filter_elements(bench_t *bench,
+                                  const search_result_t *catalog,
+                                  const trigram_index_t *index,
+                                  const char *query) {
+  search_worker_t *worker = search_worker_start(catalog, index);
+  if (!worker)
+    return;
+
+  const char *queries[] = {"", query};
+  uint64_t samples[bench->repeats];
+  size_t matches = 0;
+
+  for (size_t r = 0; r < bench->repeats; r++) {
+    // Empty query in between, so that the result isn't a saved level
+    search_worker_wait(worker, search_worker_submit(worker, queries[0],
+                                                    MATCH_SUBSTRING,
+                                                    LIST_ROWS));
+    filter_result_cleanup(search_worker_take(worker));
+
+    uint64_t start = now_ns();
+    uint64_t generation =
+        search_worker_submit(worker, queries[1], MATCH_SUBSTRING, LIST_ROWS);
+    search_worker_wait(worker, generation);
+    filter_result_t *result = search_worker_take(worker);
+    samples[r] = now_ns() - start;
+
+    matches = result ? result->count : 0;
+    filter_result_cleanup(result);
+  }
+
+  report(bench, "filter_elements/roundtrip", catalog->count, query, samples,
+         bench->repeats, matches);
+  search_worker_stop(worker);
+}
+
+/* ============= Substring matcher ============= */
+
+static const char *const kernel_names[] = {
+    [STRCASESTR_SCALAR] = "scalar",
+    [STRCASESTR_SSE2] = "sse2",
+    [STRCASESTR_AVX2] = "avx2",
+};
+
+// Columns the filter searches, pkgvers are mostly shorter than one AVX2 block
+// and short descriptions longer
+typedef enum COLUMN {
+  COLUMN_PKGVER,
+  COLUMN_SHORT_DESC,
+
+} COLUMN;
+
+static const char *const column_names[] = {
+    [COLUMN_PKGVER] = "pkgver",
+    [COLUMN_SHORT_DESC] = "short_desc",
+};
+
+static const char *column_get(const search_result_t *catalog, COLUMN column,
+                              uint32_t idx) {
+  return column == COLUMN_PKGVER ? search_result_pkgver(catalog, idx)
+                                 : search_result_short_desc(catalog, idx);
+}
+
+// Matchers share the signature of `strcasestr_with`, the kernel is ignored by
+// the dispatching function and libc
+typedef const char *(*matcher_fn)(STRCASESTR_KERNEL kernel,
+                                  const char *haystack, const char *needle);
+
+static const char *match_portable(STRCASESTR_KERNEL kernel,
+                                  const char *haystack, const char *needle) {
+  (void)kernel;
+  return strcasestr_portable(haystack, needle);
+}
+
+static const char *match_libc(STRCASESTR_KERNEL kernel, const char *haystack,
+                              const char *needle) {
+  (void)kernel;
+  return strcasestr(haystack, needle);
+}
+
+static void bench_matcher(bench_t *bench, const search_result_t *catalog,
+                          COLUMN column, const char *matcher, matcher_fn fn,
+                          STRCASESTR_KERNEL kernel, const char *needle) {
+  uint64_t samples[bench->repeats];
+  uint64_t hits = 0;
+
+  for (size_t r = 0; r < bench->repeats; r++) {
+    hits = 0;
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < catalog->count; i++)
+      hits += fn(kernel, column_get(catalog, column, i), needle) != NULL;
+    samples[r] = now_ns() - start;
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "strcasestr/%s/%s", matcher,
+           column_names[column]);
+  report(bench, name, catalog->count, needle, samples, bench->repeats, hits);
+}
+
+// Every pkgver and every short description of the synthetic catalog, which
+// are shaped like those of a repository, are searched column by column. Each
+// kernel the CPU has is timed on its own besides the dispatching function
+// and libc
+static void bench_strcasestr(bench_t *bench, const search_result_t *catalog,
+                             const char *needle) {
+  for (COLUMN column = COLUMN_PKGVER; column <= COLUMN_SHORT_DESC; column++) {
+    bench_matcher(bench, catalog, column, "portable", match_portable,
+                  STRCASESTR_SCALAR, needle);
+    for (STRCASESTR_KERNEL kernel = STRCASESTR_SCALAR;
+         kernel <= strcasestr_kernel() && kernel <= STRCASESTR_AVX2; kernel++)
+      bench_matcher(bench, catalog, column, kernel_names[kernel],
+                    strcasestr_with, kernel, needle);
+    bench_matcher(bench, catalog, column, "libc", match_libc,
+                  STRCASESTR_SCALAR, needle);
+  }
+}
+
+/* ============= Search callbacks ============= */
+
+// pkgdb is handed to the handle directly, libxbps doesn't read it from disk
+// once it's set
+static void bench_search_local(bench_t *bench, const search_result_t *catalog,
+                               const char *pattern, bool regex) {
+  struct xbps_handle xhp;
+  memset(&xhp, 0, sizeof(xhp));
+  xhp.pkgdb = synthetic_pkgdb(catalog);
+  if (!xhp.pkgdb)
+    return;
+
+  uint64_t samples[bench->repeats];
+  uint64_t matches = 0;
+  for (size_t r = 0; r < bench->repeats; r++) {
+    uint64_t start = now_ns();
+    search_result_t *result = search_packages(&xhp, pattern, LOCAL, regex);
+    samples[r] = now_ns() - start;
+
+    matches = result ? result->count : 0;
+    search_result_cleanup(result);
+  }
+
+  report(bench, regex ? "search_packages/local/regex" : "search_packages/local",
+         catalog->count, pattern, samples, bench->repeats, matches);
+  xbps_object_release(xhp.pkgdb);
+}
+
+// Repository index is handed to `search_repository` directly, the way
+// `xbps_rpool_foreach` hands an opened one to the repository callback
+static void bench_search_remote(bench_t *bench,
+                                const search_result_t *catalog,
+                                const char *pattern, bool regex) {
+  struct xbps_handle xhp;
+  memset(&xhp, 0, sizeof(xhp));
+  struct xbps_repo repo = {
+      .xhp = &xhp,
+      .idx = synthetic_repodata(catalog),
+      .uri = "https://repo.example/current",
+  };
+  if (!repo.idx)
+    return;
+
+  uint64_t samples[bench->repeats];
+  uint64_t matches = 0;
+  for (size_t r = 0; r < bench->repeats; r++) {
+    search_result_t *result = calloc(1, sizeof(search_result_t));
+    if (!result) {
+      xbps_object_release(repo.idx);
+      return;
+    }
+    result->repo_type = REMOTE;
+
+    uint64_t start = now_ns();
+    search_repository(&repo, pattern, regex, result);
+    samples[r] = now_ns() - start;
+
+    matches = result->count;
+    search_result_cleanup(result);
+  }
+
+  report(bench,
+         regex ? "search_packages/remote/regex" : "search_packages/remote",
+         catalog->count, pattern, samples, bench->repeats, matches);
+  xbps_object_release(repo.idx);
+}
+
+/* ============= Sort ============= */
+
+// Permutation of the whole catalog, built on the first switch to an order.
+// Other orders start from the name order, like in the model
+static void bench_sort_build(bench_t *bench, const search_result_t *catalog,
+                             SORT_ORDER order, const uint32_t *by_name) {
+  uint64_t samples[bench->repeats];
+  for (size_t r = 0; r < bench->repeats; r++) {
+    uint64_t start = now_ns();
+    uint32_t *permutation = sort_order_build(catalog, order, by_name);
+    samples[r] = now_ns() - start;
+    free(permutation);
+  }
+
+  report(bench, "sort_order/build", catalog->count, sort_order_label(order),
+         samples, bench->repeats, catalog->count);
+}
+
+// Ordering matches of a query, what switching the order costs afterwards
+static void bench_sort_apply(bench_t *bench, const search_result_t *catalog,
+                             const trigram_index_t *index, const char *query) {
+  filter_t filter;
+  if (!filter_init(&filter, catalog, index))
+    return;
+
+  uint32_t *permutation = sort_order_build(catalog, SORT_NAME, NULL);
+  size_t *indices = malloc((catalog->count + 1) * sizeof(size_t));
+  uint64_t samples[bench->repeats];
+
+  if (permutation && indices && filter_run(&filter, query, MATCH_SUBSTRING)) {
+    for (size_t r = 0; r < bench->repeats; r++) {
+      memcpy(indices, filter.indices, filter.count * sizeof(size_t));
+      uint64_t start = now_ns();
+      sort_order_apply(permutation, catalog->count, indices, filter.count);
+      samples[r] = now_ns() - start;
+    }
+    report(bench, "sort_order/apply", catalog->count, query, samples,
+           bench->repeats, filter.count);
+  }
+
+  free(indices);
+  free(permutation);
+  filter_cleanup(&filter);
+}
+
+/* ============= pkgdb patch ============= */
+
+// Catalog patched after an xbps-install run that updated, removed and
+// installed a few packages, what a pkgdb change costs instead of a reload
+static void bench_catalog_patch(bench_t *bench,
+                                const search_result_t *catalog) {
+  search_result_t *local = search_result_copy(catalog);
+  if (!local || local->count < PATCH_CHANGES * 3) {
+    search_result_cleanup(local);
+    return;
+  }
+
+  // Updates spread over the catalog, removals from its end
+  char pkgver[128];
+  for (uint32_t i = 0; i < PATCH_CHANGES; i++) {
+    uint32_t idx = i * (local->count / PATCH_CHANGES - 1);
+    const char *old = search_result_pkgver(local, idx);
+    snprintf(pkgver, sizeof(pkgver), "%.*s-99.0_1", (int)pkgver_name_len(old),
+             old);
+    local->packages[idx].pkgver = string_arena_push(&local->pkgvers, pkgver);
+  }
+  local->count -= PATCH_CHANGES;
+  for (uint32_t i = 0; i < PATCH_CHANGES; i++) {
+    snprintf(pkgver, sizeof(pkgver), "bench-new%u-1.0_1", i);
+    search_result_append(local, pkgver, "installed meanwhile");
+  }
+
+  uint64_t samples[bench->repeats];
+  size_t changes = 0;
+  for (size_t r = 0; r < bench->repeats; r++) {
+    catalog_patch_t patch;
+    uint64_t start = now_ns();
+    bool ok = catalog_patch(catalog, local, &patch);
+    samples[r] = now_ns() - start;
+
+    changes = ok ? patch.added + patch.removed + patch.changed : 0;
+    catalog_patch_cleanup(&patch);
+  }
+
+  report(bench, "catalog/patch", catalog->count, NULL, samples, bench->repeats,
+         changes);
+  search_result_cleanup(local);
+}
+
+// Catalog joined with installed packages, a part of them is outdated
+static search_result_t *upgrades_catalog(const search_result_t *catalog) {
+  search_result_t *remote = search_result_copy(catalog);
+  search_result_t *local = search_result_copy(catalog);
+  pkgname_table_t installed = {0};
+  search_result_t *merged = NULL;
+  if (!remote || !local)
+    goto done;
+
+  remote->repo_type = REMOTE;
+  for (uint32_t i = 0; i < remote->count; i++)
+    remote->packages[i].repository =
+        string_arena_push(&remote->details, "https://repo.example/current");
+
+  // Installed packages are rebuilt from every n-th one of the catalog
+  char pkgver[128];
+  uint32_t count = local->count;
+  local->count = 0;
+  for (uint32_t i = 0; i < count; i += UPGRADES_INSTALLED) {
+    const char *current = search_result_pkgver(catalog, i);
+    if ((i / UPGRADES_INSTALLED) % 2)
+      snprintf(pkgver, sizeof(pkgver), "%.*s-0.1_1",
+               (int)catalog->packages[i].name_len, current);
+    else
+      snprintf(pkgver, sizeof(pkgver), "%s", current);
+    search_result_append(local, pkgver, search_result_short_desc(catalog, i));
+  }
+
+  if (pkgname_table_build(&installed, local))
+    merged = catalog_merge(remote, local, &installed, true);
+
+done:
+  pkgname_table_cleanup(&installed);
+  if (local)
+    search_result_cleanup(local);
+  if (remote)
+    search_result_cleanup(remote);
+  return merged;
+}
+
+static void bench_catalog_upgrades(bench_t *bench,
+                                   const search_result_t *catalog) {
+  search_result_t *merged = upgrades_catalog(catalog);
+  size_t words = merged ? merged->count / 64 + 1 : 0;
+  uint64_t *upgradable = calloc(words, sizeof(uint64_t));
+  if (!merged || !upgradable) {
+    free(upgradable);
+    if (merged)
+      search_result_cleanup(merged);
+    return;
+  }
+
+  uint64_t samples[bench->repeats];
+  uint32_t found = 0;
+  for (size_t r = 0; r < bench->repeats; r++) {
+    memset(upgradable, 0, words * sizeof(uint64_t));
+    uint64_t start = now_ns();
+    catalog_upgrades(merged, upgradable, &found);
+    samples[r] = now_ns() - start;
+  }
+
+  report(bench, "catalog/upgrades", catalog->count, NULL, samples,
+         bench->repeats, found);
+  free(upgradable);
+  search_result_cleanup(merged);
+}
+
+/* ============= Drawing ============= */
+
+// Notcurses writing to /dev/null, planes of the benchmark live in their own
+// pile that is never rasterized
+static struct notcurses *offscreen_init(void) {
+  FILE *null = fopen("/dev/null", "w");
+  if (!null)
+    return NULL;
+
+  struct notcurses_options opts = {
+      .termtype = getenv("TERM") ? NULL : "xterm-256color",
+      .loglevel = NCLOGLEVEL_SILENT,
+      .flags = NCOPTION_SUPPRESS_BANNERS | NCOPTION_NO_ALTERNATE_SCREEN |
+               NCOPTION_NO_QUIT_SIGHANDLERS | NCOPTION_NO_WINCH_SIGHANDLER |
+               NCOPTION_DRAIN_INPUT,
+  };
+
+  // Stream stays open for notcurses' whole life
+  return notcurses_init(&opts, null);
+}
+
+static void bench_draw(bench_t *bench, struct notcurses *nc,
+                       search_result_t *catalog) {
+  struct ncplane *pile = ncpile_create(
+      nc, &(struct ncplane_options){.rows = LIST_ROWS, .cols = LIST_COLS});
+  if (!pile)
+    return;
+
+  model_t state = {0};
+  state.nc = nc;
+  state.list_plane = pile;
+  state.packages = catalog;
+  state.focus = LIST;
+
+  state.filtered_indices = malloc(catalog->count * sizeof(size_t));
+  if (!state.filtered_indices) {
+    ncplane_destroy(pile);
+    return;
+  }
+  for (uint32_t i = 0; i < catalog->count; i++)
+    state.filtered_indices[i] = i;
+  state.filtered_count = catalog->count;
+  state.ranked_count = catalog->count;
+
+  uint64_t samples[bench->repeats];
+
+  // Whole page, e.g. after scrolling
+  for (size_t r = 0; r < bench->repeats; r++) {
+    state.visible_start = (r * LIST_ROWS) % catalog->count;
+    state.selected_idx = state.visible_start;
+    uint64_t start = now_ns();
+    draw_list(&state);
+    samples[r] = now_ns() - start;
+  }
+  report(bench, "draw_list/full", catalog->count, NULL, samples,
+         bench->repeats, LIST_ROWS);
+
+  // Selection moved by one row within the viewport
+  for (size_t r = 0; r < bench->repeats; r++) {
+    state.selected_idx = state.visible_start + 1 + r % (LIST_ROWS - 2);
+    uint64_t start = now_ns();
+    draw_list_selection(&state);
+    samples[r] = now_ns() - start;
+  }
+  report(bench, "draw_list/selection", catalog->count, NULL, samples,
+         bench->repeats, 2);
+
+  // Composition of the frame, without writing it out
+  for (size_t r = 0; r < bench->repeats; r++) {
+    draw_list(&state);
+    uint64_t start = now_ns();
+    ncpile_render(pile);
+    samples[r] = now_ns() - start;
+  }
+  report(bench, "ncpile_render/list", catalog->count, NULL, samples,
+         bench->repeats, LIST_ROWS);
+
+  free(state.filtered_indices);
+  ncplane_destroy(pile);
+}
+
+// Frames written to the terminal, sized like it. Items are the bytes a frame
+// emits on average, what goes over the wire e.g. with SSH
+typedef enum FRAME {
+  FRAME_SCROLL,    // Whole list repainted a page further
+  FRAME_SELECTION, // Selection moved by one row, two rows repainted
+  FRAME_UNCHANGED, // Nothing dirty, draw_dirty skips the frame
+
+} FRAME;
+
+static const char *const frame_names[] = {
+    [FRAME_SCROLL] = "frame/scroll",
+    [FRAME_SELECTION] = "frame/selection",
+    [FRAME_UNCHANGED] = "frame/unchanged",
+};
+
+static void bench_frame(bench_t *bench, model_t *state, ncstats *stats,
+                        FRAME frame) {
+  struct ncplane *pile = state->list_plane;
+  unsigned rows = ncplane_dim_y(pile);
+  uint32_t count = state->packages->count;
+
+  uint64_t samples[bench->repeats];
+  uint64_t bytes = 0;
+  for (size_t r = 0; r < bench->repeats; r++) {
+    notcurses_stats_reset(state->nc, NULL);
+    uint64_t start = now_ns();
+
+    // Marked the way `handle_input` marks a key press
+    if (frame == FRAME_SCROLL) {
+      state->visible_start = (state->visible_start + rows) % count;
+      state->selected_idx = state->visible_start;
+      state->dirty |= DIRTY_LIST;
+    } else if (frame == FRAME_SELECTION) {
+      state->selected_idx =
+          state->visible_start + 1 + r % (rows > 2 ? rows - 2 : 1);
+      state->dirty |= DIRTY_SELECTION;
+    }
+
+    // Like run_app, a frame with nothing dirty isn't rendered
+    if (draw_dirty(state)) {
+      ncpile_render(pile);
+      ncpile_rasterize(pile);
+    }
+    samples[r] = now_ns() - start;
+
+    notcurses_stats(state->nc, stats);
+    bytes += stats->raster_bytes;
+  }
+
+  report(bench, frame_names[frame], count, NULL, samples, bench->repeats,
+         bytes / bench->repeats);
+}
+
+static void bench_frames(bench_t *bench, struct notcurses *nc,
+                         search_result_t *catalog) {
+  unsigned rows = 0, cols = 0;
+  notcurses_term_dim_yx(nc, &rows, &cols);
+  struct ncplane *pile = ncpile_create(
+      nc, &(struct ncplane_options){.rows = rows > 2 ? rows : LIST_ROWS,
+                                    .cols = cols > 0 ? cols : LIST_COLS});
+  ncstats *stats = notcurses_stats_alloc(nc);
+  size_t *indices = malloc(catalog->count * sizeof(size_t));
+
+  if (pile && stats && indices) {
+    model_t state = {0};
+    state.nc = nc;
+    state.list_plane = pile;
+    state.packages = catalog;
+    state.focus = LIST;
+    state.filtered_indices = indices;
+    for (uint32_t i = 0; i < catalog->count; i++)
+      indices[i] = i;
+    state.filtered_count = catalog->count;
+    state.ranked_count = catalog->count;
+
+    // Terminal starts with the first page
+    state.dirty = DIRTY_LIST;
+    draw_dirty(&state);
+    ncpile_render(pile);
+    ncpile_rasterize(pile);
+
+    for (FRAME frame = FRAME_SCROLL; frame <= FRAME_UNCHANGED; frame++)
+      bench_frame(bench, &state, stats, frame);
+  }
+
+  free(indices);
+  free(stats);
+  if (pile)
+    ncplane_destroy(pile);
+}
+
+/* ============= Main ============= */
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "Time hot paths on synthetic catalogs, results are printed as JSON\n"
+          "\n"
+          "  -s, --sizes N,N,...  catalog sizes (default 1000,10000,50000,"
+          "200000)\n"
+          "  -r, --repeats N      samples of every benchmark (default %d)\n"
+          "  -t, --threads N      most threads of filter scaling (default "
+          "online CPUs)\n"
+          "      --no-draw        skip benchmarks that need notcurses\n"
+          "  -h, --help           show this help\n",
+          name, DEFAULT_REPEATS);
+}
+
+static size_t parse_sizes(const char *arg, uint32_t *sizes) {
+  size_t count = 0;
+  char *end = NULL;
+  while (*arg && count < MAX_SIZES) {
+    unsigned long size = strtoul(arg, &end, 10);
+    if (end == arg || size == 0 || size > UINT32_MAX)
+      return 0;
+    sizes[count++] = (uint32_t)size;
+    arg = *end == ',' ? end + 1 : end;
+  }
+  return *arg ? 0 : count;
+}
+
+int main(int argc, char **argv) {
+  uint32_t sizes[MAX_SIZES];
+  size_t sizes_count = sizeof(default_sizes) / sizeof(default_sizes[0]);
+  memcpy(sizes, default_sizes, sizeof(default_sizes));
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  bench_t bench = {.repeats = DEFAULT_REPEATS,
+                   .threads = cpus > 1 ? (size_t)cpus : 1,
+                   .first = true};
+  bool draw = true;
+
+  const struct option long_opts[] = {
+      {"sizes", required_argument, NULL, 's'},
+      {"repeats", required_argument, NULL, 'r'},
+      {"threads", required_argument, NULL, 't'},
+      {"no-draw", no_argument, NULL, 'D'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+
+  int c;
+  while ((c = getopt_long(argc, argv, "s:r:t:h", long_opts, NULL)) != -1) {
+    switch (c) {
+    case 's':
+      sizes_count = parse_sizes(optarg, sizes);
+      if (sizes_count == 0) {
+        fprintf(stderr, "Invalid sizes: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'r':
+      bench.repeats = strtoul(optarg, NULL, 10);
+      if (bench.repeats == 0) {
+        fprintf(stderr, "Invalid repeats: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 't':
+      bench.threads = strtoul(optarg, NULL, 10);
+      if (bench.threads == 0 || bench.threads > THREAD_POOL_MAX + 1) {
+        fprintf(stderr, "Invalid threads: %s\n", optarg);
+        return 1;
+      }
+      break;
+    case 'D':
+      draw = false;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  struct notcurses *nc = draw ? offscreen_init() : NULL;
+  if (draw && !nc)
+    fprintf(stderr, "notcurses is unavailable, skipping draw benchmarks\n");
+
+  printf("{\n  \"suite\": \"xui-bench\",\n  \"schema\": %d,\n"
+         "  \"seed\": %d,\n  \"results\": [",
+         BENCH_SCHEMA, SEED);
+
+  for (size_t s = 0; s < sizes_count; s++) {
+    search_result_t *catalog = synthetic_catalog(sizes[s], SEED);
+    if (!catalog) {
+      fprintf(stderr, "Failed to generate %u packages\n", sizes[s]);
+      continue;
+    }
+
+    // Before anything else allocates, so that the resident set grows
+    bench_catalog_load(&bench, catalog);
+    bench_startup(&bench, catalog);
+
+    uint64_t samples[bench.repeats];
+    trigram_index_t *index = NULL;
+    for (size_t r = 0; r < bench.repeats; r++) {
+      trigram_index_cleanup(index);
+      uint64_t start = now_ns();
+      index = trigram_index_build(catalog);
+      samples[r] = now_ns() - start;
+    }
+    report(&bench, "trigram/build", catalog->count, NULL, samples,
+           bench.repeats, trigram_index_memory(index));
+
+    bench_filter_fresh(&bench, catalog, index, "filter/substring", "lib",
+                       MATCH_SUBSTRING);
+    bench_filter_fresh(&bench, catalog, index, "filter/substring", "devel",
+                       MATCH_SUBSTRING);
+    bench_filter_fresh(&bench, catalog, index, "filter/substring", "x",
+                       MATCH_SUBSTRING);
+    bench_regex_prefilter(&bench, catalog, index, "^python3-.*-devel");
+    bench_regex_prefilter(&bench, catalog, index, "^lib.*-devel");
+    bench_filter_typing(&bench, catalog, index, "filter/substring/typing",
+                        "python3-ba", MATCH_SUBSTRING);
+    bench_filter_typing(&bench, catalog, index, "filter/fuzzy/typing",
+                        "pydevel", MATCH_FUZZY);
+    bench_filter_elements(&bench, catalog, index, "lib");
+    bench_filter_threads(&bench, catalog, "filter/substring/threads", "x",
+                         MATCH_SUBSTRING);
+    bench_filter_threads(&bench, catalog, "filter/fuzzy/threads", "pyd",
+                         MATCH_FUZZY);
+
+    bench_strcasestr(&bench, catalog, "x");
+    bench_strcasestr(&bench, catalog, "lib");
+    bench_strcasestr(&bench, catalog, "documentation");
+
+    uint32_t *by_name = sort_order_build(catalog, SORT_NAME, NULL);
+    bench_sort_build(&bench, catalog, SORT_NAME, NULL);
+    for (SORT_ORDER order = SORT_VERSION; by_name && order < SORT_ORDERS;
+         order++)
+      bench_sort_build(&bench, catalog, order, by_name);
+    free(by_name);
+    bench_sort_apply(&bench, catalog, index, "");
+    bench_sort_apply(&bench, catalog, index, "lib");
+
+    bench_search_local(&bench, catalog, "", false);
+    bench_search_local(&bench, catalog, "lib", false);
+    bench_search_local(&bench, catalog, "^lib.*-devel", true);
+    bench_search_remote(&bench, catalog, "", false);
+    bench_search_remote(&bench, catalog, "lib", false);
+    bench_search_remote(&bench, catalog, "^lib.*-devel", true);
+    bench_catalog_patch(&bench, catalog);
+    bench_catalog_upgrades(&bench, catalog);
+
+    if (nc) {
+      bench_draw(&bench, nc, catalog);
+      bench_frames(&bench, nc, catalog);
+    }
+
+    trigram_index_cleanup(index);
+    search_result_cleanup(catalog);
+  }
+
+  printf("\n  ]\n}\n");
+
+  if (nc)
+    notcurses_stop(nc);
+
+  return 0;
+}
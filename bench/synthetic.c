@@ -0,0 +1,186 @@
+#include "synthetic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Weighted choice of prefixes and suffixes, weights are per mille
+struct weighted {
+  const char *text;
+  unsigned weight;
+};
+
+static const struct weighted prefixes[] = {
+    {"lib", 200},     {"python3-", 100}, {"perl-", 50},
+    {"rust-", 30},    {"font-", 20},     {"xf86-video-", 10},
+    {"texlive-", 20}, {"qt5-", 20},      {"gst-plugins-", 10},
+};
+
+static const struct weighted suffixes[] = {
+    {"-devel", 150}, {"-doc", 40}, {"-32bit", 50}, {"-dbg", 50},
+};
+
+// Name stems are numbers in base 40 written with syllables. Every syllable has
+// two letters, so different numbers never give the same stem
+static const char *const syllables[] = {
+    "ba", "be", "bi", "bo", "da", "de", "do", "fa", "fe", "fi",
+    "ga", "go", "gu", "ka", "ke", "ki", "la", "le", "li", "lo",
+    "ma", "me", "mi", "na", "ne", "no", "pa", "pi", "po", "ra",
+    "re", "ri", "ro", "sa", "se", "so", "ta", "ti", "vo", "xu",
+};
+#define SYLLABLES (sizeof(syllables) / sizeof(syllables[0]))
+
+static const char *const words[] = {
+    "library",   "for",        "the",       "and",      "tools",
+    "utilities", "development", "files",    "GTK+",     "Qt",
+    "bindings",  "Python",     "Perl",      "Rust",     "fast",
+    "simple",    "lightweight", "modern",   "terminal", "client",
+    "server",    "daemon",     "network",   "audio",    "video",
+    "image",     "font",       "plugin",    "framework", "parser",
+    "compression", "format",   "protocol",  "X11",      "Wayland",
+    "driver",    "firmware",   "manager",   "editor",   "viewer",
+    "text",      "documentation", "debug",  "symbols",  "32-bit",
+    "support",   "implementation", "of",    "a",        "toolkit",
+    "graphical", "command-line", "system",  "kernel",   "module",
+    "TeX",       "collection", "package",   "data",     "theme",
+};
+#define WORDS (sizeof(words) / sizeof(words[0]))
+
+// Install dates, 2000 transactions from 2020-01-01 500 minutes apart
+#define INSTALL_EPOCH 1577836800
+#define INSTALL_BATCHES 2000
+#define INSTALL_INTERVAL (500 * 60)
+
+uint64_t synthetic_next(synthetic_rng_t *rng) {
+  uint64_t x = rng->state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  rng->state = x;
+  return x * 0x2545F4914F6CDD1DULL;
+}
+
+static const char *pick(synthetic_rng_t *rng, const struct weighted *items,
+                        size_t count) {
+  unsigned roll = (unsigned)(synthetic_next(rng) % 1000);
+  for (size_t i = 0; i < count; i++) {
+    if (roll < items[i].weight)
+      return items[i].text;
+    roll -= items[i].weight;
+  }
+  return "";
+}
+
+// Stem of `idx`-th package, at least two syllables
+static size_t stem(char *buf, size_t size, uint32_t idx) {
+  size_t len = 0;
+  for (int i = 0; len + 4 < size && (idx > 0 || i < 2); i++) {
+    len += (size_t)snprintf(buf + len, size - len, "%s",
+                            syllables[idx % SYLLABLES]);
+    idx /= SYLLABLES;
+  }
+  return len;
+}
+
+search_result_t *synthetic_catalog(uint32_t count, uint64_t seed) {
+  search_result_t *catalog = calloc(1, sizeof(search_result_t));
+  if (!catalog)
+    return NULL;
+
+  catalog->repo_type = LOCAL;
+  synthetic_rng_t rng = {seed ? seed : 1};
+
+  char name[64], pkgver[128], desc[256];
+  for (uint32_t i = 0; i < count; i++) {
+    stem(name, sizeof(name), i);
+
+    const char *prefix =
+        pick(&rng, prefixes, sizeof(prefixes) / sizeof(prefixes[0]));
+    const char *suffix =
+        pick(&rng, suffixes, sizeof(suffixes) / sizeof(suffixes[0]));
+    snprintf(pkgver, sizeof(pkgver), "%s%s%s-%u.%u.%u_%u", prefix, name,
+             suffix, (unsigned)(synthetic_next(&rng) % 12),
+             (unsigned)(synthetic_next(&rng) % 40),
+             (unsigned)(synthetic_next(&rng) % 20),
+             (unsigned)(1 + synthetic_next(&rng) % 4));
+
+    size_t len = 0;
+    unsigned desc_words = 3 + (unsigned)(synthetic_next(&rng) % 6);
+    for (unsigned w = 0; w < desc_words && len + 32 < sizeof(desc); w++) {
+      len += (size_t)snprintf(desc + len, sizeof(desc) - len, "%s%s",
+                              w > 0 ? " " : "",
+                              words[synthetic_next(&rng) % WORDS]);
+    }
+    if (len > 0 && desc[0] >= 'a' && desc[0] <= 'z')
+      desc[0] -= 'a' - 'A';
+
+    package_entry_t *pkg = search_result_append(catalog, pkgver, desc);
+    if (!pkg) {
+      search_result_cleanup(catalog);
+      return NULL;
+    }
+
+    // Sizes up to 16 GiB, installed by one of a few thousand transactions,
+    // which pkgdb records to the minute
+    pkg->installed_size = (1 + synthetic_next(&rng) % 1024)
+                          << (synthetic_next(&rng) % 25);
+    uint64_t batch = synthetic_next(&rng) % INSTALL_BATCHES;
+    pkg->install_date = INSTALL_EPOCH + (int64_t)batch * INSTALL_INTERVAL;
+  }
+
+  return catalog;
+}
+
+xbps_dictionary_t synthetic_pkgdb(const search_result_t *catalog) {
+  xbps_dictionary_t pkgdb = xbps_dictionary_create();
+  if (!pkgdb)
+    return NULL;
+
+  char name[XBPS_NAME_SIZE];
+  for (uint32_t i = 0; i < catalog->count; i++) {
+    const char *pkgver = search_result_pkgver(catalog, i);
+    if (!xbps_pkg_name(name, sizeof(name), pkgver))
+      continue;
+
+    xbps_dictionary_t pkg = xbps_dictionary_create();
+    if (!pkg)
+      break;
+
+    xbps_dictionary_set_cstring(pkg, "pkgver", pkgver);
+    xbps_dictionary_set_cstring(pkg, "short_desc",
+                                search_result_short_desc(catalog, i));
+    xbps_dictionary_set_cstring(pkg, "state", "installed");
+    xbps_dictionary_set(pkgdb, name, pkg);
+    xbps_object_release(pkg);
+  }
+
+  return pkgdb;
+}
+
+xbps_dictionary_t synthetic_repodata(const search_result_t *catalog) {
+  xbps_dictionary_t idx = xbps_dictionary_create();
+  if (!idx)
+    return NULL;
+
+  char name[XBPS_NAME_SIZE];
+  for (uint32_t i = 0; i < catalog->count; i++) {
+    const char *pkgver = search_result_pkgver(catalog, i);
+    if (!xbps_pkg_name(name, sizeof(name), pkgver))
+      continue;
+
+    xbps_dictionary_t pkg = xbps_dictionary_create();
+    if (!pkg)
+      break;
+
+    xbps_dictionary_set_cstring(pkg, "pkgver", pkgver);
+    xbps_dictionary_set_cstring(pkg, "short_desc",
+                                search_result_short_desc(catalog, i));
+    xbps_dictionary_set_uint64(pkg, "installed_size",
+                               catalog->packages[i].installed_size);
+    xbps_dictionary_set_cstring(pkg, "architecture", "x86_64");
+    xbps_dictionary_set(idx, name, pkg);
+    xbps_object_release(pkg);
+  }
+
+  return idx;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "pkg_search.h"
+
+#include <stdint.h>
+#include <xbps.h>
+
+/// @brief Deterministic generator, the same seed gives the same catalog
+typedef struct synthetic_rng_t {
+  uint64_t state;
+
+} synthetic_rng_t;
+
+/// @brief Next pseudo-random number, xorshift64*
+uint64_t synthetic_next(synthetic_rng_t *rng);
+
+/// @brief Generate catalog of `count` packages that look like a real
+/// repository: library, python, perl, font... families, -devel and -32bit
+/// subpackages, versions and short descriptions built from a word list,
+/// installed sizes and install dates
+/// @note Names are unique. Return value should be freed with
+/// `search_result_cleanup`
+///
+/// @return Allocated search_result_t struct or NULL
+search_result_t *synthetic_catalog(uint32_t count, uint64_t seed);
+
+/// @brief Build in-memory pkgdb holding every package of catalog, the way
+/// `xbps_pkgdb_foreach_cb` hands it to search callbacks
+/// @note Return value should be freed with `xbps_object_release`
+///
+/// @return Dictionary keyed by package name or NULL
+xbps_dictionary_t synthetic_pkgdb(const search_result_t *catalog);
+
+/// @brief Build in-memory index of a repository holding every package of
+/// catalog, the way `xbps_rpool_foreach` hands it to search callbacks
+/// @note Return value should be freed with `xbps_object_release`
+///
+/// @return Dictionary keyed by package name or NULL
+xbps_dictionary_t synthetic_repodata(const search_result_t *catalog);
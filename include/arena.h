@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Offset of a missing string
+#define NO_STRING UINT32_MAX
+
+/// @brief Growable blob of NUL-terminated strings addressed by 32-bit offsets
+typedef struct string_arena_t {
+  char *data;
+  uint32_t len;
+  uint32_t cap;
+
+} string_arena_t;
+
+/// @brief Copy string to the end of arena, doubling its capacity if needed
+/// @param str String to copy, may be NULL
+///
+/// @return Offset of the copy or NO_STRING if `str` is NULL or on error
+uint32_t string_arena_push(string_arena_t *arena, const char *str);
+
+/// @brief Resolve offset returned by `string_arena_push`
+///
+/// @return Pointer into the arena or NULL for NO_STRING
+static inline const char *string_arena_get(const string_arena_t *arena, uint32_t offset) {
+  return offset == NO_STRING ? NULL : arena->data + offset;
+}
+
+/// @brief Make sure arena can take `bytes` more bytes without reallocating
+///
+/// @return true on success, false on error
+bool string_arena_reserve(string_arena_t *arena, uint32_t bytes);
+
+/// @brief Copy used part of `src` into an empty `dst`
+///
+/// @return true on success, false on error
+bool string_arena_copy(string_arena_t *dst, const string_arena_t *src);
+
+/// @brief Free arena's memory
+void string_arena_cleanup(string_arena_t *arena);
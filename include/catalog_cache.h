@@ -0,0 +1,50 @@
+#pragma once
+
+#include "pkg_search.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <xbps.h>
+
+/// @brief Version of cache file layout, bump on any change
+#define CATALOG_CACHE_VERSION 5
+
+/// @brief Load catalog of all packages, from the cache file when it matches
+/// the current pkgdb/repodata and from libxbps otherwise
+/// @note Cached catalog is mapped and searched in place, stale or broken cache
+/// is rebuilt automatically. Return value should be freed with
+/// `search_result_cleanup`
+///
+/// @return Allocated search_result_t struct or NULL
+search_result_t *catalog_load(struct xbps_handle *xhp, REPO_TYPE repo_type);
+
+/// @brief Fingerprint of the files catalog is built from: path, mtime, size
+/// and content hash of pkgdb plist or of every repodata file
+///
+/// @return true on success, false if none of the files could be read
+bool catalog_fingerprint(struct xbps_handle *xhp, REPO_TYPE repo_type, uint64_t *fingerprint);
+
+/// @brief Path of file `name` in $XDG_CACHE_HOME/xui (or ~/.cache/xui)
+/// @param create Create cache directory if it doesn't exist
+///
+/// @return true on success, false if path can't be built
+bool catalog_cache_path(char *buf, size_t size, const char *name, bool create);
+
+/// @brief Create a file next to `path` that is renamed over it once complete
+/// @note Name is unique, so threads writing the same cache file at once never
+/// share one. File should be unlinked if it isn't renamed
+/// @param tmp Set to the name of the created file
+///
+/// @return Stream open for writing or NULL
+FILE *catalog_cache_create(const char *path, char *tmp, size_t size);
+
+/// @brief Write catalog to the cache file, atomically replacing the old one
+///
+/// @return true on success, false on error
+bool catalog_cache_write(const search_result_t *catalog, uint64_t fingerprint);
+
+/// @brief Map cache file if it was written for `fingerprint`
+///
+/// @return Allocated search_result_t struct or NULL on miss
+search_result_t *catalog_cache_map(REPO_TYPE repo_type, uint64_t fingerprint);
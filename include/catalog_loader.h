@@ -0,0 +1,61 @@
+#pragma once
+
+#include "pkg_search.h"
+#include "pkgname_table.h"
+#include "trigram.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <xbps.h>
+
+/// @brief Catalog loaded so far. Every snapshot extends the previous one, so
+/// indices into an older snapshot stay valid in a newer one
+typedef struct catalog_snapshot_t {
+  search_result_t *packages; // NULL if loading failed
+  trigram_index_t *index;    // may be NULL
+  size_t repos_loaded;
+  size_t repos_total;
+  bool complete; // Last snapshot, nothing else is going to be published
+
+} catalog_snapshot_t;
+
+/// @brief Background thread that loads catalog repository by repository
+/// @note Loader has its own libxbps handle, the one of the UI thread is never
+/// touched. Online catalog is joined with pkgdb, see `catalog_merge`
+typedef struct catalog_loader_t {
+  pthread_t thread;
+  struct xbps_handle xhp; // Owned by the loader thread
+  search_config_t config;
+  REPO_TYPE repo_type;
+
+  search_result_t *local;    // Installed packages, only for online catalog
+  pkgname_table_t installed; // Name lookup over `local`
+
+  _Atomic bool stop;
+  _Atomic size_t repos_loaded;
+  _Atomic size_t repos_total;
+  _Atomic(catalog_snapshot_t *) published; // Newest snapshot, or NULL
+
+} catalog_loader_t;
+
+/// @brief Start loading catalog in background
+/// @note `config` strings have to outlive the loader
+///
+/// @return Allocated catalog_loader_t struct or NULL
+catalog_loader_t *catalog_loader_start(const search_config_t *config, REPO_TYPE repo_type);
+
+/// @brief Take the newest published snapshot, never blocks
+/// @note Return value should be freed with `catalog_snapshot_cleanup`, after
+/// taking `packages` and `index` out of it
+///
+/// @return catalog_snapshot_t struct or NULL if nothing new was published
+catalog_snapshot_t *catalog_loader_take(catalog_loader_t *loader);
+
+/// @brief Stop loading and free loader's resources
+/// @note Repository that is being parsed is finished first
+void catalog_loader_stop(catalog_loader_t *loader);
+
+/// @brief Cleanup functions
+void catalog_snapshot_cleanup(catalog_snapshot_t *snapshot);
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "pkg_search.h"
+#include "pkgname_table.h"
+
+#include <stdbool.h>
+
+/// @brief Join online catalog with installed packages by package name, in a
+/// single pass over `remote`
+/// @note Every package of the copy gets `state` and, if it's installed,
+/// `installed` version. With `complete` set, installed packages that none of
+/// the repositories has are appended after the online ones, so a merge of a
+/// partially loaded catalog is a prefix of the complete one. Return value
+/// should be freed after usage
+/// @param installed Table built over `local`
+///
+/// @return Allocated search_result_t struct or NULL
+search_result_t *catalog_merge(const search_result_t *remote, const search_result_t *local,
+                               const pkgname_table_t *installed, bool complete);
+
+/// @brief Installed packages of joined catalog that the repositories have in a
+/// newer version, compared with `xbps_cmpver`
+/// @note Only entries that are installed take part, they are sorted by name
+/// and merged in one pass. Like in libxbps, the first repository having a
+/// package is the one it's upgraded from
+/// @param upgradable Bitmap over `merged` that the repository entries of
+/// upgradable packages are set in, `(merged->count + 63) / 64` cleared words
+/// @param count Set to the number of upgradable packages
+///
+/// @return true on success, false on error
+bool catalog_upgrades(const search_result_t *merged, uint64_t *upgradable, uint32_t *count);
+
+/// @brief New index of a package that the patch removed
+#define CATALOG_REMOVED UINT32_MAX
+
+/// @brief Catalog brought up to date with pkgdb, see `catalog_patch`
+typedef struct catalog_patch_t {
+  search_result_t *packages; // Patched copy, never mapped
+  uint32_t *remap;           // New index of every old package, or CATALOG_REMOVED
+  uint32_t added;
+  uint32_t removed;
+  uint32_t changed;
+  bool reindex; // Indices or searched text changed, trigram index is stale
+
+} catalog_patch_t;
+
+/// @brief Diff catalog against installed packages of `local` and patch a copy,
+/// only entries of packages that were installed, removed or changed are
+/// touched
+/// @note Entries of LOCAL catalog follow pkgdb entirely. Online packages only
+/// get their installed version and state, installed packages of no repository
+/// come and go like in LOCAL catalog. Remaining entries keep their order, new
+/// ones are appended. Strings of replaced entries stay in the arenas until the
+/// next full load
+/// @param patch Filled on success, should be freed with `catalog_patch_cleanup`
+///
+/// @return true on success, false on error
+bool catalog_patch(const search_result_t *catalog, const search_result_t *local,
+                   catalog_patch_t *patch);
+
+/// @brief Cleanup function
+void catalog_patch_cleanup(catalog_patch_t *patch);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "pkg_search.h"
+#include "pkgname_table.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <xbps.h>
+
+/// @brief Id of a package that isn't in the graph
+#define DEP_GRAPH_NONE UINT32_MAX
+
+/// @brief Direction of edges
+typedef enum DEP_DIRECTION {
+  DEP_DEPENDS = 0,  // Packages that node depends on, from run_depends
+  DEP_RDEPENDS = 1, // Packages that depend on node
+
+} DEP_DIRECTION;
+
+/// @brief Run-time dependencies of every package as compressed sparse rows.
+/// Packages are numbered by their index in `nodes`, neighbours of node `i` are
+/// `edges[dir][start[dir][i]]` up to `edges[dir][start[dir][i + 1]]`, sorted by
+/// id
+/// @note Dependency patterns are resolved once while building, virtual
+/// packages to their first provider
+typedef struct dep_graph_t {
+  search_result_t *nodes; // Package of every id
+  pkgname_table_t names;  // Package name to id
+
+  uint32_t *start[2]; // Indexed by DEP_DIRECTION, `nodes->count + 1` each
+  uint32_t *edges[2]; //
+  uint32_t edges_count;
+  uint32_t unresolved; // Dependencies that no package of the graph satisfies
+
+  uint64_t *automatic;      // Bitmap of packages installed as dependencies,
+  uint32_t automatic_words; // only for LOCAL, ends with the last of them
+
+} dep_graph_t;
+
+/// @brief Build graph from pkgdb for LOCAL, or from index of every repository
+/// for REMOTE, where the first repository having a package wins
+/// @note Return value should be freed with `dep_graph_cleanup`
+///
+/// @return Allocated dep_graph_t struct or NULL
+dep_graph_t *dep_graph_build(struct xbps_handle *xhp, REPO_TYPE repo_type);
+
+/// @brief Id of package named `pkgname`
+///
+/// @return Id or DEP_GRAPH_NONE
+uint32_t dep_graph_find(const dep_graph_t *graph, const char *pkgname);
+
+/// @brief Neighbours of node `id` in direction `dir`
+/// @param count Set to the number of neighbours
+///
+/// @return Pointer into the graph
+static inline const uint32_t *dep_graph_edges(const dep_graph_t *graph, uint32_t id,
+                                              DEP_DIRECTION dir, uint32_t *count) {
+  *count = graph->start[dir][id + 1] - graph->start[dir][id];
+  return graph->edges[dir] + graph->start[dir][id];
+}
+
+/// @brief Every package reachable from `id` in direction `dir`, i.e. its
+/// transitive dependencies or everything that would break without it
+/// @param out Filled with ids in breadth-first order, has to have room for
+/// `nodes->count` of them. May be NULL to only count
+///
+/// @return Number of reachable packages, `id` itself excluded
+uint32_t dep_graph_closure(const dep_graph_t *graph, uint32_t id, DEP_DIRECTION dir,
+                           uint32_t *out);
+
+/// @brief Whether package of node `id` was installed as a dependency
+static inline bool dep_graph_automatic(const dep_graph_t *graph, uint32_t id) {
+  return id / 64 < graph->automatic_words &&
+         (graph->automatic[id / 64] & (1ull << (id % 64)));
+}
+
+/// @brief Automatically installed packages that no manually installed one
+/// depends on, directly or not, i.e. what `xbps-remove -o` would remove
+/// @note One breadth-first pass from every manual package, O(nodes + edges)
+/// @param out Filled with ids of orphans in ascending order, has to have room
+/// for `nodes->count` of them. May be NULL to only count
+/// @param freed Set to the installed size of all orphans, may be NULL
+///
+/// @return Number of orphans
+uint32_t dep_graph_orphans(const dep_graph_t *graph, uint32_t *out, uint64_t *freed);
+
+/// @brief Package of node `id`
+static inline const char *dep_graph_pkgver(const dep_graph_t *graph, uint32_t id) {
+  return search_result_pkgver(graph->nodes, id);
+}
+
+/// @brief Cleanup function
+void dep_graph_cleanup(dep_graph_t *graph);
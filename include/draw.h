@@ -10,5 +10,19 @@ typedef struct model_t model_t;
 /// @return true on success, false on error
 bool draw_input(model_t *state);
 bool draw_list(model_t *state);
+bool draw_list_selection(model_t *state);
 bool draw_info(model_t *state);
+bool draw_files(model_t *state);
+bool draw_deps(model_t *state);
+bool draw_owner_info(model_t *state);
+bool draw_batch(model_t *state);
+bool draw_stats(model_t *state);
 bool init_ui(model_t *state);
+
+/// @brief Redraw planes marked in `dirty` and clear it
+/// @note A selection that moved within the viewport only repaints the rows of
+/// the old and the new selection. Stats overlay, when it's visible, is drawn
+/// with every frame
+///
+/// @return true if anything was drawn, i.e. a render is needed
+bool draw_dirty(model_t *state);
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "pkg_search.h"
+#include "trigram.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xbps.h>
+
+/// @brief File list of one package, as a catalog with one path per entry in
+/// place of `pkgver`, so that it is filtered just like packages
+typedef struct files_snapshot_t {
+  search_result_t *files; // NULL if package has no file list
+  trigram_index_t *index; // may be NULL
+  uint64_t generation;    // Generation of the request
+
+} files_snapshot_t;
+
+/// @brief Background thread that loads file lists with `get_package_files`
+/// @note Loader has its own libxbps handle. Newer request supersedes older
+/// one, list of a superseded request is never published
+typedef struct files_loader_t {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // Signaled on new request or stop
+
+  struct xbps_handle xhp; // Owned by the loader thread
+  bool ready;             // `xhp` was initialized
+  search_config_t config;
+
+  // Request, protected by `lock`
+  char pkgname[XBPS_NAME_SIZE];
+  REPO_TYPE repo_type;
+  uint64_t requested;
+  uint64_t handled;
+  bool refresh; // pkgdb changed, `xhp` is initialized again
+  bool stop;
+
+  _Atomic(files_snapshot_t *) published; // Newest loaded list, or NULL
+
+} files_loader_t;
+
+/// @brief Start loader thread
+/// @note `config` strings have to outlive the loader
+///
+/// @return Allocated files_loader_t struct or NULL
+files_loader_t *files_loader_start(const search_config_t *config);
+
+/// @brief Ask loader for file list of package
+///
+/// @return Generation of request, snapshot carries the same one
+uint64_t files_loader_request(files_loader_t *loader, const char *pkgname, REPO_TYPE repo_type);
+
+/// @brief Read pkgdb again before the next request, e.g. after packages were
+/// installed
+void files_loader_refresh(files_loader_t *loader);
+
+/// @brief Take the newest published snapshot, never blocks
+/// @note Return value should be freed with `files_snapshot_cleanup`, after
+/// taking `files` and `index` out of it
+///
+/// @return files_snapshot_t struct or NULL if nothing new was published
+files_snapshot_t *files_loader_take(files_loader_t *loader);
+
+/// @brief Stop loader thread and free its resources
+/// @note List that is being loaded is finished first
+void files_loader_stop(files_loader_t *loader);
+
+/// @brief Cleanup functions
+void files_snapshot_cleanup(files_snapshot_t *snapshot);
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "regex_literal.h"
+
+#include <regex.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct search_result_t search_result_t;
+typedef struct trigram_index_t trigram_index_t;
+typedef struct thread_pool_t thread_pool_t;
+
+/// @brief Longest query, including the terminating NUL
+#define FILTER_QUERY_MAX 256
+
+/// @brief Default number of elements from which a pass is split across threads,
+/// $XUI_PARALLEL_THRESHOLD overrides it
+#define FILTER_PARALLEL_THRESHOLD 16384
+
+/// @brief How query is matched against packages
+typedef enum MATCH_MODE {
+  MATCH_SUBSTRING = 0, // Case-insensitive substring, pkgdb order
+  MATCH_FUZZY = 1,     // Subsequence, ranked by score
+  MATCH_REGEX = 2,     // POSIX extended regex, case-insensitive, pkgdb order
+
+} MATCH_MODE;
+
+/// @brief Filter result for a prefix of the current query, kept so that
+/// backspace can restore it without rescanning
+typedef struct filter_level_t {
+  size_t query_len; // Length of the query prefix that produced `indices`
+  size_t *indices;
+  size_t count;
+
+} filter_level_t;
+
+/// @brief Incremental filter over an immutable catalog
+typedef struct filter_t {
+  const search_result_t *packages;
+  const trigram_index_t *index; // may be NULL
+
+  MATCH_MODE mode;
+  char query[FILTER_QUERY_MAX]; // Query that produced `indices`
+  size_t query_len;
+  bool valid; // false until the first pass
+
+  size_t *indices; // Matching packages
+  size_t count;
+  size_t cap;
+
+  size_t *spare; // Regex passes match here, swapped with `indices` on success
+  size_t spare_cap;
+
+  filter_level_t levels[FILTER_QUERY_MAX]; // Results for shorter prefixes of
+                                           // the query
+  size_t depth;
+
+  int *scores; // Fuzzy score of each package, valid for current matches
+  int *spare_scores; // Fuzzy passes score here, swapped with `scores` on success
+
+  // Regex of the pass in progress and literals its matches have to contain
+  regex_t regex;
+  regex_literals_t literals;
+  bool invalid; // Regex doesn't compile, matches are of the last valid one
+
+  thread_pool_t *pool;       // Threads for large passes, may be NULL
+  size_t parallel_threshold; // Smaller passes stay on the calling thread
+
+  // Pass is canceled as soon as `*latest` differs from `generation`
+  const _Atomic uint64_t *latest;
+  uint64_t generation;
+
+} filter_t;
+
+/// @brief Matches of one filter pass, owned by whoever holds the pointer
+typedef struct filter_result_t {
+  size_t *indices;
+  size_t count;
+  int *scores;         // Fuzzy score of each package, NULL in substring mode
+  size_t ranked_count; // Number of leading `indices` already in final order
+  uint64_t generation;
+  bool invalid;        // Query is a regex that doesn't compile, see filter_t
+  uint64_t elapsed_ns; // Time the pass took, set by the search worker
+
+} filter_result_t;
+
+/// @brief Initializes filter over catalog
+/// @note Parallel threshold is FILTER_PARALLEL_THRESHOLD unless overridden
+///
+/// @return true on success, false on error
+bool filter_init(filter_t *filter, const search_result_t *packages,
+                 const trigram_index_t *index);
+
+/// @brief Point filter to another catalog, saved results are dropped
+///
+/// @return true on success, false on error, in which case the filter keeps the
+/// old catalog
+bool filter_set_catalog(filter_t *filter, const search_result_t *packages,
+                        const trigram_index_t *index);
+
+/// @brief Filter catalog, updating `indices` and `count`
+/// @note When the query extends the previous one only the current matches are
+/// rechecked, and when it shrinks back to an earlier prefix the saved result is
+/// restored without scanning. Regex is compiled once per call, a pattern that
+/// doesn't compile keeps the previous matches and sets `invalid`
+///
+/// @return true on success, false if the pass was canceled or failed, in which
+/// case the filter is left as it was before the call
+bool filter_run(filter_t *filter, const char *query, MATCH_MODE mode);
+
+/// @brief Copy current matches, ranking the first `ranked` of them in fuzzy mode
+/// @note Return value should be freed after usage
+///
+/// @return Allocated filter_result_t struct or NULL
+filter_result_t *filter_publish(const filter_t *filter, size_t ranked);
+
+/// @brief Sort `indices[from..count)` by descending score. Every element there
+/// has to score lower than the ones before `from`
+void filter_rank_rest(size_t *indices, size_t count, size_t from, const int *scores);
+
+/// @brief Drop every saved filter result, so that the next pass rescans the
+/// whole catalog
+void filter_reset(filter_t *filter);
+
+/// @brief Cleanup functions
+void filter_cleanup(filter_t *filter);
+void filter_result_cleanup(filter_result_t *result);
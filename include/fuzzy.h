@@ -0,0 +1,17 @@
+#pragma once
+
+#include <limits.h>
+
+/// @brief Score of text that doesn't contain pattern as a subsequence
+#define FUZZY_NO_MATCH INT_MIN
+
+/// @brief Extra score for hits in the package name over the description
+#define FUZZY_NAME_BONUS 32
+
+/// @brief Score subsequence match of pattern in text, fzf-style
+/// @note Every matched character scores, consecutive characters and
+/// characters at word boundaries get bonuses, gaps are penalized. Only ASCII
+/// letters are compared case-insensitively
+///
+/// @return Score, higher is better, or FUZZY_NO_MATCH
+int fuzzy_score(const char *text, const char *pattern);
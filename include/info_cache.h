@@ -0,0 +1,44 @@
+#pragma once
+
+#include "pkg_search.h"
+
+#include <stdint.h>
+#include <xbps.h>
+
+/// @brief Number of packages kept in cache
+#define INFO_CACHE_SIZE 64
+
+/// @brief Number of hash buckets, power of two
+#define INFO_CACHE_BUCKETS 128
+
+typedef struct info_cache_entry_t {
+  char *pkgname;
+  package_info_t *info; // NULL if package wasn't found
+  uint32_t prev, next;  // Neighbours in LRU list
+  uint32_t chain;       // Next entry in the same bucket
+
+} info_cache_entry_t;
+
+/// @brief Bounded LRU cache of `get_package_info` results keyed by pkgname
+typedef struct info_cache_t {
+  info_cache_entry_t entries[INFO_CACHE_SIZE];
+  uint32_t buckets[INFO_CACHE_BUCKETS];
+  uint32_t count;
+  uint32_t head; // Most recently used
+  uint32_t tail; // Least recently used
+
+} info_cache_t;
+
+/// @brief Initializes an empty cache
+void info_cache_init(info_cache_t *cache);
+
+/// @brief Get full package info, loading it on a miss and evicting the least
+/// recently used package when cache is full
+/// @note Return value is owned by cache and stays valid until the next call
+///
+/// @return package_info_t struct or NULL if package wasn't found
+const package_info_t *info_cache_get(info_cache_t *cache, struct xbps_handle *xhp,
+                                     const char *pkgname, REPO_TYPE repo_type);
+
+/// @brief Free every cached package
+void info_cache_cleanup(info_cache_t *cache);
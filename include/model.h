@@ -1,10 +1,22 @@
 #pragma once
 
+#include "catalog_loader.h"
+#include "dep_graph.h"
+#include "files_loader.h"
+#include "filter.h"
+#include "info_cache.h"
+#include "owner_index.h"
+#include "perf.h"
 #include "pkg_search.h"
+#include "pkgdb_watch.h"
+#include "search_worker.h"
+#include "sort_order.h"
+#include "transaction.h"
+#include "trigram.h"
 #include <stddef.h>
 #include <xbps.h>
 
-#define INPUT_BUFFER_SIZE 256
+#define INPUT_BUFFER_SIZE FILTER_QUERY_MAX
 
 struct notcurses_options;
 
@@ -14,18 +26,155 @@ struct notcurses_options;
 typedef enum FOCUS_TAB {
   INPUT = 0,
   LIST = 1,
+  FILES = 2,
+  DEPS = 3,
 
 } FOCUS_TAB;
 
+/// @brief Parts of the screen that have to be redrawn, see `draw_dirty`
+typedef enum DIRTY {
+  DIRTY_LIST = 1 << 0,      // Whole list plane
+  DIRTY_SELECTION = 1 << 1, // Only rows of the old and the new selection
+  DIRTY_INPUT = 1 << 2,     //
+  DIRTY_INFO = 1 << 3,      // Info or files pane
+  DIRTY_STATS = 1 << 4,     // Stats overlay was toggled
+  DIRTY_ALL = DIRTY_LIST | DIRTY_INPUT | DIRTY_INFO | DIRTY_STATS,
+
+} DIRTY;
+
+/// @brief Files of a package, shown in place of the info plane. Paths are
+/// filtered by their own search worker, with the same matcher as packages
+typedef struct files_pane_t {
+  files_loader_t *loader;       // Started when the pane is first opened
+  char pkgname[XBPS_NAME_SIZE]; // Package whose files are requested
+  uint64_t request;             // Generation of the newest request
+  bool loading;                 // Newest requested list hasn't arrived yet
+
+  search_result_t *files;  // One path per entry, see files_snapshot_t
+  trigram_index_t *index;  // Index over `files`, may be NULL
+  search_worker_t *worker; // Started with the first list
+
+  char query[FILTER_QUERY_MAX];
+  size_t query_len;
+  bool query_edited; // Query changed since it was filtered, see query_flush
+
+  size_t *indices; // Filtered paths
+  size_t count;
+  int *scores;         // Fuzzy score of each path, valid for current matches
+  size_t ranked_count; // Number of leading `indices` in final order
+  uint64_t filter_generation;
+  bool filter_pending;
+  bool filter_invalid; // Regex query doesn't compile
+
+  size_t selected_idx;
+  size_t visible_start;
+
+} files_pane_t;
+
+/// @brief Row of the dependency tree, see deps_pane_t
+typedef struct dep_row_t {
+  uint32_t node;     // Package id in the graph, DEP_GRAPH_NONE for a header
+  uint16_t depth;    // 0 for section headers, 1 for direct neighbours
+  uint8_t direction; // DEP_DIRECTION of the section
+  bool expanded;     // Neighbours of `node` follow
+
+} dep_row_t;
+
+/// @brief Dependencies of a package, shown in place of the info plane. The
+/// first section lists what the package depends on, the second one what
+/// depends on it, nodes of both are expanded in place
+typedef struct deps_pane_t {
+  dep_graph_t *graph;  // Built when the pane is first opened
+  uint32_t root;       // Package whose tree is shown, may be DEP_GRAPH_NONE
+  uint32_t closure[2]; // Packages reachable from root, by DEP_DIRECTION
+
+  dep_row_t *rows; // Tree flattened in display order
+  size_t count;
+  size_t cap;
+
+  size_t selected_idx;
+  size_t visible_start;
+
+} deps_pane_t;
+
+/// @brief Lookup of installed packages by the paths they own, shown in place of
+/// the package list. Query starting with '=' is an exact path, one starting
+/// with '/' a prefix, anything else a substring
+typedef struct owner_search_t {
+  owner_loader_t *loader; // Started when the mode is first entered
+  owner_index_t *index;   // NULL until loaded
+  owner_worker_t *worker; // Runs lookups once the index is loaded
+  bool active;            // List shows paths instead of packages
+
+  owner_matches_t matches; // Entries of `index` matching the query
+  uint64_t generation;     // Of the newest lookup
+  bool pending;            // Newest lookup has no result yet
+
+} owner_search_t;
+
+/// @brief Installed packages that nothing needs, shown in place of the whole
+/// package list and filtered by the same query, see `dep_graph_orphans`
+typedef struct orphans_view_t {
+  dep_graph_t *graph;   // Built from pkgdb when the view is first entered
+  uint64_t pkgdb_mtime; // Modification time of pkgdb the graph was built from
+  bool active;          // List shows only orphans
+
+  uint32_t *ids;     // Orphans by graph id
+  uint32_t count;    //
+  uint64_t freed;    // Installed size of all orphans, in bytes
+  uint64_t *members; // Bitmap of orphans over `packages`
+
+} orphans_view_t;
+
+/// @brief Installed packages that the repositories have in a newer version,
+/// shown in place of the whole package list with both versions, see
+/// `catalog_upgrades`
+typedef struct upgrades_view_t {
+  bool active; // List shows only upgradable packages
+
+  uint32_t count;    //
+  uint64_t *members; // Bitmap of upgradable packages over `packages`, NULL
+                     // until the view is first entered
+
+} upgrades_view_t;
+
+/// @brief Packages marked for one batched install and remove, and the
+/// transaction of them. Summary and progress are shown in place of the info
+/// plane, the list stays usable meanwhile
+typedef struct batch_view_t {
+  uint64_t *marked;      // Bitmap over `packages`
+  uint32_t marked_words; // Length of `marked`, it grows with the catalog
+  uint32_t marked_count;
+  uint64_t *submitted;      // Marks the transaction was started with, they
+  uint32_t submitted_words; // are cleared from `marked` once it's done
+
+  transaction_t *transaction;  // NULL until marks are submitted
+  transaction_status_t status; // Copy of the newest status of `transaction`
+  uint64_t seen;               // Status updates already copied
+  bool canceled;               // Canceled while resolving, `batch_poll` frees
+                               // it once resolving is over
+
+} batch_view_t;
+
+/// @brief Whether `idx`-th package of catalog is marked
+static inline bool batch_marked(const batch_view_t *batch, uint32_t idx) {
+  return idx / 64 < batch->marked_words &&
+         (batch->marked[idx / 64] & (1ull << (idx % 64)));
+}
+
 ///
 typedef struct model_t {
   struct notcurses *nc;        // notcurses context
   struct ncplane *list_plane;  // Plane for displaying the list of items
   struct ncplane *input_plane; // Plane for user input
   struct ncplane *info_plane;  // Informational plane
+  struct ncplane *stats_plane; // Stats overlay, NULL while hidden
   struct xbps_handle xhp;      // XBPS handle
+  search_config_t config;      // Config `xhp` was initialized with
 
   search_result_t *packages;
+  trigram_index_t *index; // Trigram index over `packages`, may be NULL
+  info_cache_t info_cache; // Details of recently shown packages
 
   size_t selected_idx;  // Index of selected item
   size_t visible_start; // Starting index of the portion of the list that is
@@ -33,25 +182,226 @@ typedef struct model_t {
 
   char input_buffer[INPUT_BUFFER_SIZE];
   size_t input_len;
+  bool query_edited; // Input changed since it was filtered, see query_flush
 
   size_t *filtered_indices; // Array storing indices of items that pass a
                             // filter criteria
   size_t filtered_count;
-  size_t filtered_indices_cap;
+
+  MATCH_MODE match_mode;
+  int *scores;         // Fuzzy score of each package, valid for current matches
+  size_t ranked_count; // Number of leading `filtered_indices` already in
+                       // final order
+
+  SORT_ORDER sort;                    // Order of matches
+  uint32_t *sort_orders[SORT_ORDERS]; // Permutations of `packages`, each built
+                                      // on first use
+
+  catalog_loader_t *loader; // Streams catalog in, NULL once it's loaded
+  size_t repos_loaded;      // Loading progress
+  size_t repos_total;       //
+  pkgdb_watch_t *watch;     // Reloads installed packages when pkgdb
+                            // changes, NULL without inotify
+  bool pkgdb_stale;         // pkgdb of `xhp` is read again on the next poll,
+                            // another thread used it
+
+  uint32_t follow; // Package that stays selected once the next result
+  bool following;  // arrives, see `pkgdb_poll` and `catalog_poll`
+
+  search_worker_t *worker;    // Runs filter passes off the main thread
+  uint64_t filter_generation; // Generation of the newest submitted query
+  bool filter_pending;        // Newest query has no result yet
+  bool filter_invalid;        // Regex query doesn't compile, matches are of
+                              // the last valid one
+
+  files_pane_t files; // Files of a package, shown when focus is FILES
+  owner_search_t owners;
+  deps_pane_t deps; // Dependency tree, shown when focus is DEPS
+  orphans_view_t orphans;
+  upgrades_view_t upgrades;
+  batch_view_t batch;
 
   FOCUS_TAB focus; // Current focus
 
+  unsigned dirty;        // DIRTY flags of what changed since the last frame
+  size_t drawn_selected; // Selected row as it is on screen
+
+  perf_stats_t stats;
+
 } model_t;
 
-/// @brief Filter elements of list based on user input, updating `filtered_indices`
-/// and `filtered_count`
+/// @brief Ask search worker to filter elements of list based on user input
+/// @note Never blocks, `filtered_indices` and `filtered_count` are updated by
+/// `filter_poll` once the result is ready
 void filter_elements(model_t *state);
 
+/// @brief Filter queries edited since the last call, either the package list
+/// or the path lookup, and the files query
+/// @note Input handlers only mark queries as edited, so that a whole batch of
+/// keys, e.g. a paste, is filtered once
+void query_flush(model_t *state);
+
+/// @brief Pick up result of the newest query, results of older queries are
+/// dropped
+/// @param wait Block until the result is ready
+///
+/// @return true if `filtered_indices` changed
+bool filter_poll(model_t *state, bool wait);
+
+/// @brief Switch matching mode and filter the list again
+void filter_set_mode(model_t *state, MATCH_MODE mode);
+
+/// @brief Make sure that the first `count` filtered elements are in their final
+/// order. In fuzzy mode only the first page is ranked, the rest is sorted once
+/// the user scrolls past it
+void filter_rank(model_t *state, size_t count);
+
+/// @brief Pick up catalog snapshot published by the loader and filter it
+/// with the current query
+///
+/// @return true if catalog or loading progress changed
+bool catalog_poll(model_t *state);
+
+/// @brief Patch catalog with pkgdb written since the last call, e.g. by an
+/// xbps-install in another terminal. Matches are remapped right away and
+/// filtered again, selected package stays selected on the same row
+/// @note Online catalog is patched only once it's completely loaded
+///
+/// @return true if catalog changed
+bool pkgdb_poll(model_t *state);
+
+/// @brief Full info of `idx`-th filtered package, loaded on demand
+/// @note Return value is owned by `info_cache`
+///
+/// @return package_info_t struct or NULL
+const package_info_t *filtered_info(model_t *state, size_t idx);
+
+/// @brief Full info of the owner of `idx`-th matching path, see `filtered_info`
+const package_info_t *owner_info(model_t *state, size_t idx);
+
+/// @brief Load info of the packages around `selected_idx` into cache, so that
+/// scrolling doesn't wait for pkgdb
+void prefetch_info(model_t *state);
+
+/// @brief Show files of the selected package, loading them in background
+///
+/// @return true on success, false on error
+bool files_open(model_t *state);
+
+/// @brief Ask files worker to filter paths with the files query
+void files_filter(model_t *state);
+
+/// @brief Pick up newly loaded file list and result of the newest files query
+///
+/// @return true if files pane changed
+bool files_poll(model_t *state);
+
+/// @brief Make sure that the first `count` filtered paths are in their final
+/// order, see `filter_rank`
+void files_rank(model_t *state, size_t count);
+
+/// @brief Switch between package list and path lookup, index is loaded in
+/// background the first time
+///
+/// @return true on success, false on error
+bool owner_toggle(model_t *state);
+
+/// @brief Ask the lookup thread for the query in the owner index
+/// @note Never blocks, `matches` are updated by `owner_poll` once the result
+/// is ready
+void owner_lookup(model_t *state);
+
+/// @brief Pick up owner index once it's loaded, and the result of the newest
+/// lookup
+///
+/// @return true if index or matches arrived
+bool owner_poll(model_t *state);
+
+/// @brief Show dependency tree of the selected package, the graph is built
+/// the first time
+///
+/// @return true on success, false on error
+bool deps_open(model_t *state);
+
+/// @brief Whether package of `row` is root or one of its ancestors, such rows
+/// aren't expanded
+bool deps_cycle(const deps_pane_t *deps, size_t row);
+
+/// @brief Show tree of the package of the selected row instead
+void deps_reroot(model_t *state);
+
+/// @brief Drop dependency graph of installed packages after pkgdb was read
+/// again. Graph on screen is built again right away and keeps its root
+void deps_refresh(model_t *state);
+
+/// @brief Expand selected row of the dependency tree
+void deps_expand(model_t *state);
+
+/// @brief Collapse selected row, or select its parent if it isn't expanded
+void deps_collapse(model_t *state);
+
+/// @brief Switch between the whole package list and orphans, which are found
+/// the first time
+///
+/// @return true on success, false on error
+bool orphans_toggle(model_t *state);
+
+/// @brief Find orphans again if pkgdb changed since they were found
+///
+/// @return true if orphans changed
+bool orphans_poll(model_t *state);
+
+/// @brief Switch between the whole package list and packages that can be
+/// upgraded, which are found again whenever the catalog changes
+/// @note Only the catalog joined with repositories knows newer versions
+///
+/// @return true on success, false on error
+bool upgrades_toggle(model_t *state);
+
+/// @brief What a mark on `idx`-th package of catalog asks for
+TRANSACTION_ACTION batch_action(const model_t *state, uint32_t idx);
+
+/// @brief Mark selected package, or unmark it, and select the next one.
+/// Installed packages are marked for removal, the rest for installation
+///
+/// @return true on success, false on error
+bool batch_mark(model_t *state);
+
+/// @brief Resolve one transaction of every marked package in background, its
+/// summary is shown for confirmation
+///
+/// @return true on success, false on error or if nothing is marked
+bool batch_submit(model_t *state);
+
+/// @brief Commit transaction waiting for confirmation, or drop it if
+/// `confirm` is false. Finished transaction is dismissed either way
+/// @note Never blocks, transaction canceled while resolving is dropped by
+/// `batch_poll` later. Running transaction can't be canceled
+void batch_answer(model_t *state, bool confirm);
+
+/// @brief Pick up progress of the transaction, marks it was started with are
+/// cleared once it finished successfully
+///
+/// @return true if status changed
+bool batch_poll(model_t *state);
+
+/// @brief Switch to the next sort order, or the previous one if `backwards`
+/// @note Matches are reordered in place, only returning to SORT_MATCH asks the
+/// search worker again
+void sort_cycle(model_t *state, bool backwards);
+
+/// @brief Show or hide the stats overlay
+void stats_toggle(model_t *state);
+
 /// @brief Initializes a new instance of model_t
 /// @param opts Notcurses options
+/// @param repo_type REMOTE catalog is loaded in background, the UI is usable
+/// while repositories are streamed in
+/// @param config libxbps config, has to outlive the model
 ///
 /// @return valid model_t on success and (model_t){0} on error
-model_t model_t_init(struct notcurses_options opts);
+model_t model_t_init(struct notcurses_options opts, REPO_TYPE repo_type,
+                     const search_config_t *config);
 
 /// @brief Cleans up resources associated with the model_t
 void model_t_cleanup(model_t *state);
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "arena.h"
+#include "pkg_search.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <xbps.h>
+
+/// @brief Version of cache file layout, bump on any change
+#define OWNER_INDEX_VERSION 1
+
+/// @brief Longest lookup query, including the terminating NUL
+#define OWNER_QUERY_MAX 256
+
+/// @brief Path owned by an installed package
+typedef struct owner_entry_t {
+  uint32_t path;  // offset into `paths`
+  uint32_t owner; // offset of owner's pkgver into `pkgvers`
+
+} owner_entry_t;
+
+/// @brief Reverse file-ownership index: every file of every installed package,
+/// sorted by path, so that exact and prefix lookups are binary searches
+typedef struct owner_index_t {
+  owner_entry_t *entries;
+  uint32_t count;
+
+  string_arena_t paths;
+  string_arena_t pkgvers;
+
+  void *mapping; // Mapped cache file the arrays point into, or NULL
+  size_t mapping_size;
+
+} owner_index_t;
+
+/// @brief Result of a lookup, either a range of entries or a list of them
+typedef struct owner_matches_t {
+  uint32_t begin;     // First entry of the range
+  uint32_t *entries;  // Matching entries, NULL for a range
+  uint32_t count;
+
+} owner_matches_t;
+
+/// @brief Accessors for `idx`-th entry of index
+static inline const char *owner_index_path(const owner_index_t *index, uint32_t idx) {
+  return string_arena_get(&index->paths, index->entries[idx].path);
+}
+
+static inline const char *owner_index_owner(const owner_index_t *index, uint32_t idx) {
+  return string_arena_get(&index->pkgvers, index->entries[idx].owner);
+}
+
+/// @brief Entry of `i`-th match
+static inline uint32_t owner_matches_get(const owner_matches_t *matches, uint32_t i) {
+  return matches->entries ? matches->entries[i] : matches->begin + i;
+}
+
+/// @brief Map index from cache if pkgdb didn't change since it was written,
+/// otherwise build it from files plists of every installed package and write
+/// it to cache
+/// @note Building reads every files plist of pkgdb, so it takes a while.
+/// Return value should be freed after usage
+/// @param cancel Building stops as soon as it's set, may be NULL
+///
+/// @return Allocated owner_index_t struct or NULL
+owner_index_t *owner_index_load(struct xbps_handle *xhp, const _Atomic bool *cancel);
+
+/// @brief Build index from files plists of packages in `local` catalog
+/// @note Return value should be freed after usage
+///
+/// @return Allocated owner_index_t struct or NULL if failed or canceled
+owner_index_t *owner_index_build(struct xbps_handle *xhp, const search_result_t *local,
+                                 const _Atomic bool *cancel);
+
+/// @brief Entries whose path is exactly `path`, O(log n)
+owner_matches_t owner_index_exact(const owner_index_t *index, const char *path);
+
+/// @brief Entries whose path starts with `prefix`, O(log n). Exact match, if
+/// any, comes first
+owner_matches_t owner_index_prefix(const owner_index_t *index, const char *prefix);
+
+/// @brief Entries whose path contains `needle`, a scan over every path
+/// @note `entries` of result should be freed with `owner_matches_cleanup`
+owner_matches_t owner_index_substring(const owner_index_t *index, const char *needle);
+
+/// @brief Look up query as typed: `=path` is an exact lookup, a query that
+/// starts with '/' or is empty a prefix one, anything else a substring scan
+/// @note `entries` of result should be freed with `owner_matches_cleanup`
+owner_matches_t owner_index_lookup(const owner_index_t *index, const char *query);
+
+/// @brief Background thread that runs `owner_index_load` with its own libxbps
+/// handle
+typedef struct owner_loader_t {
+  pthread_t thread;
+  struct xbps_handle xhp; // Owned by the loader thread
+  search_config_t config;
+
+  _Atomic bool stop;
+  _Atomic bool finished;
+  owner_index_t *index; // Valid once `finished` is set
+
+} owner_loader_t;
+
+/// @brief Start loading index in background
+/// @note `config` strings have to outlive the loader
+///
+/// @return Allocated owner_loader_t struct or NULL
+owner_loader_t *owner_loader_start(const search_config_t *config);
+
+/// @brief Check whether loading finished, never blocks
+/// @param index Set to the loaded index (NULL on error) once finished, the
+/// caller then owns it
+///
+/// @return true if loading finished
+bool owner_loader_take(owner_loader_t *loader, owner_index_t **index);
+
+/// @brief Stop loader thread and free its resources, index that is being
+/// built is dropped
+void owner_loader_stop(owner_loader_t *loader);
+
+/// @brief Matches of one lookup, owned by whoever holds the pointer
+typedef struct owner_result_t {
+  owner_matches_t matches;
+  uint64_t generation;
+  uint64_t elapsed_ns; // Time the lookup took
+
+} owner_result_t;
+
+/// @brief Background thread that runs `owner_index_lookup`, so that substring
+/// scans over every path stay off the UI thread. Newer query cancels the scan
+/// in flight, finished result is published with an atomic pointer swap
+typedef struct owner_worker_t {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // Signaled on new request or stop
+
+  const owner_index_t *index;
+
+  // Request, protected by `lock`
+  char query[OWNER_QUERY_MAX];
+  uint64_t finished;
+  bool stop;
+
+  _Atomic uint64_t latest;             // Generation of the newest request
+  _Atomic(owner_result_t *) published; // Newest finished result, or NULL
+
+} owner_worker_t;
+
+/// @brief Start lookup thread
+/// @note Index must not change until `owner_worker_stop`
+///
+/// @return Allocated owner_worker_t struct or NULL
+owner_worker_t *owner_worker_start(const owner_index_t *index);
+
+/// @brief Ask worker to look up query, canceling the lookup in flight
+///
+/// @return Generation of request, result carries the same one
+uint64_t owner_worker_submit(owner_worker_t *worker, const char *query);
+
+/// @brief Take the newest published result, never blocks
+/// @note Return value should be freed after usage
+///
+/// @return owner_result_t struct or NULL if nothing new was published
+owner_result_t *owner_worker_take(owner_worker_t *worker);
+
+/// @brief Stop lookup thread and free its resources
+void owner_worker_stop(owner_worker_t *worker);
+
+/// @brief Cleanup functions
+void owner_index_cleanup(owner_index_t *index);
+void owner_matches_cleanup(owner_matches_t *matches);
+void owner_result_cleanup(owner_result_t *result);
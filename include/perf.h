@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Measurements of the session shown by the stats overlay
+/// @note Durations are of the last occurrence, in nanoseconds
+typedef struct perf_stats_t {
+  bool visible; // Overlay is on screen
+
+  uint64_t started;   // Start of `model_t_init`
+  uint64_t load_ns;   // Until the catalog was complete, 0 while loading
+  uint64_t filter_ns; // Filter pass on the search worker
+  uint64_t draw_ns;   // Drawing of planes for the last frame
+  uint64_t render_ns; // notcurses_render of the last frame
+  size_t events;      // Input events applied before the last frame
+  uint64_t frames;
+
+} perf_stats_t;
+
+/// @brief Monotonic clock in nanoseconds
+uint64_t perf_now(void);
+
+/// @brief Record every span of the session to `path` in Chrome trace format,
+/// which chrome://tracing and Perfetto open
+/// @note Has to be called before any thread is started and closed after all of
+/// them were stopped
+///
+/// @return true on success, false on error
+bool perf_trace_open(const char *path);
+
+/// @brief Finish the trace, file isn't valid JSON until it's closed
+void perf_trace_close(void);
+
+/// @brief End span of `name` that started at `start`, see `perf_now`
+/// @note Span is written to the trace only if one is open. `name` has to be a
+/// string literal, it isn't escaped
+///
+/// @return Duration of span in nanoseconds
+uint64_t perf_span(const char *name, uint64_t start);
+
+/// @brief Record value of a counter, e.g. number of matches, as a track of the
+/// trace
+void perf_counter(const char *name, uint64_t value);
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "arena.h"
+
 #include <stdbool.h>
 #include <stdint.h>
 #include <xbps.h>
@@ -18,24 +20,120 @@ typedef struct package_info_t {
   char *maintainer;
   char *homepage;
   char *license;
-  char *installed_size;
-  char *repository;  // only for online repo
-  pkg_state_t state; // only for local repo
+  char *installed_size; // humanized, e.g. "12MB"
+  char *repository;     // only for online repo
+  pkg_state_t state;    // only for local repo
 
 } package_info_t;
 
+/// @brief Package in search_result_t catalog, strings are stored as offsets
+/// into the catalog's arenas
+/// @note Only searchable fields are kept, the rest is loaded on demand with
+/// `get_package_info`
+typedef struct package_entry_t {
+  uint32_t pkgver;         // offset into `pkgvers`
+  uint32_t short_desc;     // offset into `short_descs`
+  uint32_t repository;     // offset into `details`, only for online repo
+  uint32_t installed;      // offset of installed version into `details`, only
+                           // for online repo joined with pkgdb
+  pkg_state_t state;       // for local repo and online repo joined with pkgdb
+  uint16_t name_len;       // Name part of `pkgver`, version follows the dash
+  uint64_t installed_size; // bytes, 0 if unknown
+  int64_t install_date;    // from pkgdb, seconds since epoch or 0
+
+} package_entry_t;
+
 typedef struct search_result_t {
-  package_info_t *packages;
+  package_entry_t *packages;
   uint32_t count;
+  uint32_t cap;
+  REPO_TYPE repo_type;
+
+  string_arena_t pkgvers;     // Hot search columns, each in its own blob
+  string_arena_t short_descs; //
+  string_arena_t details;     // All other strings
+
+  void *mapping;       // Mapped cache file the arrays point into, catalog is
+  size_t mapping_size; // read-only when set, see catalog_cache.h
 
 } search_result_t;
 
+/// @brief Accessors for strings of `idx`-th package of catalog
+///
+/// @return Pointer into the catalog or NULL if package doesn't have it
+static inline const char *search_result_pkgver(const search_result_t *result, uint32_t idx) {
+  return string_arena_get(&result->pkgvers, result->packages[idx].pkgver);
+}
+
+/// @note Version is split off once when the package is appended
+static inline const char *search_result_version(const search_result_t *result, uint32_t idx) {
+  const char *pkgver = search_result_pkgver(result, idx);
+  size_t len = result->packages[idx].name_len;
+  return pkgver[len] ? pkgver + len + 1 : pkgver + len;
+}
+
+static inline const char *search_result_short_desc(const search_result_t *result, uint32_t idx) {
+  return string_arena_get(&result->short_descs, result->packages[idx].short_desc);
+}
+
+static inline const char *search_result_installed(const search_result_t *result, uint32_t idx) {
+  return string_arena_get(&result->details, result->packages[idx].installed);
+}
+
+static inline const char *search_result_detail(const search_result_t *result, uint32_t offset) {
+  return string_arena_get(&result->details, offset);
+}
+
+/// @brief Paths of package's files, stored in one arena
 typedef struct package_files_t {
-  char **data;
+  uint32_t *offsets; // Offset of each path in `paths`
   uint32_t count;
+  uint32_t cap;
+  string_arena_t paths;
 
 } package_files_t;
 
+/// @brief Path of `idx`-th file
+static inline const char *package_files_get(const package_files_t *files, uint32_t idx) {
+  return string_arena_get(&files->paths, files->offsets[idx]);
+}
+
+/// @brief Where libxbps looks for packages, NULL fields keep the defaults
+typedef struct search_config_t {
+  const char *rootdir;
+  const char *confdir;
+  const char *const *repositories; // Searched before the configured ones
+  size_t repositories_count;
+
+} search_config_t;
+
+/// @brief Called every time all packages of a repository were appended to
+/// `results`
+///
+/// @return false to stop searching
+typedef bool (*search_progress_cb)(const search_result_t *results, void *arg);
+
+/// @brief Initializes libxbps handle with config and reads pkgdb into it
+/// @note Handle should be freed with `xbps_end`
+///
+/// @return true on success, false on error
+bool search_handle_init(struct xbps_handle *xhp, const search_config_t *config);
+
+/// @brief Read pkgdb of `xhp` again
+/// @note libxbps reads pkgdb in `xbps_pkgdb_update`, which keeps its result in
+/// a static shared by every handle. Threads only read pkgdb through this
+/// function and `search_handle_init`, and write it between
+/// `search_pkgdb_acquire` and `search_pkgdb_release`, so never two at once
+/// @param wait Wait for the thread that uses pkgdb instead of giving up
+///
+/// @return false if another thread used pkgdb and `wait` wasn't set
+bool search_pkgdb_update(struct xbps_handle *xhp, bool wait);
+
+/// @brief Keep other threads away from pkgdb while libxbps reads or writes it,
+/// e.g. for the whole commit of a transaction
+void search_pkgdb_acquire(void);
+void search_pkgdb_release(void);
+
 /// @brief Search for packages in a repositories
 /// @note Return value should be freed after usage
 /// @param xhp Generic XBPS structure handler for initialization
@@ -45,6 +143,40 @@ typedef struct package_files_t {
 search_result_t *search_packages(struct xbps_handle *xhp, const char *pattern, REPO_TYPE repo_type,
                                  bool use_regex);
 
+/// @brief Same as `search_packages`, but reports every finished repository
+/// @param progress Called from the calling thread, may be NULL
+///
+/// @return Allocated search_result_t struct or NULL
+search_result_t *search_packages_progress(struct xbps_handle *xhp, const char *pattern,
+                                          REPO_TYPE repo_type, bool use_regex,
+                                          search_progress_cb progress, void *arg);
+
+/// @brief Search one repository that is already open, appending its matching
+/// packages to `results`, what `search_packages` does for every repository of
+/// the pool
+/// @note Index of repository may also be built in memory, e.g. for benchmarks
+///
+/// @return true on success, false on error, e.g. regex that doesn't compile
+bool search_repository(struct xbps_repo *repo, const char *pattern, bool use_regex,
+                       search_result_t *results);
+
+/// @brief Append package to the end of catalog
+/// @note Only `pkgver` and `short_desc` are set, other offsets are NO_STRING.
+/// Mapped catalog can't be appended to
+///
+/// @return Pointer to the new entry, valid until the next append, or NULL
+package_entry_t *search_result_append(search_result_t *results, const char *pkgver,
+                                      const char *short_desc);
+
+/// @brief Deep copy of catalog, the copy is never mapped
+/// @note Return value should be freed after usage
+///
+/// @return Allocated search_result_t struct or NULL
+search_result_t *search_result_copy(const search_result_t *result);
+
+/// @brief Bytes taken by catalog, the whole file if it's mapped
+size_t search_result_memory(const search_result_t *result);
+
 /// @brief Get full package info
 /// @note Return value should be freed after usage
 /// @param xhp Generic XBPS structure handler for initialization
@@ -65,4 +197,4 @@ package_files_t *get_package_files(struct xbps_handle *xhp, const char *pkgname,
 /// @brief Cleanup functions
 void search_result_cleanup(search_result_t *result);
 void package_info_cleanup(package_info_t *info);
-void package_files_cleanup(package_files_t *files, unsigned int count);
+void package_files_cleanup(package_files_t *files);
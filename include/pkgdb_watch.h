@@ -0,0 +1,46 @@
+#pragma once
+
+#include "pkg_search.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <xbps.h>
+
+/// @brief How long pkgdb has to stay untouched before it's loaded, in
+/// milliseconds. One xbps-install run writes it several times
+#define PKGDB_WATCH_SETTLE_MS 200
+
+/// @brief Background thread that watches pkgdb with inotify and loads the
+/// installed packages again whenever it was written, by xui or anything else
+/// @note Every load has its own libxbps handle, initialized for it alone.
+/// Catalog is loaded with `catalog_load`, so the cache file follows pkgdb as
+/// well
+typedef struct pkgdb_watch_t {
+  pthread_t thread;
+  int inotify; // Watches the directory of pkgdb, it's replaced by rename
+  int wake;    // eventfd, signaled on stop
+  int notify;  // eventfd, signaled whenever a catalog is published
+
+  search_config_t config;
+
+  _Atomic(search_result_t *) published; // Newest installed packages, or NULL
+
+} pkgdb_watch_t;
+
+/// @brief Start watching pkgdb in `metadir`
+/// @note `config` strings have to outlive the watcher
+///
+/// @return Allocated pkgdb_watch_t struct or NULL
+pkgdb_watch_t *pkgdb_watch_start(const search_config_t *config, const char *metadir);
+
+/// @brief Take the newest catalog of installed packages, never blocks
+/// @note Return value should be freed with `search_result_cleanup`. `notify`
+/// is drained, so it can be polled together with input
+///
+/// @return search_result_t struct or NULL if pkgdb didn't change
+search_result_t *pkgdb_watch_take(pkgdb_watch_t *watch);
+
+/// @brief Stop watcher thread and free its resources
+/// @note Catalog that is being loaded is finished first
+void pkgdb_watch_stop(pkgdb_watch_t *watch);
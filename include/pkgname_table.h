@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct search_result_t search_result_t;
+
+/// @brief Returned by lookups of a package that isn't in the table
+#define PKGNAME_NOT_FOUND UINT32_MAX
+
+typedef struct pkgname_slot_t {
+  uint32_t hash;
+  uint32_t idx; // Package index, PKGNAME_NOT_FOUND for an empty slot
+
+} pkgname_slot_t;
+
+/// @brief Open-addressing hash table from package name to index in catalog
+/// @note Names aren't copied, the table points into the catalog it was built
+/// from
+typedef struct pkgname_table_t {
+  const search_result_t *packages;
+  pkgname_slot_t *slots;
+  uint32_t mask; // Number of slots - 1, power of two
+
+} pkgname_table_t;
+
+/// @brief Build table over every package of catalog. For names that appear
+/// more than once the first package wins
+///
+/// @return true on success, false on error
+bool pkgname_table_build(pkgname_table_t *table, const search_result_t *packages);
+
+/// @brief Look package up by the first `len` bytes of `name`
+///
+/// @return Index of package in catalog or PKGNAME_NOT_FOUND
+uint32_t pkgname_table_find(const pkgname_table_t *table, const char *name, size_t len);
+
+/// @brief Cleanup function
+void pkgname_table_cleanup(pkgname_table_t *table);
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Most literals kept for a pattern, the longest ones win
+#define REGEX_LITERALS_MAX 8
+
+/// @brief Shorter literals are dropped, a single byte rules out too little to
+/// pay for the substring search
+#define REGEX_LITERAL_MIN 2
+
+/// @brief Room for literals of a pattern up to this length
+#define REGEX_LITERALS_TEXT 512
+
+/// @brief Literal substrings that every match of a regex has to contain
+typedef struct regex_literals_t {
+  char text[REGEX_LITERALS_TEXT];        // Literals, each terminated by NUL
+  uint16_t offsets[REGEX_LITERALS_MAX];  // Start of each literal in `text`
+  uint16_t lengths[REGEX_LITERALS_MAX];  // Longest literal comes first
+  size_t count;
+
+} regex_literals_t;
+
+/// @brief `idx`-th literal, the longest one is at 0
+static inline const char *regex_literals_get(const regex_literals_t *literals, size_t idx) {
+  return literals->text + literals->offsets[idx];
+}
+
+/// @brief Pull required literals out of a POSIX extended regex, so that text
+/// can be ruled out with a substring search before running `regexec`
+/// @note Extraction is conservative: groups, brackets, escapes of letters and
+/// non-ASCII bytes end a literal, and alternation at the top level leaves no
+/// literals at all. Pattern has to compile, literals of an invalid pattern are
+/// meaningless
+void regex_literals_extract(const char *pattern, regex_literals_t *literals);
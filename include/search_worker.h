@@ -0,0 +1,67 @@
+#pragma once
+
+#include "filter.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/// @brief Background thread that runs filter passes over an immutable catalog
+/// snapshot. Newer query cancels the pass in flight, finished result is
+/// published with an atomic pointer swap
+typedef struct search_worker_t {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // Signaled on new request or stop
+  pthread_cond_t done; // Signaled when a request is finished
+
+  filter_t filter; // Owned by the worker thread
+
+  // Request, protected by `lock`
+  char query[FILTER_QUERY_MAX];
+  MATCH_MODE mode;
+  size_t ranked; // How many matches to rank before publishing
+  uint64_t finished;
+  bool busy; // Pass is running, `filter` is in use
+  bool stop;
+
+  _Atomic uint64_t latest;                // Generation of the newest request
+  _Atomic(filter_result_t *) published;   // Newest finished result, or NULL
+
+} search_worker_t;
+
+/// @brief Start worker thread
+/// @note Catalog and index must not change until `search_worker_stop`
+///
+/// @return Allocated search_worker_t struct or NULL
+search_worker_t *search_worker_start(const search_result_t *packages,
+                                     const trigram_index_t *index);
+
+/// @brief Switch worker to another catalog snapshot, canceling the pass in
+/// flight
+/// @note Blocks until the worker stops using the old catalog, which may be
+/// freed afterwards. Query has to be submitted again
+///
+/// @return true on success, false on error
+bool search_worker_set_catalog(search_worker_t *worker,
+                               const search_result_t *packages,
+                               const trigram_index_t *index);
+
+/// @brief Ask worker to filter catalog, canceling the pass in flight
+///
+/// @return Generation of request, result carries the same one
+uint64_t search_worker_submit(search_worker_t *worker, const char *query,
+                              MATCH_MODE mode, size_t ranked);
+
+/// @brief Take the newest published result, never blocks
+/// @note Return value should be freed after usage
+///
+/// @return filter_result_t struct or NULL if nothing new was published
+filter_result_t *search_worker_take(search_worker_t *worker);
+
+/// @brief Block until request of `generation` (or a newer one) is finished
+void search_worker_wait(search_worker_t *worker, uint64_t generation);
+
+/// @brief Stop worker thread and free its resources
+void search_worker_stop(search_worker_t *worker);
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "pkg_search.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Order of the package list
+/// @note Every order breaks ties by package name, so it's a total order
+typedef enum SORT_ORDER {
+  SORT_MATCH = 0,      // Order of the matcher, pkgdb order or fuzzy score
+  SORT_NAME = 1,       //
+  SORT_VERSION = 2,    // Newest first
+  SORT_DATE = 3,       // Most recently installed first, unknown date last
+  SORT_SIZE = 4,       // Largest installed size first
+  SORT_REPOSITORY = 5, // Order of repositories, installed from elsewhere last
+  SORT_ORDERS = 6,     // Number of orders
+
+} SORT_ORDER;
+
+/// @brief Name of order shown next to the input, e.g. "by name"
+const char *sort_order_label(SORT_ORDER order);
+
+/// @brief Permutation of catalog in `order`
+/// @note Packages are radix sorted by a 32-bit key first, only packages with
+/// equal keys are compared. Return value should be freed after usage
+/// @param by_name Permutation of SORT_NAME or NULL. With it ties are already
+/// in order, and orders whose key is the whole value take no comparisons
+///
+/// @return Array of `packages->count` indices, NULL for SORT_MATCH or on error
+uint32_t *sort_order_build(const search_result_t *packages, SORT_ORDER order,
+                           const uint32_t *by_name);
+
+/// @brief Put `indices` in the order of `permutation` by walking it against a
+/// bitmap of the indices, O(`packages_count`) whatever their number is
+/// @param packages_count Length of `permutation`, every index is below it
+///
+/// @return true on success, false on error, in which case `indices` are intact
+bool sort_order_apply(const uint32_t *permutation, uint32_t packages_count,
+                      size_t *indices, size_t count);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Upper bound of threads in a pool
+#define THREAD_POOL_MAX 64
+
+/// @brief Task function, called once for every task index of a run
+typedef void (*thread_pool_task)(void *arg, size_t task);
+
+/// @brief Small persistent pool of threads that run batches of tasks
+typedef struct thread_pool_t {
+  pthread_t threads[THREAD_POOL_MAX];
+  size_t count; // Number of threads, the caller of `thread_pool_run` is extra
+  pthread_mutex_t lock;
+  pthread_cond_t work; // Signaled on new batch or stop
+  pthread_cond_t done; // Signaled when the last task of batch is finished
+
+  // Current batch, protected by `lock`
+  thread_pool_task fn;
+  void *arg;
+  size_t tasks;
+  size_t next;     // Next task to take
+  size_t finished; // Number of finished tasks
+  uint64_t batch;  // Incremented for every batch
+  bool stop;
+
+} thread_pool_t;
+
+/// @brief Start pool of threads
+/// @param threads Number of threads, 0 to use one per online CPU minus one
+///
+/// @return Allocated thread_pool_t struct or NULL. Pool without threads is
+/// valid, tasks then run on the calling thread
+thread_pool_t *thread_pool_create(size_t threads);
+
+/// @brief Run tasks `0..tasks-1` and wait for all of them
+/// @note Calling thread runs tasks too. Only one thread may call it at a time
+void thread_pool_run(thread_pool_t *pool, size_t tasks, thread_pool_task fn, void *arg);
+
+/// @brief Stop threads and free pool
+void thread_pool_destroy(thread_pool_t *pool);
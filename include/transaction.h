@@ -0,0 +1,122 @@
+#pragma once
+
+#include "arena.h"
+#include "pkg_search.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <xbps.h>
+
+/// @brief What is asked for a marked package
+typedef enum TRANSACTION_ACTION {
+  TRANSACTION_INSTALL = 0,
+  TRANSACTION_REMOVE = 1,
+
+} TRANSACTION_ACTION;
+
+/// @brief Phase of a transaction, it only moves forward
+typedef enum TRANSACTION_PHASE {
+  TRANSACTION_RESOLVING = 0, // Dependencies are being resolved
+  TRANSACTION_READY = 1,     // Summary is known, waiting for confirmation
+  TRANSACTION_RUNNING = 2,   // Packages are fetched, unpacked and configured
+  TRANSACTION_DONE = 3,      //
+  TRANSACTION_FAILED = 4,    // Message of the status says why
+
+} TRANSACTION_PHASE;
+
+/// @brief Package that the transaction touches
+typedef struct transaction_step_t {
+  uint32_t pkgver; // offset into `pkgvers` of the summary
+  uint8_t type;    // xbps_trans_type_t
+
+} transaction_step_t;
+
+/// @brief Transaction as `xbps_transaction_prepare` computed it
+typedef struct transaction_summary_t {
+  transaction_step_t *steps; // In order of unpacking
+  uint32_t count;
+  string_arena_t pkgvers;
+
+  uint64_t download_size;  // Bytes to fetch, packages in cachedir excluded
+  uint64_t installed_size; // Bytes taken by new packages and updates
+  uint64_t removed_size;   // Bytes freed by removals and updates
+
+} transaction_summary_t;
+
+/// @brief Progress of a transaction, see `transaction_status`
+typedef struct transaction_status_t {
+  TRANSACTION_PHASE phase;
+  uint32_t done;     // Packages installed, updated or removed so far
+  char message[256]; // Latest state reported by libxbps, or the error
+
+} transaction_status_t;
+
+/// @brief Background thread that installs and removes marked packages in one
+/// libxbps transaction: dependencies are resolved once, every package is
+/// fetched before anything is unpacked, pkgdb is written once
+/// @note Transaction has its own libxbps handle, so the UI keeps working while
+/// it runs. It's committed only after `transaction_confirm`, pkgdb stays locked
+/// from resolving until the commit or cancel
+typedef struct transaction_t {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake; // Signaled on confirmation or stop
+
+  struct xbps_handle xhp; // Owned by the transaction thread
+  search_config_t config;
+
+  string_arena_t pkgnames; // Marked packages, one after another
+  uint8_t *actions;        // TRANSACTION_ACTION of each
+  uint32_t count;
+
+  // Protected by `lock`
+  transaction_status_t status;
+  uint64_t updates; // Bumped with every change of `status`
+  bool confirmed;
+  bool stop;
+
+  transaction_summary_t summary; // Written before READY, read-only after
+
+} transaction_t;
+
+/// @brief Start resolving a transaction of `count` packages in background
+/// @note `config` strings have to outlive the transaction, `pkgnames` are
+/// copied. Testing it needs nothing but a rootdir and a local repository in
+/// the config
+///
+/// @return Allocated transaction_t struct or NULL
+transaction_t *transaction_start(const search_config_t *config, const char *const *pkgnames,
+                                 const TRANSACTION_ACTION *actions, uint32_t count);
+
+/// @brief Copy status if it changed since the last call, never blocks for
+/// longer than libxbps reports a state
+/// @param seen Updates already copied, 0 before the first call
+///
+/// @return true if `status` was updated
+bool transaction_status(transaction_t *transaction, transaction_status_t *status,
+                        uint64_t *seen);
+
+/// @brief Summary of a transaction that got past RESOLVING
+///
+/// @return Pointer into the transaction or NULL while it's still resolving
+const transaction_summary_t *transaction_summary(transaction_t *transaction);
+
+/// @brief Commit a READY transaction
+///
+/// @return true if transaction was waiting for it
+bool transaction_confirm(transaction_t *transaction);
+
+/// @brief Name of step's type, e.g. "install"
+const char *transaction_step_label(const transaction_step_t *step);
+
+/// @brief Ask transaction to quit unless it's running, never blocks
+/// @note Resolving isn't interrupted, thread quits once it's READY or FAILED.
+/// It's still freed with `transaction_stop`
+void transaction_cancel(transaction_t *transaction);
+
+/// @brief Cancel transaction unless it's running, stop its thread and free
+/// its resources
+/// @note Blocks until resolving or a running transaction is finished, a
+/// half-unpacked package would break the system
+void transaction_stop(transaction_t *transaction);
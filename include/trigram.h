@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct search_result_t search_result_t;
+
+/// @brief Shortest query that can be answered by the index
+#define TRIGRAM_MIN_QUERY 3
+
+/// @brief Posting-list index of case-folded trigrams of `pkgver` and
+/// `short_desc`, stored as CSR arrays
+typedef struct trigram_index_t {
+  uint32_t *keys;     // Sorted distinct trigrams, 3 folded bytes each
+  uint32_t *offsets;  // `keys_count + 1` offsets into `postings`
+  uint32_t *postings; // Package indices, ascending for each trigram
+  uint32_t keys_count;
+  uint32_t postings_count;
+
+} trigram_index_t;
+
+/// @brief Build index over every package of catalog
+/// @note Return value should be freed after usage
+///
+/// @return Allocated trigram_index_t struct or NULL
+trigram_index_t *trigram_index_build(const search_result_t *packages);
+
+/// @brief Upper bound of candidates for query, cheap to compute
+///
+/// @return Size of the shortest posting list of query, SIZE_MAX if query is
+/// shorter than TRIGRAM_MIN_QUERY
+size_t trigram_index_estimate(const trigram_index_t *index, const char *query);
+
+/// @brief Collect packages containing every trigram of query
+/// @note Candidates are a superset of the matches and are written in
+/// ascending order, so they still have to be checked with the real matcher
+/// @param out Buffer for at least `trigram_index_estimate()` indices
+///
+/// @return Number of candidates written to `out`
+size_t trigram_index_query(const trigram_index_t *index, const char *query, size_t *out);
+
+/// @brief Memory used by the index, in bytes
+size_t trigram_index_memory(const trigram_index_t *index);
+
+/// @brief Cleanup function
+void trigram_index_cleanup(trigram_index_t *index);
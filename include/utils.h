@@ -1,5 +1,39 @@
 #pragma once
 
+#include <stddef.h>
+#include <string.h>
+
+/// @brief Fold ASCII letter to lower case, other bytes are returned as is
+static inline unsigned char fold_ascii(unsigned char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/// @brief Length of the package name part of `name-version_revision`
+///
+/// @return Offset of the last '-', or the whole length if there's none
+static inline size_t pkgver_name_len(const char *pkgver) {
+  const char *dash = strrchr(pkgver, '-');
+  return dash ? (size_t)(dash - pkgver) : strlen(pkgver);
+}
+
+/// @brief Kernels behind strcasestr_portable, from the slowest one
+typedef enum STRCASESTR_KERNEL {
+  STRCASESTR_SCALAR = 0,
+  STRCASESTR_SSE2 = 1,
+  STRCASESTR_AVX2 = 2,
+
+} STRCASESTR_KERNEL;
+
 /// @brief Portable version of strcasestr
 /// Locate a substring in a string
+/// @note Only ASCII letters are compared case-insensitively. SSE2/AVX2 kernel is
+/// picked once, on the first call, when the CPU supports it
 const char *strcasestr_portable(const char *haystack, const char *needle);
+
+/// @brief Best kernel this CPU supports, the one strcasestr_portable uses
+STRCASESTR_KERNEL strcasestr_kernel(void);
+
+/// @brief strcasestr_portable with a fixed kernel, for tests and benchmarks
+/// @note `kernel` must not be better than `strcasestr_kernel()`
+const char *strcasestr_with(STRCASESTR_KERNEL kernel, const char *haystack,
+                            const char *needle);
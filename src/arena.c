@@ -0,0 +1,74 @@
+#include "arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_MIN_CAP 4096
+
+bool string_arena_reserve(string_arena_t *arena, uint32_t bytes) {
+  if (!arena)
+    return false;
+
+  if ((uint64_t)arena->len + bytes <= arena->cap)
+    return true;
+
+  // Offsets are 32-bit, so the arena can't grow past 4 GiB
+  uint64_t needed = (uint64_t)arena->len + bytes;
+  if (needed >= NO_STRING)
+    return false;
+
+  uint64_t cap = arena->cap > 0 ? arena->cap : ARENA_MIN_CAP;
+  while (cap < needed)
+    cap *= 2;
+  if (cap >= NO_STRING)
+    cap = NO_STRING - 1;
+
+  char *data = realloc(arena->data, cap);
+  if (!data)
+    return false;
+
+  arena->data = data;
+  arena->cap = (uint32_t)cap;
+  return true;
+}
+
+uint32_t string_arena_push(string_arena_t *arena, const char *str) {
+  if (!arena || !str)
+    return NO_STRING;
+
+  size_t size = strlen(str) + 1;
+  if (size >= NO_STRING || !string_arena_reserve(arena, (uint32_t)size))
+    return NO_STRING;
+
+  uint32_t offset = arena->len;
+  memcpy(arena->data + offset, str, size);
+  arena->len += (uint32_t)size;
+
+  return offset;
+}
+
+bool string_arena_copy(string_arena_t *dst, const string_arena_t *src) {
+  if (!dst || !src)
+    return false;
+
+  *dst = (string_arena_t){0};
+  if (src->len == 0)
+    return true;
+
+  if (!string_arena_reserve(dst, src->len))
+    return false;
+
+  memcpy(dst->data, src->data, src->len);
+  dst->len = src->len;
+  return true;
+}
+
+void string_arena_cleanup(string_arena_t *arena) {
+  if (!arena)
+    return;
+
+  if (arena->data)
+    free(arena->data);
+
+  *arena = (string_arena_t){0};
+}
@@ -0,0 +1,347 @@
+#include "catalog_cache.h"
+
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define CACHE_MAGIC "XUICATL"
+#define CACHE_ALIGN 8
+
+/// On-disk layout: header, package_entry_t array and the three string blobs,
+/// each section aligned to CACHE_ALIGN. Native byte order, the cache is never
+/// shared between machines
+struct cache_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t entry_size; // sizeof(package_entry_t) of the writer
+  uint64_t fingerprint;
+  uint32_t repo_type;
+  uint32_t count;
+  uint64_t packages_off;
+  uint64_t pkgvers_off;
+  uint64_t short_descs_off;
+  uint64_t details_off;
+  uint32_t pkgvers_len;
+  uint32_t short_descs_len;
+  uint32_t details_len;
+  uint32_t reserved;
+};
+
+/* ============= Fingerprint ============= */
+
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+static uint64_t fnv_update(uint64_t hash, const void *data, size_t len) {
+  const unsigned char *bytes = data;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+// Mix path, mtime, size and content of file into hash
+static bool fingerprint_file(uint64_t *hash, const char *path) {
+  *hash = fnv_update(*hash, path, strlen(path) + 1);
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+
+  int64_t meta[3] = {st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_size};
+  *hash = fnv_update(*hash, meta, sizeof(meta));
+
+  char buf[1 << 16];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0)
+    *hash = fnv_update(*hash, buf, (size_t)n);
+
+  close(fd);
+  return n == 0;
+}
+
+bool catalog_fingerprint(struct xbps_handle *xhp, REPO_TYPE repo_type,
+                         uint64_t *fingerprint) {
+  uint64_t hash = FNV_OFFSET;
+  uint32_t header[2] = {CATALOG_CACHE_VERSION, (uint32_t)repo_type};
+  hash = fnv_update(hash, header, sizeof(header));
+
+  char path[PATH_MAX];
+  bool found = false;
+
+  if (repo_type == LOCAL) {
+    snprintf(path, sizeof(path), "%s/%s", xhp->metadir, XBPS_PKGDB);
+    found = fingerprint_file(&hash, path);
+  } else {
+    const char *arch = xhp->target_arch ? xhp->target_arch : xhp->native_arch;
+
+    for (unsigned int i = 0; i < xbps_array_count(xhp->repositories); i++) {
+      const char *uri = NULL;
+      xbps_array_get_cstring_nocopy(xhp->repositories, i, &uri);
+      if (!uri)
+        continue;
+
+      char *repo_path = xbps_repo_path(xhp, uri);
+      if (!repo_path)
+        continue;
+
+      snprintf(path, sizeof(path), "%s/%s-repodata", repo_path, arch);
+      free(repo_path);
+
+      // Repo that isn't synced yet still changes the fingerprint by its path
+      if (fingerprint_file(&hash, path))
+        found = true;
+    }
+  }
+
+  *fingerprint = hash;
+  return found;
+}
+
+/* ============= Cache file ============= */
+
+bool catalog_cache_path(char *buf, size_t size, const char *name,
+                        bool create) {
+  const char *xdg = getenv("XDG_CACHE_HOME");
+  const char *home = getenv("HOME");
+  char dir[PATH_MAX];
+
+  if (xdg && *xdg)
+    snprintf(dir, sizeof(dir), "%s", xdg);
+  else if (home && *home)
+    snprintf(dir, sizeof(dir), "%s/.cache", home);
+  else
+    return false;
+
+  if (create)
+    mkdir(dir, 0755);
+
+  size_t len = strlen(dir);
+  snprintf(dir + len, sizeof(dir) - len, "/xui");
+  if (create)
+    mkdir(dir, 0755);
+
+  int n = snprintf(buf, size, "%s/%s", dir, name);
+  return n > 0 && (size_t)n < size;
+}
+
+FILE *catalog_cache_create(const char *path, char *tmp, size_t size) {
+  int n = snprintf(tmp, size, "%s.XXXXXX", path);
+  if (n < 0 || (size_t)n >= size)
+    return NULL;
+
+  int fd = mkostemp(tmp, O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  FILE *file = fdopen(fd, "wb");
+  if (!file) {
+    close(fd);
+    unlink(tmp);
+  }
+
+  return file;
+}
+
+static inline const char *cache_name(REPO_TYPE repo_type) {
+  return repo_type == REMOTE ? "catalog-remote.bin" : "catalog-local.bin";
+}
+
+static inline uint64_t align_up(uint64_t off) {
+  return (off + CACHE_ALIGN - 1) & ~(uint64_t)(CACHE_ALIGN - 1);
+}
+
+static bool write_section(FILE *file, uint64_t off, const void *data,
+                          size_t len) {
+  static const char zeros[CACHE_ALIGN] = {0};
+
+  long pos = ftell(file);
+  if (pos < 0 || (uint64_t)pos > off ||
+      fwrite(zeros, 1, off - (uint64_t)pos, file) != off - (uint64_t)pos)
+    return false;
+
+  return len == 0 || fwrite(data, 1, len, file) == len;
+}
+
+bool catalog_cache_write(const search_result_t *catalog,
+                         uint64_t fingerprint) {
+  if (!catalog)
+    return false;
+
+  char path[PATH_MAX], tmp[PATH_MAX];
+  if (!catalog_cache_path(path, sizeof(path), cache_name(catalog->repo_type),
+                          true))
+    return false;
+
+  struct cache_header header = {
+      .magic = CACHE_MAGIC,
+      .version = CATALOG_CACHE_VERSION,
+      .entry_size = sizeof(package_entry_t),
+      .fingerprint = fingerprint,
+      .repo_type = (uint32_t)catalog->repo_type,
+      .count = catalog->count,
+      .pkgvers_len = catalog->pkgvers.len,
+      .short_descs_len = catalog->short_descs.len,
+      .details_len = catalog->details.len,
+  };
+  header.packages_off = align_up(sizeof(header));
+  header.pkgvers_off = align_up(header.packages_off +
+                                (uint64_t)catalog->count *
+                                    sizeof(package_entry_t));
+  header.short_descs_off = align_up(header.pkgvers_off + header.pkgvers_len);
+  header.details_off =
+      align_up(header.short_descs_off + header.short_descs_len);
+
+  FILE *file = catalog_cache_create(path, tmp, sizeof(tmp));
+  if (!file)
+    return false;
+
+  bool ok =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      write_section(file, header.packages_off, catalog->packages,
+                    catalog->count * sizeof(package_entry_t)) &&
+      write_section(file, header.pkgvers_off, catalog->pkgvers.data,
+                    header.pkgvers_len) &&
+      write_section(file, header.short_descs_off, catalog->short_descs.data,
+                    header.short_descs_len) &&
+      write_section(file, header.details_off, catalog->details.data,
+                    header.details_len);
+
+  if (fclose(file) != 0)
+    ok = false;
+
+  // Readers see either the old file or the complete new one
+  if (!ok || rename(tmp, path) != 0) {
+    unlink(tmp);
+    return false;
+  }
+
+  return true;
+}
+
+static bool section_fits(uint64_t off, uint64_t len, size_t size) {
+  return off <= size && len <= size - off;
+}
+
+// Blob is empty or its last string is terminated
+static bool blob_valid(const char *base, uint64_t off, uint32_t len) {
+  return len == 0 || base[off + len - 1] == '\0';
+}
+
+static bool offset_valid(uint32_t offset, uint32_t len, bool optional) {
+  return (optional && offset == NO_STRING) || offset < len;
+}
+
+// Name part of pkgver ends within the string, the version is read past it
+static bool name_valid(const char *pkgvers, uint32_t len,
+                       const package_entry_t *pkg) {
+  return pkg->name_len <= strnlen(pkgvers + pkg->pkgver, len - pkg->pkgver);
+}
+
+search_result_t *catalog_cache_map(REPO_TYPE repo_type, uint64_t fingerprint) {
+  char path[PATH_MAX];
+  if (!catalog_cache_path(path, sizeof(path), cache_name(repo_type), false))
+    return NULL;
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(struct cache_header)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = (size_t)st.st_size;
+  char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  const struct cache_header *header = (const struct cache_header *)map;
+  bool valid =
+      memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) == 0 &&
+      header->version == CATALOG_CACHE_VERSION &&
+      header->entry_size == sizeof(package_entry_t) &&
+      header->fingerprint == fingerprint &&
+      header->repo_type == (uint32_t)repo_type &&
+      header->packages_off % CACHE_ALIGN == 0 &&
+      section_fits(header->packages_off,
+                   (uint64_t)header->count * sizeof(package_entry_t), size) &&
+      section_fits(header->pkgvers_off, header->pkgvers_len, size) &&
+      section_fits(header->short_descs_off, header->short_descs_len, size) &&
+      section_fits(header->details_off, header->details_len, size) &&
+      blob_valid(map, header->pkgvers_off, header->pkgvers_len) &&
+      blob_valid(map, header->short_descs_off, header->short_descs_len) &&
+      blob_valid(map, header->details_off, header->details_len);
+
+  // Cheap pass over the entries, so a corrupted file can't send us out of
+  // bounds later
+  const package_entry_t *packages =
+      (const package_entry_t *)(map + header->packages_off);
+  const char *pkgvers = map + header->pkgvers_off;
+  for (uint32_t i = 0; valid && i < header->count; i++) {
+    valid = offset_valid(packages[i].pkgver, header->pkgvers_len, false) &&
+            name_valid(pkgvers, header->pkgvers_len, &packages[i]) &&
+            offset_valid(packages[i].short_desc, header->short_descs_len,
+                         false) &&
+            offset_valid(packages[i].repository, header->details_len, true) &&
+            offset_valid(packages[i].installed, header->details_len, true);
+  }
+
+  search_result_t *result = valid ? calloc(1, sizeof(search_result_t)) : NULL;
+  if (!result) {
+    munmap(map, size);
+    return NULL;
+  }
+
+  result->packages = (package_entry_t *)(map + header->packages_off);
+  result->count = result->cap = header->count;
+  result->repo_type = repo_type;
+  result->pkgvers = (string_arena_t){map + header->pkgvers_off,
+                                     header->pkgvers_len, header->pkgvers_len};
+  result->short_descs =
+      (string_arena_t){map + header->short_descs_off, header->short_descs_len,
+                       header->short_descs_len};
+  result->details = (string_arena_t){map + header->details_off,
+                                     header->details_len, header->details_len};
+  result->mapping = map;
+  result->mapping_size = size;
+
+  return result;
+}
+
+/* ============= Load ============= */
+
+search_result_t *catalog_load(struct xbps_handle *xhp, REPO_TYPE repo_type) {
+  uint64_t fingerprint = 0;
+  bool cacheable = catalog_fingerprint(xhp, repo_type, &fingerprint);
+
+  if (cacheable) {
+    search_result_t *cached = catalog_cache_map(repo_type, fingerprint);
+    if (cached)
+      return cached;
+  }
+
+  search_result_t *catalog = search_packages(xhp, "", repo_type, false);
+
+  // Failing to write cache only costs the next startup
+  if (catalog && cacheable)
+    catalog_cache_write(catalog, fingerprint);
+
+  return catalog;
+}
@@ -0,0 +1,171 @@
+#include "catalog_loader.h"
+#include "catalog_cache.h"
+#include "catalog_merge.h"
+
+#include <stdlib.h>
+
+/* ============= Publishing ============= */
+
+// Hand snapshot over to the UI thread, replacing one it didn't take yet
+static void publish(catalog_loader_t *loader, search_result_t *packages,
+                    bool complete) {
+  catalog_snapshot_t *snapshot = calloc(1, sizeof(catalog_snapshot_t));
+  if (!snapshot) {
+    search_result_cleanup(packages);
+    return;
+  }
+
+  snapshot->packages = packages;
+  snapshot->index = packages ? trigram_index_build(packages) : NULL;
+  snapshot->repos_loaded = atomic_load(&loader->repos_loaded);
+  snapshot->repos_total = atomic_load(&loader->repos_total);
+  snapshot->complete = complete;
+
+  // Older snapshot is a prefix of this one, nobody needs it anymore
+  catalog_snapshot_cleanup(atomic_exchange(&loader->published, snapshot));
+}
+
+// Copy of catalog for UI, joined with installed packages when they are known
+static search_result_t *snapshot_catalog(const catalog_loader_t *loader,
+                                         const search_result_t *packages,
+                                         bool complete) {
+  if (!loader->local)
+    return search_result_copy(packages);
+
+  return catalog_merge(packages, loader->local, &loader->installed, complete);
+}
+
+// Called after every repository, publishes a copy of the catalog so far
+static bool repo_loaded(const search_result_t *results, void *arg) {
+  catalog_loader_t *loader = (catalog_loader_t *)arg;
+
+  size_t loaded = atomic_fetch_add(&loader->repos_loaded, 1) + 1;
+  if (atomic_load(&loader->stop))
+    return false;
+
+  // Last repository is published with the final catalog, without a copy
+  if (loaded < atomic_load(&loader->repos_total)) {
+    search_result_t *copy = snapshot_catalog(loader, results, false);
+    if (copy)
+      publish(loader, copy, false);
+  }
+
+  return true;
+}
+
+/* ============= Loader thread ============= */
+
+static void *loader_main(void *arg) {
+  catalog_loader_t *loader = (catalog_loader_t *)arg;
+
+  if (!search_handle_init(&loader->xhp, &loader->config)) {
+    publish(loader, NULL, true);
+    return NULL;
+  }
+
+  if (loader->repo_type == REMOTE) {
+    atomic_store(&loader->repos_total,
+                 xbps_array_count(loader->xhp.repositories));
+
+    // Usually mapped from cache. Without it packages just aren't joined
+    loader->local = catalog_load(&loader->xhp, LOCAL);
+    if (loader->local &&
+        !pkgname_table_build(&loader->installed, loader->local)) {
+      search_result_cleanup(loader->local);
+      loader->local = NULL;
+    }
+  }
+
+  uint64_t fingerprint = 0;
+  bool cacheable =
+      catalog_fingerprint(&loader->xhp, loader->repo_type, &fingerprint);
+
+  search_result_t *packages =
+      cacheable ? catalog_cache_map(loader->repo_type, fingerprint) : NULL;
+  if (packages) {
+    atomic_store(&loader->repos_loaded, atomic_load(&loader->repos_total));
+  } else {
+    packages = search_packages_progress(&loader->xhp, "", loader->repo_type,
+                                        false, repo_loaded, loader);
+
+    // Partial catalog must not be cached
+    if (packages && cacheable && !atomic_load(&loader->stop))
+      catalog_cache_write(packages, fingerprint);
+  }
+
+  xbps_end(&loader->xhp);
+
+  // Cache keeps the online catalog alone, pkgdb changes independently
+  if (packages && loader->local && !atomic_load(&loader->stop)) {
+    search_result_t *merged = snapshot_catalog(loader, packages, true);
+    if (merged) {
+      search_result_cleanup(packages);
+      packages = merged;
+    }
+  }
+
+  pkgname_table_cleanup(&loader->installed);
+  search_result_cleanup(loader->local);
+  loader->local = NULL;
+
+  // Nobody is going to take it
+  if (atomic_load(&loader->stop)) {
+    search_result_cleanup(packages);
+    return NULL;
+  }
+
+  publish(loader, packages, true);
+  return NULL;
+}
+
+catalog_loader_t *catalog_loader_start(const search_config_t *config,
+                                       REPO_TYPE repo_type) {
+  catalog_loader_t *loader = calloc(1, sizeof(catalog_loader_t));
+  if (!loader)
+    return NULL;
+
+  if (config)
+    loader->config = *config;
+  loader->repo_type = repo_type;
+
+  atomic_init(&loader->stop, false);
+  atomic_init(&loader->repos_loaded, 0);
+  atomic_init(&loader->repos_total, 0);
+  atomic_init(&loader->published, NULL);
+
+  if (pthread_create(&loader->thread, NULL, loader_main, loader) != 0) {
+    free(loader);
+    return NULL;
+  }
+
+  return loader;
+}
+
+catalog_snapshot_t *catalog_loader_take(catalog_loader_t *loader) {
+  return atomic_exchange(&loader->published, NULL);
+}
+
+void catalog_loader_stop(catalog_loader_t *loader) {
+  if (!loader)
+    return;
+
+  atomic_store(&loader->stop, true);
+  pthread_join(loader->thread, NULL);
+
+  catalog_snapshot_cleanup(atomic_exchange(&loader->published, NULL));
+  free(loader);
+}
+
+/* ============= Cleanup functions ============= */
+
+void catalog_snapshot_cleanup(catalog_snapshot_t *snapshot) {
+  if (!snapshot)
+    return;
+
+  if (snapshot->packages)
+    search_result_cleanup(snapshot->packages);
+  if (snapshot->index)
+    trigram_index_cleanup(snapshot->index);
+
+  free(snapshot);
+}
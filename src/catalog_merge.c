@@ -0,0 +1,332 @@
+#include "catalog_merge.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Copy installed version of `local_idx` into `merged` and mark entry with it
+static bool mark_installed(search_result_t *merged, uint32_t idx,
+                           const search_result_t *local, uint32_t local_idx) {
+  const char *version = search_result_version(local, local_idx);
+
+  uint32_t installed = string_arena_push(&merged->details, version);
+  if (installed == NO_STRING)
+    return false;
+
+  merged->packages[idx].installed = installed;
+  merged->packages[idx].state = local->packages[local_idx].state;
+  merged->packages[idx].install_date = local->packages[local_idx].install_date;
+  return true;
+}
+
+search_result_t *catalog_merge(const search_result_t *remote,
+                               const search_result_t *local,
+                               const pkgname_table_t *installed,
+                               bool complete) {
+  if (!remote || !local || !installed)
+    return NULL;
+
+  // Copy is on the heap even if `remote` is mapped
+  search_result_t *merged = search_result_copy(remote);
+  if (!merged)
+    return NULL;
+
+  bool *matched = NULL;
+  if (complete) {
+    matched = calloc(local->count > 0 ? local->count : 1, sizeof(bool));
+    if (!matched)
+      goto error;
+  }
+
+  for (uint32_t i = 0; i < merged->count; i++) {
+    uint32_t local_idx =
+        pkgname_table_find(installed, search_result_pkgver(merged, i),
+                           merged->packages[i].name_len);
+
+    if (local_idx == PKGNAME_NOT_FOUND) {
+      merged->packages[i].state = XBPS_PKG_STATE_NOT_INSTALLED;
+      merged->packages[i].installed = NO_STRING;
+      continue;
+    }
+
+    if (!mark_installed(merged, i, local, local_idx))
+      goto error;
+    if (matched)
+      matched[local_idx] = true;
+  }
+
+  // Packages installed from elsewhere, e.g. from a removed repository
+  for (uint32_t local_idx = 0; complete && local_idx < local->count;
+       local_idx++) {
+    if (matched[local_idx])
+      continue;
+
+    package_entry_t *pkg = search_result_append(
+        merged, search_result_pkgver(local, local_idx),
+        search_result_short_desc(local, local_idx));
+    if (!pkg || !mark_installed(merged, merged->count - 1, local, local_idx))
+      goto error;
+    merged->packages[merged->count - 1].installed_size =
+        local->packages[local_idx].installed_size;
+  }
+
+  free(matched);
+  return merged;
+
+error:
+  free(matched);
+  search_result_cleanup(merged);
+  return NULL;
+}
+
+/* ============= Upgrades ============= */
+
+// Order of entries by name, earlier repository first for the same name
+static int compare_entries(const void *a, const void *b, void *arg) {
+  const search_result_t *merged = arg;
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  size_t len_x = merged->packages[x].name_len;
+  size_t len_y = merged->packages[y].name_len;
+
+  int cmp = memcmp(search_result_pkgver(merged, x),
+                   search_result_pkgver(merged, y),
+                   len_x < len_y ? len_x : len_y);
+  if (cmp == 0)
+    cmp = (len_x > len_y) - (len_x < len_y);
+  if (cmp == 0)
+    cmp = (x > y) - (x < y);
+
+  return cmp;
+}
+
+// Whether entries `x` and `y` are of the same package
+static bool same_name(const search_result_t *merged, uint32_t x, uint32_t y) {
+  size_t len = merged->packages[x].name_len;
+  return len == merged->packages[y].name_len &&
+         memcmp(search_result_pkgver(merged, x),
+                search_result_pkgver(merged, y), len) == 0;
+}
+
+bool catalog_upgrades(const search_result_t *merged, uint64_t *upgradable,
+                      uint32_t *count) {
+  if (!merged || !upgradable || !count)
+    return false;
+
+  *count = 0;
+  if (merged->repo_type != REMOTE)
+    return true;
+
+  // Installed packages are a small part of the catalog, only they are sorted
+  uint32_t installed = 0;
+  for (uint32_t i = 0; i < merged->count; i++) {
+    const package_entry_t *pkg = &merged->packages[i];
+    if (pkg->installed != NO_STRING && pkg->repository != NO_STRING)
+      installed++;
+  }
+
+  uint32_t *entries =
+      malloc((installed > 0 ? installed : 1) * sizeof(uint32_t));
+  if (!entries)
+    return false;
+
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < merged->count && used < installed; i++) {
+    const package_entry_t *pkg = &merged->packages[i];
+    if (pkg->installed != NO_STRING && pkg->repository != NO_STRING)
+      entries[used++] = i;
+  }
+
+  qsort_r(entries, used, sizeof(uint32_t), compare_entries, (void *)merged);
+
+  for (uint32_t i = 0; i < used; i++) {
+    uint32_t idx = entries[i];
+
+    // Package of a later repository is shadowed by the previous entry
+    if (i > 0 && same_name(merged, idx, entries[i - 1]))
+      continue;
+
+    if (xbps_cmpver(search_result_version(merged, idx),
+                    search_result_installed(merged, idx)) > 0) {
+      upgradable[idx / 64] |= 1ull << (idx % 64);
+      (*count)++;
+    }
+  }
+
+  free(entries);
+  return true;
+}
+
+/* ============= Patching ============= */
+
+// What `update_entry` changed
+enum { ENTRY_CHANGED = 1 << 0, ENTRY_TEXT = 1 << 1, ENTRY_ERROR = 1 << 2 };
+
+static bool same_string(const char *a, const char *b) {
+  return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+// Whether entry follows pkgdb entirely, i.e. it's removed with the package
+static bool follows_pkgdb(const search_result_t *catalog, uint32_t idx) {
+  return catalog->repo_type == LOCAL ||
+         catalog->packages[idx].repository == NO_STRING;
+}
+
+// Bring entry `idx` of `patched` up to date with package `local_idx` of pkgdb,
+// PKGNAME_NOT_FOUND if it isn't installed. Returns ENTRY_* flags
+static unsigned update_entry(search_result_t *patched, uint32_t idx,
+                             const search_result_t *local,
+                             uint32_t local_idx) {
+  package_entry_t *pkg = &patched->packages[idx];
+
+  // Online package that was removed
+  if (local_idx == PKGNAME_NOT_FOUND) {
+    if (pkg->installed == NO_STRING &&
+        pkg->state == XBPS_PKG_STATE_NOT_INSTALLED)
+      return 0;
+
+    pkg->installed = NO_STRING;
+    pkg->state = XBPS_PKG_STATE_NOT_INSTALLED;
+    pkg->install_date = 0;
+    return ENTRY_CHANGED;
+  }
+
+  const package_entry_t *src = &local->packages[local_idx];
+  const char *pkgver = search_result_pkgver(local, local_idx);
+  const char *short_desc = search_result_short_desc(local, local_idx);
+  unsigned flags = 0;
+
+  if (follows_pkgdb(patched, idx)) {
+    if (!same_string(search_result_pkgver(patched, idx), pkgver)) {
+      pkg->pkgver = string_arena_push(&patched->pkgvers, pkgver);
+      pkg->name_len = src->name_len;
+      if (pkg->pkgver == NO_STRING)
+        return ENTRY_ERROR;
+      flags |= ENTRY_CHANGED | ENTRY_TEXT;
+    }
+    if (!same_string(search_result_short_desc(patched, idx), short_desc)) {
+      pkg->short_desc = string_arena_push(&patched->short_descs, short_desc);
+      if (short_desc && pkg->short_desc == NO_STRING)
+        return ENTRY_ERROR;
+      flags |= ENTRY_CHANGED | ENTRY_TEXT;
+    }
+
+    if (pkg->installed_size != src->installed_size) {
+      pkg->installed_size = src->installed_size;
+      flags |= ENTRY_CHANGED;
+    }
+  }
+
+  if (patched->repo_type == REMOTE) {
+    const char *version = search_result_version(local, local_idx);
+    if (!same_string(search_result_installed(patched, idx), version)) {
+      if (!mark_installed(patched, idx, local, local_idx))
+        return ENTRY_ERROR;
+      flags |= ENTRY_CHANGED;
+    }
+  }
+
+  if (pkg->state != src->state || pkg->install_date != src->install_date) {
+    pkg->state = src->state;
+    pkg->install_date = src->install_date;
+    flags |= ENTRY_CHANGED;
+  }
+
+  return flags;
+}
+
+// Append installed package that the catalog doesn't have
+static bool append_installed(search_result_t *patched,
+                             const search_result_t *local,
+                             uint32_t local_idx) {
+  package_entry_t *pkg =
+      search_result_append(patched, search_result_pkgver(local, local_idx),
+                           search_result_short_desc(local, local_idx));
+  if (!pkg)
+    return false;
+
+  pkg->state = local->packages[local_idx].state;
+  pkg->installed_size = local->packages[local_idx].installed_size;
+  pkg->install_date = local->packages[local_idx].install_date;
+
+  return patched->repo_type == LOCAL ||
+         mark_installed(patched, patched->count - 1, local, local_idx);
+}
+
+bool catalog_patch(const search_result_t *catalog,
+                   const search_result_t *local, catalog_patch_t *patch) {
+  if (!catalog || !local || !patch)
+    return false;
+
+  *patch = (catalog_patch_t){0};
+  pkgname_table_t installed = {0};
+  bool *matched = calloc(local->count > 0 ? local->count : 1, sizeof(bool));
+  patch->remap =
+      malloc((catalog->count > 0 ? catalog->count : 1) * sizeof(uint32_t));
+
+  // Copy is on the heap even if `catalog` is mapped
+  patch->packages = search_result_copy(catalog);
+  if (!matched || !patch->remap || !patch->packages ||
+      !pkgname_table_build(&installed, local))
+    goto error;
+
+  // Entries are compacted in place, an entry never moves forward
+  search_result_t *patched = patch->packages;
+  uint32_t kept = 0;
+  for (uint32_t i = 0; i < catalog->count; i++) {
+    uint32_t local_idx =
+        pkgname_table_find(&installed, search_result_pkgver(catalog, i),
+                           catalog->packages[i].name_len);
+
+    if (local_idx == PKGNAME_NOT_FOUND && follows_pkgdb(catalog, i)) {
+      patch->remap[i] = CATALOG_REMOVED;
+      patch->removed++;
+      continue;
+    }
+
+    patched->packages[kept] = patched->packages[i];
+    patch->remap[i] = kept;
+    if (local_idx != PKGNAME_NOT_FOUND)
+      matched[local_idx] = true;
+
+    unsigned flags = update_entry(patched, kept++, local, local_idx);
+    if (flags & ENTRY_ERROR)
+      goto error;
+    if (flags & ENTRY_CHANGED)
+      patch->changed++;
+    if (flags & ENTRY_TEXT)
+      patch->reindex = true;
+  }
+  patched->count = kept;
+
+  for (uint32_t local_idx = 0; local_idx < local->count; local_idx++) {
+    if (matched[local_idx])
+      continue;
+
+    if (!append_installed(patched, local, local_idx))
+      goto error;
+    patch->added++;
+  }
+
+  if (patch->added > 0 || patch->removed > 0)
+    patch->reindex = true;
+
+  pkgname_table_cleanup(&installed);
+  free(matched);
+  return true;
+
+error:
+  pkgname_table_cleanup(&installed);
+  free(matched);
+  catalog_patch_cleanup(patch);
+  return false;
+}
+
+void catalog_patch_cleanup(catalog_patch_t *patch) {
+  if (!patch)
+    return;
+
+  if (patch->packages)
+    search_result_cleanup(patch->packages);
+  free(patch->remap);
+
+  *patch = (catalog_patch_t){0};
+}
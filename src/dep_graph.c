@@ -0,0 +1,440 @@
+#include "dep_graph.h"
+#include "perf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ============= Collecting packages ============= */
+
+// Dependency patterns and provided virtual packages, as read from metadata.
+// They're resolved to ids only when every package is known
+struct builder {
+  dep_graph_t *graph;
+
+  string_arena_t patterns;  // run_depends of every package
+  uint32_t *pattern_offset; // Offset of each pattern into `patterns`
+  uint32_t patterns_count;
+  uint32_t patterns_cap;
+  uint32_t *first_pattern; // First pattern of each node, grows with `nodes`
+  uint32_t first_cap;
+
+  search_result_t *virtuals; // Provided pkgvers, e.g. "awk-0_1"
+  uint32_t *provider;        // Node providing each of `virtuals`
+  uint32_t provider_cap;
+
+  bool failed;
+};
+
+// Grow array of uint32_t to hold at least `count` elements
+static bool reserve_ids(uint32_t **ids, uint32_t *cap, uint32_t count) {
+  if (count <= *cap)
+    return true;
+
+  uint32_t new_cap = *cap > 0 ? *cap * 2 : 256;
+  while (new_cap < count)
+    new_cap *= 2;
+
+  uint32_t *grown = realloc(*ids, new_cap * sizeof(uint32_t));
+  if (!grown)
+    return false;
+
+  *ids = grown;
+  *cap = new_cap;
+  return true;
+}
+
+// Set bit of node `id` in bitmap, growing it as needed
+static bool set_bit(uint64_t **bits, uint32_t *cap, uint32_t id) {
+  if (id / 64 >= *cap) {
+    uint32_t new_cap = *cap > 0 ? *cap * 2 : 64;
+    while (new_cap <= id / 64)
+      new_cap *= 2;
+
+    uint64_t *grown = realloc(*bits, new_cap * sizeof(uint64_t));
+    if (!grown)
+      return false;
+
+    memset(grown + *cap, 0, (new_cap - *cap) * sizeof(uint64_t));
+    *bits = grown;
+    *cap = new_cap;
+  }
+
+  (*bits)[id / 64] |= 1ull << (id % 64);
+  return true;
+}
+
+static bool add_pattern(struct builder *b, const char *pattern) {
+  if (!reserve_ids(&b->pattern_offset, &b->patterns_cap,
+                   b->patterns_count + 1))
+    return false;
+
+  uint32_t offset = string_arena_push(&b->patterns, pattern);
+  if (offset == NO_STRING)
+    return false;
+
+  b->pattern_offset[b->patterns_count++] = offset;
+  return true;
+}
+
+static int collect_package(struct xbps_handle *xhp, xbps_object_t pkg_dict,
+                           const char *key, void *arg, bool *loop_done) {
+  (void)xhp;
+  (void)key;
+
+  struct builder *b = (struct builder *)arg;
+  search_result_t *nodes = b->graph->nodes;
+  const char *pkgver = NULL, *short_desc = NULL;
+
+  xbps_dictionary_get_cstring_nocopy(pkg_dict, "pkgver", &pkgver);
+  xbps_dictionary_get_cstring_nocopy(pkg_dict, "short_desc", &short_desc);
+  if (!pkgver)
+    return 0;
+
+  uint32_t id = nodes->count;
+  package_entry_t *entry = NULL;
+  if (!reserve_ids(&b->first_pattern, &b->first_cap, id + 2) ||
+      !(entry = search_result_append(nodes, pkgver,
+                                     short_desc ? short_desc : ""))) {
+    b->failed = *loop_done = true;
+    return 0;
+  }
+  b->first_pattern[id] = b->patterns_count;
+  xbps_dictionary_get_uint64(pkg_dict, "installed_size",
+                             &entry->installed_size);
+
+  // Only pkgdb records how package got installed
+  dep_graph_t *graph = b->graph;
+  bool automatic = false;
+  if (xbps_dictionary_get_bool(pkg_dict, "automatic-install", &automatic) &&
+      automatic && !set_bit(&graph->automatic, &graph->automatic_words, id)) {
+    b->failed = *loop_done = true;
+    return 0;
+  }
+
+  const char *str = NULL;
+  xbps_array_t depends = xbps_dictionary_get(pkg_dict, "run_depends");
+  for (unsigned i = 0; i < xbps_array_count(depends); i++) {
+    if (xbps_array_get_cstring_nocopy(depends, i, &str) &&
+        !add_pattern(b, str)) {
+      b->failed = *loop_done = true;
+      return 0;
+    }
+  }
+
+  xbps_array_t provides = xbps_dictionary_get(pkg_dict, "provides");
+  for (unsigned i = 0; i < xbps_array_count(provides); i++) {
+    if (!xbps_array_get_cstring_nocopy(provides, i, &str))
+      continue;
+
+    uint32_t virtual = b->virtuals->count;
+    if (!reserve_ids(&b->provider, &b->provider_cap, virtual + 1) ||
+        !search_result_append(b->virtuals, str, "")) {
+      b->failed = *loop_done = true;
+      return 0;
+    }
+    b->provider[virtual] = id;
+  }
+
+  return 0;
+}
+
+static int collect_repo(struct xbps_repo *repo, void *arg, bool *done) {
+  struct builder *b = (struct builder *)arg;
+
+  xbps_array_t keys = xbps_dictionary_all_keys(repo->idx);
+  if (!keys)
+    return 0;
+
+  xbps_array_foreach_cb(repo->xhp, keys, repo->idx, collect_package, b);
+  xbps_object_release(keys);
+
+  if (b->failed)
+    *done = true;
+
+  return 0;
+}
+
+/* ============= Resolving edges ============= */
+
+// Node satisfying dependency `pattern`, e.g. "glibc>=2.32_1"
+static uint32_t resolve(const dep_graph_t *graph,
+                        const pkgname_table_t *virtuals,
+                        const uint32_t *provider, const char *pattern) {
+  char name[XBPS_NAME_SIZE];
+  if (!xbps_pkgpattern_name(name, sizeof(name), pattern) &&
+      !xbps_pkg_name(name, sizeof(name), pattern))
+    snprintf(name, sizeof(name), "%s", pattern);
+
+  size_t len = strlen(name);
+  uint32_t id = pkgname_table_find(&graph->names, name, len);
+  if (id != PKGNAME_NOT_FOUND)
+    return id;
+
+  if (virtuals) {
+    uint32_t virtual = pkgname_table_find(virtuals, name, len);
+    if (virtual != PKGNAME_NOT_FOUND)
+      return provider[virtual];
+  }
+
+  return DEP_GRAPH_NONE;
+}
+
+// Insert `id` into sorted row, unless it's already there
+static void row_insert(uint32_t *row, uint32_t *len, uint32_t id) {
+  uint32_t pos = *len;
+  while (pos > 0 && row[pos - 1] > id)
+    pos--;
+  if (pos > 0 && row[pos - 1] == id)
+    return;
+
+  memmove(row + pos + 1, row + pos, (*len - pos) * sizeof(uint32_t));
+  row[pos] = id;
+  (*len)++;
+}
+
+static bool resolve_edges(dep_graph_t *graph, struct builder *b) {
+  uint32_t count = graph->nodes->count;
+  b->first_pattern[count] = b->patterns_count;
+
+  pkgname_table_t virtuals = {0};
+  bool have_virtuals = b->virtuals->count > 0;
+  if (!pkgname_table_build(&graph->names, graph->nodes) ||
+      (have_virtuals && !pkgname_table_build(&virtuals, b->virtuals)))
+    return false;
+
+  // Every pattern becomes at most one edge
+  graph->start[DEP_DEPENDS] = malloc((count + 1) * sizeof(uint32_t));
+  graph->edges[DEP_DEPENDS] =
+      malloc((b->patterns_count + 1) * sizeof(uint32_t));
+  if (!graph->start[DEP_DEPENDS] || !graph->edges[DEP_DEPENDS]) {
+    pkgname_table_cleanup(&virtuals);
+    return false;
+  }
+
+  uint32_t *edges = graph->edges[DEP_DEPENDS];
+  uint32_t used = 0;
+  for (uint32_t id = 0; id < count; id++) {
+    graph->start[DEP_DEPENDS][id] = used;
+
+    // Package shadowed by one of an earlier repository has no edges
+    if (pkgname_table_find(&graph->names, dep_graph_pkgver(graph, id),
+                           graph->nodes->packages[id].name_len) != id)
+      continue;
+
+    uint32_t len = 0;
+    for (uint32_t p = b->first_pattern[id]; p < b->first_pattern[id + 1];
+         p++) {
+      const char *pattern =
+          string_arena_get(&b->patterns, b->pattern_offset[p]);
+      uint32_t dep = resolve(graph, have_virtuals ? &virtuals : NULL,
+                             b->provider, pattern);
+
+      if (dep == DEP_GRAPH_NONE)
+        graph->unresolved++;
+      else if (dep != id)
+        row_insert(edges + used, &len, dep);
+    }
+    used += len;
+  }
+  graph->start[DEP_DEPENDS][count] = used;
+  graph->edges_count = used;
+  pkgname_table_cleanup(&virtuals);
+
+  // Reverse edges: count incoming ones, then fill rows in order of source,
+  // which keeps them sorted
+  uint32_t *rstart = calloc(count + 1, sizeof(uint32_t));
+  uint32_t *redges = malloc((used + 1) * sizeof(uint32_t));
+  uint32_t *cursor = malloc((count + 1) * sizeof(uint32_t));
+  graph->start[DEP_RDEPENDS] = rstart;
+  graph->edges[DEP_RDEPENDS] = redges;
+  if (!rstart || !redges || !cursor) {
+    free(cursor);
+    return false;
+  }
+
+  for (uint32_t e = 0; e < used; e++)
+    rstart[edges[e] + 1]++;
+  for (uint32_t id = 0; id < count; id++)
+    rstart[id + 1] += rstart[id];
+
+  memcpy(cursor, rstart, (count + 1) * sizeof(uint32_t));
+  for (uint32_t id = 0; id < count; id++) {
+    for (uint32_t e = graph->start[DEP_DEPENDS][id];
+         e < graph->start[DEP_DEPENDS][id + 1]; e++)
+      redges[cursor[edges[e]]++] = id;
+  }
+
+  free(cursor);
+  return true;
+}
+
+/* ============= Graph ============= */
+
+dep_graph_t *dep_graph_build(struct xbps_handle *xhp, REPO_TYPE repo_type) {
+  uint64_t start = perf_now();
+
+  dep_graph_t *graph = calloc(1, sizeof(dep_graph_t));
+  if (!graph)
+    return NULL;
+
+  struct builder b = {.graph = graph};
+  graph->nodes = calloc(1, sizeof(search_result_t));
+  b.virtuals = calloc(1, sizeof(search_result_t));
+  if (!graph->nodes || !b.virtuals) {
+    b.failed = true;
+  } else {
+    graph->nodes->repo_type = repo_type;
+    if (repo_type == REMOTE)
+      xbps_rpool_foreach(xhp, collect_repo, &b);
+    else
+      xbps_pkgdb_foreach_cb(xhp, collect_package, &b);
+
+    // Empty graph still has its one-element row arrays
+    if (!b.failed && !reserve_ids(&b.first_pattern, &b.first_cap, 1))
+      b.failed = true;
+  }
+
+  if (!b.failed && !resolve_edges(graph, &b))
+    b.failed = true;
+
+  string_arena_cleanup(&b.patterns);
+  free(b.pattern_offset);
+  free(b.first_pattern);
+  free(b.provider);
+  if (b.virtuals)
+    search_result_cleanup(b.virtuals);
+
+  if (b.failed) {
+    dep_graph_cleanup(graph);
+    return NULL;
+  }
+
+  perf_span("dep_graph_build", start);
+  return graph;
+}
+
+uint32_t dep_graph_find(const dep_graph_t *graph, const char *pkgname) {
+  if (!graph || !pkgname)
+    return DEP_GRAPH_NONE;
+
+  uint32_t id = pkgname_table_find(&graph->names, pkgname, strlen(pkgname));
+  return id == PKGNAME_NOT_FOUND ? DEP_GRAPH_NONE : id;
+}
+
+uint32_t dep_graph_closure(const dep_graph_t *graph, uint32_t id,
+                           DEP_DIRECTION dir, uint32_t *out) {
+  if (!graph || id >= graph->nodes->count)
+    return 0;
+
+  // Breadth-first, the output doubles as the queue
+  uint32_t count = graph->nodes->count;
+  uint64_t *visited = calloc((count + 63) / 64, sizeof(uint64_t));
+  uint32_t *queue = out ? out : malloc(count * sizeof(uint32_t));
+  if (!visited || !queue) {
+    free(visited);
+    if (queue != out)
+      free(queue);
+    return 0;
+  }
+
+  visited[id / 64] |= 1ull << (id % 64);
+  uint32_t head = 0, tail = 0;
+  uint32_t node = id;
+
+  while (true) {
+    for (uint32_t e = graph->start[dir][node]; e < graph->start[dir][node + 1];
+         e++) {
+      uint32_t next = graph->edges[dir][e];
+      if (visited[next / 64] & (1ull << (next % 64)))
+        continue;
+
+      visited[next / 64] |= 1ull << (next % 64);
+      queue[tail++] = next;
+    }
+
+    if (head == tail)
+      break;
+    node = queue[head++];
+  }
+
+  free(visited);
+  if (queue != out)
+    free(queue);
+
+  return tail;
+}
+
+uint32_t dep_graph_orphans(const dep_graph_t *graph, uint32_t *out,
+                           uint64_t *freed) {
+  if (freed)
+    *freed = 0;
+  if (!graph || graph->nodes->count == 0)
+    return 0;
+
+  // Everything reachable from manually installed packages is needed, one
+  // breadth-first pass from all of them at once
+  uint32_t count = graph->nodes->count;
+  uint64_t *needed = calloc((count + 63) / 64, sizeof(uint64_t));
+  uint32_t *queue = malloc(count * sizeof(uint32_t));
+  if (!needed || !queue) {
+    free(needed);
+    free(queue);
+    return 0;
+  }
+
+  uint32_t tail = 0;
+  for (uint32_t id = 0; id < count; id++) {
+    if (dep_graph_automatic(graph, id))
+      continue;
+
+    needed[id / 64] |= 1ull << (id % 64);
+    queue[tail++] = id;
+  }
+
+  for (uint32_t head = 0; head < tail; head++) {
+    uint32_t node = queue[head];
+    for (uint32_t e = graph->start[DEP_DEPENDS][node];
+         e < graph->start[DEP_DEPENDS][node + 1]; e++) {
+      uint32_t next = graph->edges[DEP_DEPENDS][e];
+      if (needed[next / 64] & (1ull << (next % 64)))
+        continue;
+
+      needed[next / 64] |= 1ull << (next % 64);
+      queue[tail++] = next;
+    }
+  }
+
+  uint32_t orphans = 0;
+  for (uint32_t id = 0; id < count; id++) {
+    if (needed[id / 64] & (1ull << (id % 64)))
+      continue;
+
+    if (out)
+      out[orphans] = id;
+    if (freed)
+      *freed += graph->nodes->packages[id].installed_size;
+    orphans++;
+  }
+
+  free(needed);
+  free(queue);
+  return orphans;
+}
+
+void dep_graph_cleanup(dep_graph_t *graph) {
+  if (!graph)
+    return;
+
+  if (graph->nodes)
+    search_result_cleanup(graph->nodes);
+  pkgname_table_cleanup(&graph->names);
+  free(graph->automatic);
+
+  for (int dir = 0; dir < 2; dir++) {
+    free(graph->start[dir]);
+    free(graph->edges[dir]);
+  }
+
+  free(graph);
+}
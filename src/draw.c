@@ -3,6 +3,38 @@
 #include "model.h"
 
 #include <notcurses/notcurses.h>
+#include <stdio.h>
+#include <string.h>
+
+// Size of the stats overlay
+#define STATS_ROWS 8
+#define STATS_COLS 30
+
+// Size in the units of xbps, e.g. "12MB", into `buf` of 8 bytes
+//
+// Return `buf` or NULL if the size isn't known
+static const char *format_size(char *buf, uint64_t bytes) {
+  if (bytes == 0 || xbps_humanize_number(buf, (int64_t)bytes) == -1)
+    return NULL;
+
+  return buf;
+}
+
+// Print marker of the matching mode at the cursor, red while a regex doesn't
+// compile
+static void draw_mode_marker(const model_t *state, struct ncplane *plane,
+                             bool invalid) {
+  const char *marker = ">";
+  if (state->match_mode == MATCH_FUZZY)
+    marker = "~";
+  else if (state->match_mode == MATCH_REGEX)
+    marker = "/";
+
+  if (state->match_mode == MATCH_REGEX && invalid)
+    ncplane_set_fg_rgb(plane, RED);
+  ncplane_putstr(plane, marker);
+  ncplane_set_fg_default(plane);
+}
 
 bool draw_input(model_t *state) {
   if (!state)
@@ -16,10 +48,28 @@ bool draw_input(model_t *state) {
   else
     ncplane_set_bg_default(state->input_plane);
 
-  // Print prefix(>) and user input
-  ncplane_putstr_yx(state->input_plane, 0, 0, "> ");
+  // Print prefix(> or ~ in fuzzy mode, / in regex mode, @ for path lookup)
+  // and user input
+  ncplane_cursor_move_yx(state->input_plane, 0, 0);
+  if (state->owners.active)
+    ncplane_putstr(state->input_plane, "@");
+  else
+    draw_mode_marker(state, state->input_plane, state->filter_invalid);
+  ncplane_putstr(state->input_plane, " ");
   ncplane_putstr_yx(state->input_plane, 0, 2, state->input_buffer);
 
+  // Order of the list, when it isn't the matcher's
+  if (state->sort != SORT_MATCH && !state->owners.active) {
+    uint32_t rows, cols;
+    ncplane_dim_yx(state->input_plane, &rows, &cols);
+
+    char tag[32];
+    int len = snprintf(tag, sizeof(tag), "[%s]", sort_order_label(state->sort));
+    ncplane_set_fg_rgb(state->input_plane, GREY);
+    ncplane_putstr_yx(state->input_plane, 0, (int)cols - len - 1, tag);
+    ncplane_set_fg_default(state->input_plane);
+  }
+
   // Cursor
   if (state->focus == INPUT)
     ncplane_cursor_move_yx(state->input_plane, 0, 2 + (int)state->input_len);
@@ -31,39 +81,213 @@ bool draw_info(model_t *state) {
   if (!state)
     return false;
 
+  // Files pane and dependency tree take the place of info
+  if (state->focus == FILES)
+    return draw_files(state);
+  if (state->focus == DEPS)
+    return draw_deps(state);
+
+  // Transaction stays on screen until it's dismissed
+  if (state->batch.transaction)
+    return draw_batch(state);
+
+  if (state->owners.active)
+    return draw_owner_info(state);
+
   ncplane_erase(state->info_plane); // Clear info plate
 
   ncplane_set_fg_rgb(state->info_plane, MOUNTAIN_MEADOW);
   ncplane_putstr_yx(state->info_plane, 0, 1, "info");
   ncplane_set_fg_default(state->info_plane);
 
+  // Progress of background loading
+  if (state->loader) {
+    ncplane_set_fg_rgb(state->info_plane, GREY);
+    ncplane_printf_yx(state->info_plane, 0, 6,
+                      "loading repositories %zu/%zu, %u packages",
+                      state->repos_loaded, state->repos_total,
+                      state->packages->count);
+    ncplane_set_fg_default(state->info_plane);
+  } else if (state->orphans.active) {
+    char freed_str[8];
+    const char *freed = format_size(freed_str, state->orphans.freed);
+    ncplane_set_fg_rgb(state->info_plane, GREY);
+    ncplane_printf_yx(state->info_plane, 0, 6, "%u orphans, %s to free",
+                      state->orphans.count, freed ? freed : "nothing");
+    ncplane_set_fg_default(state->info_plane);
+  } else if (state->upgrades.active) {
+    ncplane_set_fg_rgb(state->info_plane, GREY);
+    ncplane_printf_yx(state->info_plane, 0, 6, "%u upgradable",
+                      state->upgrades.count);
+    ncplane_set_fg_default(state->info_plane);
+  } else if (state->batch.marked_count > 0) {
+    ncplane_set_fg_rgb(state->info_plane, GREY);
+    ncplane_printf_yx(state->info_plane, 0, 6, "%u marked, x to apply",
+                      state->batch.marked_count);
+    ncplane_set_fg_default(state->info_plane);
+  }
+
   // Print info
   if (state->filtered_count > 0 &&
       state->selected_idx < state->filtered_count) {
-    const package_info_t *pkg =
-        &state->packages
-             ->packages[state->filtered_indices[state->selected_idx]];
+    const search_result_t *packages = state->packages;
+    uint32_t idx = (uint32_t)state->filtered_indices[state->selected_idx];
+
+    const char *pkgver = search_result_pkgver(packages, idx);
+    const char *short_desc = search_result_short_desc(packages, idx);
+    char size_str[8];
+
+    // Other fields aren't kept in the catalog
+    const package_info_t *info = filtered_info(state, state->selected_idx);
+    const char *homepage = info ? info->homepage : NULL;
+    const char *license = info ? info->license : NULL;
+    const char *maintainer = info ? info->maintainer : NULL;
 
     int y = 1;
     ncplane_printf_yx(state->info_plane, y++, 1, "Pkg: %s",
-                      pkg->pkgver ? pkg->pkgver : "N/A");
+                      pkgver ? pkgver : "N/A");
+    if (packages->repo_type == REMOTE) {
+      const char *installed = search_result_installed(packages, idx);
+      ncplane_printf_yx(state->info_plane, y++, 1, "Installed: %s",
+                        installed ? installed : "no");
+    }
     ncplane_printf_yx(state->info_plane, y++, 1, "Desc: %s",
-                      pkg->short_desc ? pkg->short_desc : "N/A");
+                      short_desc ? short_desc : "N/A");
+    const char *size = format_size(size_str,
+                                   packages->packages[idx].installed_size);
+    ncplane_printf_yx(state->info_plane, y++, 1, "Installed size: %s",
+                      size ? size : "N/A");
     ncplane_printf_yx(state->info_plane, y++, 1, "Homepage: %s",
-                      pkg->homepage ? pkg->homepage : "N/A");
+                      homepage ? homepage : "N/A");
     ncplane_printf_yx(state->info_plane, y++, 1, "License: %s",
-                      pkg->license ? pkg->license : "N/A");
+                      license ? license : "N/A");
     ncplane_printf_yx(state->info_plane, y++, 1, "Maintainer: %s",
-                      pkg->maintainer ? pkg->maintainer : "N/A");
+                      maintainer ? maintainer : "N/A");
+  } else if (state->loader) {
+    ncplane_set_fg_rgb(state->info_plane, GREY);
+    ncplane_putstr_yx(state->info_plane, 1, 1, "Loading...");
+    ncplane_set_fg_default(state->info_plane);
   } else {
+    const char *empty = "No Match";
+    if (state->orphans.active && state->orphans.count == 0)
+      empty = "No orphans";
+    else if (state->upgrades.active && state->packages->repo_type == LOCAL)
+      empty = "Upgrades need repositories, start with -R";
+    else if (state->upgrades.active && state->upgrades.count == 0)
+      empty = "Everything is up to date";
+
     ncplane_set_fg_rgb(state->info_plane, RED);
-    ncplane_putstr_yx(state->info_plane, 1, 1, "No Match");
+    ncplane_putstr_yx(state->info_plane, 1, 1, empty);
     ncplane_set_fg_default(state->info_plane);
   }
 
   return true;
 }
 
+// Installed version next to the repository one, for the joined catalog
+static void draw_installed(model_t *state, uint32_t idx, const char *pkgver) {
+  const char *installed = search_result_installed(state->packages, idx);
+  if (!installed || !pkgver)
+    return;
+
+  const char *version = search_result_version(state->packages, idx);
+
+  ncplane_set_fg_rgb(state->list_plane, GREY);
+  if (strcmp(installed, version) == 0)
+    ncplane_putstr(state->list_plane, " [installed]");
+  else
+    ncplane_printf(state->list_plane, " [installed %s]", installed);
+}
+
+// Installed size right-aligned at the end of row `y`
+static void draw_size(model_t *state, int y, uint32_t idx) {
+  uint32_t rows, cols;
+  ncplane_dim_yx(state->list_plane, &rows, &cols);
+
+  char size_str[8];
+  if (cols < 40 || !format_size(size_str,
+                                state->packages->packages[idx].installed_size))
+    return;
+
+  // Field of fixed width covers the end of a long pkgver and whatever the row
+  // had there before, up to the last column kept for scroll markers
+  ncplane_set_fg_rgb(state->list_plane, GREY);
+  ncplane_printf_yx(state->list_plane, y, (int)cols - 10, " %7s ", size_str);
+}
+
+// Number of rows the list has, packages or paths in path lookup
+static size_t list_count(const model_t *state) {
+  return state->owners.active ? state->owners.matches.count
+                              : state->filtered_count;
+}
+
+// Paint `i`-th row of the list over whatever is there. Text of a row never
+// changes between frames that keep the viewport, so no erasing is needed
+static void draw_list_row(model_t *state, size_t i) {
+  struct ncplane *plane = state->list_plane;
+  int y = (int)(i - state->visible_start);
+
+  // Highlight selected element
+  if (i == state->selected_idx && state->focus == LIST) {
+    ncplane_set_fg_rgb(plane, WHITE); // Text
+    ncplane_set_bg_rgb(plane, BLUE);  // Bg
+  } else {
+    ncplane_set_fg_default(plane);
+    ncplane_set_bg_default(plane);
+  }
+
+  if (state->owners.active) {
+    // Matching path with its owner
+    const owner_search_t *owners = &state->owners;
+    uint32_t entry = owner_matches_get(&owners->matches, (uint32_t)i);
+
+    ncplane_putstr_yx(plane, y, 1, owner_index_path(owners->index, entry));
+    ncplane_set_fg_rgb(plane, GREY);
+    ncplane_printf(plane, " [%s]", owner_index_owner(owners->index, entry));
+  } else {
+    uint32_t idx = (uint32_t)state->filtered_indices[i];
+    const char *pkgver = search_result_pkgver(state->packages, idx);
+
+    // What the mark asks for in the first column, blank clears an old mark
+    char mark = ' ';
+    if (batch_marked(&state->batch, idx)) {
+      mark = batch_action(state, idx) == TRANSACTION_REMOVE ? '-' : '+';
+      ncplane_set_fg_rgb(plane, MOUNTAIN_MEADOW);
+    }
+    ncplane_putchar_yx(plane, y, 0, mark);
+    if (i == state->selected_idx && state->focus == LIST)
+      ncplane_set_fg_rgb(plane, WHITE);
+    else
+      ncplane_set_fg_default(plane);
+
+    ncplane_putstr_yx(plane, y, 1, pkgver);
+    draw_installed(state, idx, pkgver);
+    draw_size(state, y, idx);
+  }
+
+  ncplane_set_fg_default(plane);
+  ncplane_set_bg_default(plane);
+}
+
+// Scroll markers, rows may have been painted over them
+static void draw_scroll_marks(model_t *state) {
+  uint32_t rows, cols;
+  ncplane_dim_yx(state->list_plane, &rows, &cols);
+
+  size_t count = list_count(state);
+  if (count <= (size_t)rows)
+    return;
+
+  ncplane_set_fg_rgb(state->list_plane, GREY);
+  if (state->visible_start > 0)
+    ncplane_putchar_yx(state->list_plane, 0, cols - 1, 'u');
+
+  if (state->visible_start + rows < count)
+    ncplane_putchar_yx(state->list_plane, rows - 1, cols - 1, 'd');
+
+  ncplane_set_fg_default(state->list_plane);
+}
+
 bool draw_list(model_t *state) {
   if (!state)
     return false;
@@ -73,41 +297,436 @@ bool draw_list(model_t *state) {
   ncplane_erase(state->list_plane);
 
   // Limit visible elements
+  size_t count = list_count(state);
   size_t max_visible = (size_t)rows;
   size_t start = state->visible_start;
-  size_t end = (start + max_visible > state->filtered_count)
-                   ? state->filtered_count
-                   : start + max_visible;
+  size_t end = (start + max_visible > count) ? count : start + max_visible;
+
+  // Fuzzy results are ranked lazily, only as far as the user scrolled
+  if (!state->owners.active)
+    filter_rank(state, end);
+
+  for (size_t i = start; i < end; i++)
+    draw_list_row(state, i);
+
+  draw_scroll_marks(state);
+  state->drawn_selected = state->selected_idx;
+
+  return true;
+}
+
+bool draw_list_selection(model_t *state) {
+  if (!state)
+    return false;
+
+  uint32_t rows, cols;
+  ncplane_dim_yx(state->list_plane, &rows, &cols);
+
+  size_t count = list_count(state);
+  size_t start = state->visible_start;
+  size_t end = start + rows > count ? count : start + rows;
+
+  // Viewport is the same, so both rows are already ranked
+  if (state->drawn_selected >= start && state->drawn_selected < end)
+    draw_list_row(state, state->drawn_selected);
+  if (state->selected_idx >= start && state->selected_idx < end)
+    draw_list_row(state, state->selected_idx);
+
+  draw_scroll_marks(state);
+  state->drawn_selected = state->selected_idx;
+
+  return true;
+}
+
+bool draw_owner_info(model_t *state) {
+  if (!state)
+    return false;
+
+  const owner_search_t *owners = &state->owners;
+  struct ncplane *plane = state->info_plane;
+  ncplane_erase(plane);
+
+  ncplane_set_fg_rgb(plane, MOUNTAIN_MEADOW);
+  ncplane_putstr_yx(plane, 0, 1, "owner");
+  ncplane_set_fg_default(plane);
+
+  if (!owners->index) {
+    ncplane_set_fg_rgb(plane, owners->loader ? GREY : RED);
+    ncplane_putstr_yx(plane, 1, 1,
+                      owners->loader ? "Indexing files..." : "No index");
+    ncplane_set_fg_default(plane);
+    return true;
+  }
+
+  ncplane_set_fg_rgb(plane, GREY);
+  ncplane_printf_yx(plane, 0, 7, "%u/%u paths", owners->matches.count,
+                    owners->index->count);
+  ncplane_set_fg_default(plane);
+
+  if (state->selected_idx >= owners->matches.count) {
+    ncplane_set_fg_rgb(plane, RED);
+    ncplane_putstr_yx(plane, 1, 1, "No Match");
+    ncplane_set_fg_default(plane);
+    return true;
+  }
+
+  uint32_t entry =
+      owner_matches_get(&owners->matches, (uint32_t)state->selected_idx);
+  const package_info_t *info = owner_info(state, state->selected_idx);
+
+  int y = 1;
+  ncplane_printf_yx(plane, y++, 1, "Path: %s",
+                    owner_index_path(owners->index, entry));
+  ncplane_printf_yx(plane, y++, 1, "Owner: %s",
+                    owner_index_owner(owners->index, entry));
+  ncplane_printf_yx(plane, y++, 1, "Desc: %s",
+                    info && info->short_desc ? info->short_desc : "N/A");
+  ncplane_printf_yx(plane, y++, 1, "Homepage: %s",
+                    info && info->homepage ? info->homepage : "N/A");
+
+  return true;
+}
+
+// Size change of transaction, e.g. "+12MB" or "-3MB", into `buf` of 9 bytes
+static const char *format_delta(char *buf, uint64_t added, uint64_t removed) {
+  uint64_t bytes = added > removed ? added - removed : removed - added;
+  if (!format_size(buf + 1, bytes))
+    return "none";
+
+  buf[0] = added >= removed ? '+' : '-';
+  return buf;
+}
+
+bool draw_batch(model_t *state) {
+  if (!state || !state->batch.transaction)
+    return false;
+
+  const batch_view_t *batch = &state->batch;
+  const transaction_status_t *status = &batch->status;
+  const transaction_summary_t *summary =
+      transaction_summary(batch->transaction);
+  struct ncplane *plane = state->info_plane;
+
+  uint32_t rows, cols;
+  ncplane_dim_yx(plane, &rows, &cols);
+  ncplane_erase(plane);
+
+  ncplane_set_fg_rgb(plane, MOUNTAIN_MEADOW);
+  ncplane_putstr_yx(plane, 0, 1, "transaction");
+  ncplane_set_fg_rgb(plane, GREY);
+
+  // Header: what's going on and which keys apply
+  uint32_t count = summary ? summary->count : 0;
+  char download_str[8], delta_str[9];
+  switch (status->phase) {
+  case TRANSACTION_RESOLVING:
+    ncplane_putstr_yx(plane, 0, 13,
+                      batch->canceled ? "canceling..."
+                                      : "resolving dependencies...");
+    break;
+  case TRANSACTION_READY: {
+    const char *download = format_size(download_str, summary->download_size);
+    ncplane_printf_yx(plane, 0, 13, "%u packages, %s to download, %s size",
+                      count, download ? download : "nothing",
+                      format_delta(delta_str, summary->installed_size,
+                                   summary->removed_size));
+    ncplane_set_fg_default(plane);
+    ncplane_putstr(plane, "  y apply, n cancel");
+    break;
+  }
+  case TRANSACTION_RUNNING:
+    ncplane_printf_yx(plane, 0, 13, "%u/%u packages", status->done, count);
+    break;
+  default:
+    ncplane_putstr_yx(plane, 0, 13,
+                      status->phase == TRANSACTION_DONE ? "done" : "failed");
+    ncplane_set_fg_default(plane);
+    ncplane_putstr(plane, "  n dismiss");
+    break;
+  }
+
+  // Latest state of libxbps, or the error
+  int y = 1;
+  if (status->phase != TRANSACTION_READY && status->message[0]) {
+    ncplane_set_fg_rgb(plane, status->phase == TRANSACTION_FAILED ? RED : GREY);
+    ncplane_putstr_yx(plane, y++, 1, status->message);
+  }
+  ncplane_set_fg_default(plane);
+
+  // Steps in order of unpacking, as many as fit
+  for (uint32_t i = 0; summary && i < count && y < (int)rows; i++, y++) {
+    if (y + 1 == (int)rows && i + 1 < count) {
+      ncplane_set_fg_rgb(plane, GREY);
+      ncplane_printf_yx(plane, y, 1, "... %u more", count - i);
+      ncplane_set_fg_default(plane);
+      break;
+    }
+
+    const transaction_step_t *step = &summary->steps[i];
+    ncplane_printf_yx(plane, y, 1, "%-10s %s", transaction_step_label(step),
+                      string_arena_get(&summary->pkgvers, step->pkgver));
+  }
+
+  return true;
+}
+
+bool draw_files(model_t *state) {
+  if (!state)
+    return false;
+
+  files_pane_t *files = &state->files;
+  struct ncplane *plane = state->info_plane;
+
+  uint32_t rows, cols;
+  ncplane_dim_yx(plane, &rows, &cols);
+  ncplane_erase(plane);
+
+  // Header: package, number of matches and query
+  ncplane_set_fg_rgb(plane, MOUNTAIN_MEADOW);
+  ncplane_putstr_yx(plane, 0, 1, "files");
+  ncplane_set_fg_default(plane);
+  ncplane_printf_yx(plane, 0, 7, "%s", files->pkgname);
+  if (files->files && !files->loading) {
+    ncplane_set_fg_rgb(plane, GREY);
+    ncplane_printf(plane, " %zu/%u", files->count, files->files->count);
+    ncplane_set_fg_default(plane);
+  }
+  ncplane_putstr(plane, " ");
+  draw_mode_marker(state, plane, files->filter_invalid);
+  ncplane_printf(plane, " %s", files->query);
+
+  if (files->loading || !files->files) {
+    ncplane_set_fg_rgb(plane, files->loading ? GREY : RED);
+    ncplane_putstr_yx(plane, 1, 1, files->loading ? "Loading..." : "No files");
+    ncplane_set_fg_default(plane);
+    return true;
+  }
+
+  // Only the visible window is drawn, the list may have 100k paths
+  size_t max_visible = rows > 1 ? (size_t)rows - 1 : 1;
+  size_t start = files->visible_start;
+  size_t end = start + max_visible > files->count ? files->count
+                                                  : start + max_visible;
+
+  files_rank(state, end);
 
   for (size_t i = start; i < end; i++) {
-    int y = (int)(i - start);
-    const package_info_t *pkg =
-        &state->packages->packages[state->filtered_indices[i]];
-
-    // Highlight selected element
-    if (i == state->selected_idx && state->focus == LIST) {
-      ncplane_set_fg_rgb(state->list_plane, WHITE); // Text
-      ncplane_set_bg_rgb(state->list_plane, BLUE);  // Bg
+    if (i == files->selected_idx) {
+      ncplane_set_fg_rgb(plane, WHITE);
+      ncplane_set_bg_rgb(plane, BLUE);
     } else {
-      ncplane_set_fg_default(state->list_plane);
-      ncplane_set_bg_default(state->list_plane);
+      ncplane_set_fg_default(plane);
+      ncplane_set_bg_default(plane);
+    }
+
+    ncplane_putstr_yx(plane, (int)(i - start) + 1, 1,
+                      search_result_pkgver(files->files,
+                                           (uint32_t)files->indices[i]));
+  }
+  ncplane_set_fg_default(plane);
+  ncplane_set_bg_default(plane);
+
+  return true;
+}
+
+bool draw_deps(model_t *state) {
+  if (!state)
+    return false;
+
+  deps_pane_t *deps = &state->deps;
+  struct ncplane *plane = state->info_plane;
+
+  uint32_t rows, cols;
+  ncplane_dim_yx(plane, &rows, &cols);
+  ncplane_erase(plane);
+
+  ncplane_set_fg_rgb(plane, MOUNTAIN_MEADOW);
+  ncplane_putstr_yx(plane, 0, 1, "deps");
+  ncplane_set_fg_default(plane);
+
+  if (!deps->graph || deps->root == DEP_GRAPH_NONE) {
+    ncplane_set_fg_rgb(plane, RED);
+    ncplane_putstr_yx(plane, 1, 1,
+                      state->packages->repo_type == REMOTE
+                          ? "Package isn't in any repository"
+                          : "Package isn't installed");
+    ncplane_set_fg_default(plane);
+    return true;
+  }
+
+  ncplane_printf_yx(plane, 0, 6, "%s",
+                    dep_graph_pkgver(deps->graph, deps->root));
+
+  size_t max_visible = rows > 1 ? (size_t)rows - 1 : 1;
+  size_t start = deps->visible_start;
+  size_t end = start + max_visible > deps->count ? deps->count
+                                                 : start + max_visible;
+
+  for (size_t i = start; i < end; i++) {
+    const dep_row_t *row = &deps->rows[i];
+    int y = (int)(i - start) + 1;
+    bool selected = i == deps->selected_idx;
+
+    if (selected) {
+      ncplane_set_fg_rgb(plane, WHITE);
+      ncplane_set_bg_rgb(plane, BLUE);
     }
 
-    ncplane_putstr_yx(state->list_plane, y, 1, pkg->pkgver);
+    // Section header with direct and transitive counts
+    if (row->node == DEP_GRAPH_NONE) {
+      uint32_t direct;
+      dep_graph_edges(deps->graph, deps->root, (DEP_DIRECTION)row->direction,
+                      &direct);
+      if (!selected)
+        ncplane_set_fg_rgb(plane, MOUNTAIN_MEADOW);
+      ncplane_printf_yx(plane, y, 1, "%s %s: %u direct, %u total",
+                        row->expanded ? "-" : "+",
+                        row->direction == DEP_DEPENDS ? "Depends on"
+                                                      : "Required by",
+                        direct, deps->closure[row->direction]);
+      ncplane_set_fg_default(plane);
+      ncplane_set_bg_default(plane);
+      continue;
+    }
+
+    uint32_t neighbours;
+    dep_graph_edges(deps->graph, row->node, (DEP_DIRECTION)row->direction,
+                    &neighbours);
+    bool cycle = deps_cycle(deps, i);
+
+    const char *marker = " ";
+    if (row->expanded)
+      marker = "-";
+    else if (neighbours > 0 && !cycle)
+      marker = "+";
+
+    ncplane_printf_yx(plane, y, 1 + 2 * row->depth, "%s %s", marker,
+                      dep_graph_pkgver(deps->graph, row->node));
+    if (cycle) {
+      if (!selected)
+        ncplane_set_fg_rgb(plane, GREY);
+      ncplane_putstr(plane, " (cycle)");
+    }
+
+    ncplane_set_fg_default(plane);
+    ncplane_set_bg_default(plane);
   }
 
-  // Scroll
-  if (state->filtered_count > max_visible) {
-    ncplane_set_fg_rgb(state->list_plane, GREY);
-    if (state->visible_start > 0)
-      ncplane_putchar_yx(state->list_plane, 0, cols - 1, 'u');
+  return true;
+}
 
-    if (state->visible_start + max_visible < state->filtered_count)
-      ncplane_putchar_yx(state->list_plane, rows - 1, cols - 1, 'd');
+// Duration in the unit that keeps it readable
+static void format_duration(char *buf, size_t size, uint64_t ns) {
+  if (ns >= 1000 * 1000 * 1000)
+    snprintf(buf, size, "%.2f s", (double)ns / 1e9);
+  else if (ns >= 1000 * 1000)
+    snprintf(buf, size, "%.2f ms", (double)ns / 1e6);
+  else
+    snprintf(buf, size, "%.1f us", (double)ns / 1e3);
+}
+
+bool draw_stats(model_t *state) {
+  if (!state || !state->stats.visible)
+    return false;
+
+  uint32_t term_rows, term_cols;
+  ncplane_dim_yx(notcurses_stdplane(state->nc), &term_rows, &term_cols);
+  int x = term_cols > STATS_COLS ? (int)(term_cols - STATS_COLS) : 0;
+
+  // Created on first use, it stays in the top right corner above the list
+  if (!state->stats_plane) {
+    state->stats_plane =
+        ncplane_create(notcurses_stdplane(state->nc),
+                       &(struct ncplane_options){.y = 0,
+                                                 .x = x,
+                                                 .rows = STATS_ROWS,
+                                                 .cols = STATS_COLS,
+                                                 .name = "stats",
+                                                 .flags = 0});
+    if (!state->stats_plane)
+      return false;
+  }
+  ncplane_move_yx(state->stats_plane, 0, x);
+  ncplane_move_top(state->stats_plane);
+
+  struct ncplane *plane = state->stats_plane;
+  const perf_stats_t *stats = &state->stats;
+  char load[32], filter[32], draw[32], render[32];
+
+  if (state->loader)
+    snprintf(load, sizeof(load), "loading %zu/%zu", state->repos_loaded,
+             state->repos_total);
+  else
+    format_duration(load, sizeof(load), stats->load_ns);
+  format_duration(filter, sizeof(filter), stats->filter_ns);
+  format_duration(draw, sizeof(draw), stats->draw_ns);
+  format_duration(render, sizeof(render), stats->render_ns);
+
+  size_t matches = state->owners.active ? state->owners.matches.count
+                                        : state->filtered_count;
+  double memory = (double)(search_result_memory(state->packages) +
+                           trigram_index_memory(state->index)) /
+                  (1024.0 * 1024.0);
+
+  ncplane_erase(plane);
+  ncplane_set_fg_rgb(plane, WHITE);
+  ncplane_set_bg_rgb(plane, DARK_BLUE);
+
+  // Times of the previous frame, this one isn't rendered yet
+  ncplane_printf_yx(plane, 0, 0, " %-*s", STATS_COLS - 1, "Stats (F2)");
+  ncplane_printf_yx(plane, 1, 0, " %-12s%-*s", "load", STATS_COLS - 13, load);
+  ncplane_printf_yx(plane, 2, 0, " %-12s%-*s", "filter", STATS_COLS - 13,
+                    filter);
+  ncplane_printf_yx(plane, 3, 0, " %-12s%-*s", "draw", STATS_COLS - 13, draw);
+  ncplane_printf_yx(plane, 4, 0, " %-12s%-*s", "render", STATS_COLS - 13,
+                    render);
+  ncplane_printf_yx(plane, 5, 0, " %-12s%-*zu", "matches", STATS_COLS - 13,
+                    matches);
+  ncplane_printf_yx(plane, 6, 0, " %-12s%-*.1f", "catalog MiB",
+                    STATS_COLS - 13, memory);
+  ncplane_printf_yx(plane, 7, 0, " %-12s%-*zu", "events", STATS_COLS - 13,
+                    stats->events);
+
+  ncplane_set_fg_default(plane);
+  ncplane_set_bg_default(plane);
+  return true;
+}
+
+bool draw_dirty(model_t *state) {
+  if (!state || !state->dirty)
+    return false;
+
+  uint64_t frame = perf_now();
+  uint64_t start = frame;
+
+  if (state->dirty & DIRTY_LIST) {
+    draw_list(state);
+    perf_span("draw_list", start);
+  } else if (state->dirty & DIRTY_SELECTION) {
+    draw_list_selection(state);
+    perf_span("draw_list_selection", start);
+  }
+
+  if (state->dirty & DIRTY_INPUT) {
+    start = perf_now();
+    draw_input(state);
+    perf_span("draw_input", start);
+  }
+  if (state->dirty & DIRTY_INFO) {
+    start = perf_now();
+    draw_info(state);
+    perf_span("draw_info", start);
+  }
 
-    ncplane_set_fg_default(state->list_plane);
+  // Numbers change with every frame, but they never cause one
+  if (state->stats.visible) {
+    start = perf_now();
+    draw_stats(state);
+    perf_span("draw_stats", start);
   }
 
+  state->stats.draw_ns = perf_span("draw_dirty", frame);
+  state->dirty = 0;
   return true;
 }
 
@@ -158,8 +777,11 @@ bool init_ui(model_t *state) {
   state->input_buffer[0] = '\0';
   state->input_len = 0;
   state->focus = LIST;
+  state->dirty = DIRTY_ALL;
 
+  // Don't show an empty list before the first result arrives
   filter_elements(state);
+  filter_poll(state, true);
 
   return true;
 }
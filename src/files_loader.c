@@ -0,0 +1,192 @@
+#include "files_loader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Move paths into a catalog, every entry shares one empty description
+static search_result_t *files_catalog(package_files_t *files,
+                                      REPO_TYPE repo_type) {
+  search_result_t *catalog = calloc(1, sizeof(search_result_t));
+  if (!catalog)
+    return NULL;
+
+  catalog->repo_type = repo_type;
+  catalog->packages =
+      malloc((files->count > 0 ? files->count : 1) * sizeof(package_entry_t));
+  uint32_t empty = string_arena_push(&catalog->short_descs, "");
+  if (!catalog->packages || empty == NO_STRING) {
+    search_result_cleanup(catalog);
+    return NULL;
+  }
+
+  for (uint32_t i = 0; i < files->count; i++) {
+    catalog->packages[i] = (package_entry_t){
+        .pkgver = files->offsets[i],
+        .short_desc = empty,
+        .repository = NO_STRING,
+        .installed = NO_STRING,
+    };
+  }
+  catalog->count = files->count;
+  catalog->cap = files->count > 0 ? files->count : 1;
+
+  // Paths aren't copied
+  catalog->pkgvers = files->paths;
+  files->paths = (string_arena_t){0};
+
+  return catalog;
+}
+
+static files_snapshot_t *load_files(files_loader_t *loader,
+                                    const char *pkgname, REPO_TYPE repo_type,
+                                    uint64_t generation) {
+  files_snapshot_t *snapshot = calloc(1, sizeof(files_snapshot_t));
+  if (!snapshot)
+    return NULL;
+
+  snapshot->generation = generation;
+  if (!loader->ready)
+    return snapshot;
+
+  package_files_t *files = get_package_files(&loader->xhp, pkgname, repo_type);
+  if (!files)
+    return snapshot;
+
+  snapshot->files = files_catalog(files, repo_type);
+  package_files_cleanup(files);
+
+  if (snapshot->files)
+    snapshot->index = trigram_index_build(snapshot->files);
+
+  return snapshot;
+}
+
+static void *loader_main(void *arg) {
+  files_loader_t *loader = (files_loader_t *)arg;
+  loader->ready = search_handle_init(&loader->xhp, &loader->config);
+
+  char pkgname[XBPS_NAME_SIZE];
+
+  pthread_mutex_lock(&loader->lock);
+  while (!loader->stop) {
+    if (loader->handled == loader->requested) {
+      pthread_cond_wait(&loader->wake, &loader->lock);
+      continue;
+    }
+
+    // Take a copy of the request, so the UI can submit a new one meanwhile
+    uint64_t generation = loader->requested;
+    memcpy(pkgname, loader->pkgname, sizeof(pkgname));
+    REPO_TYPE repo_type = loader->repo_type;
+    bool refresh = loader->refresh;
+    loader->refresh = false;
+    pthread_mutex_unlock(&loader->lock);
+
+    // Fresh handle reads the new pkgdb
+    if (refresh) {
+      if (loader->ready)
+        xbps_end(&loader->xhp);
+      loader->ready = search_handle_init(&loader->xhp, &loader->config);
+    }
+
+    files_snapshot_t *snapshot =
+        load_files(loader, pkgname, repo_type, generation);
+
+    pthread_mutex_lock(&loader->lock);
+    loader->handled = generation;
+
+    // Loading can't be interrupted, at least don't publish stale list
+    if (snapshot && generation != loader->requested) {
+      files_snapshot_cleanup(snapshot);
+      snapshot = NULL;
+    }
+    if (snapshot)
+      files_snapshot_cleanup(atomic_exchange(&loader->published, snapshot));
+  }
+  pthread_mutex_unlock(&loader->lock);
+
+  if (loader->ready)
+    xbps_end(&loader->xhp);
+
+  return NULL;
+}
+
+files_loader_t *files_loader_start(const search_config_t *config) {
+  files_loader_t *loader = calloc(1, sizeof(files_loader_t));
+  if (!loader)
+    return NULL;
+
+  if (config)
+    loader->config = *config;
+
+  atomic_init(&loader->published, NULL);
+
+  pthread_mutex_init(&loader->lock, NULL);
+  pthread_cond_init(&loader->wake, NULL);
+
+  if (pthread_create(&loader->thread, NULL, loader_main, loader) != 0) {
+    pthread_cond_destroy(&loader->wake);
+    pthread_mutex_destroy(&loader->lock);
+    free(loader);
+    return NULL;
+  }
+
+  return loader;
+}
+
+uint64_t files_loader_request(files_loader_t *loader, const char *pkgname,
+                              REPO_TYPE repo_type) {
+  pthread_mutex_lock(&loader->lock);
+
+  strncpy(loader->pkgname, pkgname, sizeof(loader->pkgname) - 1);
+  loader->pkgname[sizeof(loader->pkgname) - 1] = '\0';
+  loader->repo_type = repo_type;
+  uint64_t generation = ++loader->requested;
+
+  pthread_cond_signal(&loader->wake);
+  pthread_mutex_unlock(&loader->lock);
+
+  return generation;
+}
+
+void files_loader_refresh(files_loader_t *loader) {
+  pthread_mutex_lock(&loader->lock);
+  loader->refresh = true;
+  pthread_mutex_unlock(&loader->lock);
+}
+
+files_snapshot_t *files_loader_take(files_loader_t *loader) {
+  return atomic_exchange(&loader->published, NULL);
+}
+
+void files_loader_stop(files_loader_t *loader) {
+  if (!loader)
+    return;
+
+  pthread_mutex_lock(&loader->lock);
+  loader->stop = true;
+  pthread_cond_signal(&loader->wake);
+  pthread_mutex_unlock(&loader->lock);
+
+  pthread_join(loader->thread, NULL);
+
+  files_snapshot_cleanup(atomic_exchange(&loader->published, NULL));
+
+  pthread_cond_destroy(&loader->wake);
+  pthread_mutex_destroy(&loader->lock);
+  free(loader);
+}
+
+/* ============= Cleanup functions ============= */
+
+void files_snapshot_cleanup(files_snapshot_t *snapshot) {
+  if (!snapshot)
+    return;
+
+  if (snapshot->files)
+    search_result_cleanup(snapshot->files);
+  if (snapshot->index)
+    trigram_index_cleanup(snapshot->index);
+
+  free(snapshot);
+}
@@ -0,0 +1,643 @@
+#include "filter.h"
+#include "fuzzy.h"
+#include "pkg_search.h"
+#include "thread_pool.h"
+#include "trigram.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How often long loops check for cancellation
+#define CANCEL_CHECK_MASK 1023
+
+static inline bool canceled(const filter_t *filter) {
+  return filter->latest &&
+         atomic_load_explicit(filter->latest, memory_order_relaxed) !=
+             filter->generation;
+}
+
+static bool regex_matches(const filter_t *filter, const char *text) {
+  if (!text)
+    return false;
+
+  // Literal checks rule out most packages before the costly regexec
+  for (size_t i = 0; i < filter->literals.count; i++) {
+    if (!strcasestr_portable(text, regex_literals_get(&filter->literals, i)))
+      return false;
+  }
+
+  return regexec(&filter->regex, text, 0, NULL, 0) == 0;
+}
+
+static bool package_matches(filter_t *filter, size_t idx, const char *query) {
+  const char *pkgver = search_result_pkgver(filter->packages, (uint32_t)idx);
+  const char *short_desc =
+      search_result_short_desc(filter->packages, (uint32_t)idx);
+
+  if (filter->mode == MATCH_FUZZY) {
+    int score = fuzzy_score(pkgver, query);
+    if (score != FUZZY_NO_MATCH)
+      score += FUZZY_NAME_BONUS;
+
+    int desc_score = fuzzy_score(short_desc, query);
+    if (desc_score > score)
+      score = desc_score;
+
+    filter->scores[idx] = score;
+    return score != FUZZY_NO_MATCH;
+  }
+
+  if (filter->mode == MATCH_REGEX)
+    return regex_matches(filter, pkgver) || regex_matches(filter, short_desc);
+
+  return (pkgver && strcasestr_portable(pkgver, query)) ||
+         (short_desc && strcasestr_portable(short_desc, query));
+}
+
+/* ============= Saved levels ============= */
+
+// Make sure `indices` can hold at least `count` elements
+static bool reserve_indices(filter_t *filter, size_t count) {
+  if (filter->cap >= count && filter->indices)
+    return true;
+
+  size_t cap = count > 0 ? count : 1;
+  size_t *indices = realloc(filter->indices, cap * sizeof(size_t));
+  if (!indices)
+    return false;
+
+  filter->indices = indices;
+  filter->cap = cap;
+  return true;
+}
+
+// Make the topmost level the current result again
+static void pop_level(filter_t *filter) {
+  filter_level_t *level = &filter->levels[--filter->depth];
+
+  free(filter->indices);
+  filter->indices = level->indices;
+  filter->cap = level->count > 0 ? level->count : 1;
+  filter->count = level->count;
+  filter->query_len = level->query_len;
+  filter->query[level->query_len] = '\0';
+
+  *level = (filter_level_t){0};
+}
+
+// Free levels made for prefixes longer than `len`
+static void drop_levels(filter_t *filter, size_t len) {
+  while (filter->depth > 0 &&
+         filter->levels[filter->depth - 1].query_len > len) {
+    filter_level_t *level = &filter->levels[--filter->depth];
+    free(level->indices);
+    *level = (filter_level_t){0};
+  }
+}
+
+void filter_reset(filter_t *filter) {
+  if (!filter)
+    return;
+
+  drop_levels(filter, 0);
+  filter->query[0] = '\0';
+  filter->query_len = 0;
+  filter->valid = false;
+  filter->invalid = false;
+}
+
+/* ============= Filtering ============= */
+
+// Keep elements of `base[begin..end)` (or packages `begin..end` if `base` is
+// NULL) that match query, writing them to `out`. `out` may alias `base + begin`
+static bool match_range(filter_t *filter, const size_t *base, size_t begin,
+                        size_t end, const char *query, size_t *out,
+                        size_t *kept) {
+  size_t count = 0;
+  for (size_t i = begin; i < end; i++) {
+    if (((i - begin) & CANCEL_CHECK_MASK) == 0 && canceled(filter))
+      return false;
+
+    size_t idx = base ? base[i] : i;
+    if (package_matches(filter, idx, query))
+      out[count++] = idx;
+  }
+
+  *kept = count;
+  return true;
+}
+
+/* ============= Parallel filtering ============= */
+
+// Chunks per thread, more of them balance the load better
+#define CHUNKS_PER_THREAD 4
+#define MAX_CHUNKS (THREAD_POOL_MAX * CHUNKS_PER_THREAD)
+
+struct filter_job {
+  filter_t *filter;
+  const size_t *base;
+  size_t count;
+  size_t chunks;
+  const char *query;
+  size_t *out;
+  size_t kept[MAX_CHUNKS];
+  atomic_bool failed;
+};
+
+static inline size_t chunk_begin(const struct filter_job *job, size_t chunk) {
+  return job->count * chunk / job->chunks;
+}
+
+// Every chunk fills its own slice of `out`, so the order is the same as in the
+// serial pass
+static void filter_chunk(void *arg, size_t chunk) {
+  struct filter_job *job = (struct filter_job *)arg;
+  size_t begin = chunk_begin(job, chunk), end = chunk_begin(job, chunk + 1);
+
+  if (!match_range(job->filter, job->base, begin, end, job->query,
+                   job->out + begin, &job->kept[chunk]))
+    atomic_store(&job->failed, true);
+}
+
+// Match `count` elements of `base` (or all packages) into `out`, which has to
+// hold `count` elements and may be `base` itself
+static bool match_all(filter_t *filter, const size_t *base, size_t count,
+                      const char *query, size_t *out, size_t *kept) {
+  size_t threads = filter->pool ? filter->pool->count + 1 : 1;
+  if (threads == 1 || count < filter->parallel_threshold)
+    return match_range(filter, base, 0, count, query, out, kept);
+
+  struct filter_job job = {
+      .filter = filter,
+      .base = base,
+      .count = count,
+      .chunks = threads * CHUNKS_PER_THREAD,
+      .query = query,
+      .out = out,
+  };
+  atomic_init(&job.failed, false);
+
+  thread_pool_run(filter->pool, job.chunks, filter_chunk, &job);
+  if (atomic_load(&job.failed))
+    return false;
+
+  // Concatenate slices in order
+  *kept = 0;
+  for (size_t chunk = 0; chunk < job.chunks; chunk++) {
+    memmove(out + *kept, out + chunk_begin(&job, chunk),
+            job.kept[chunk] * sizeof(size_t));
+    *kept += job.kept[chunk];
+  }
+
+  return true;
+}
+
+// Match `base_count` elements of `base` (or all packages) against a longer
+// query, into a freshly allocated `out`
+static bool narrow_elements(filter_t *filter, const size_t *base,
+                            size_t base_count, const char *query, size_t **out,
+                            size_t *kept) {
+  // Trigram index is used when it promises fewer candidates than the saved
+  // result, candidates are then checked in place. Fuzzy matches don't have to
+  // contain any trigram of the query
+  size_t estimate = filter->mode == MATCH_FUZZY
+                        ? SIZE_MAX
+                        : trigram_index_estimate(filter->index, query);
+  bool indexed = estimate != SIZE_MAX && (!base || estimate < base_count);
+
+  size_t count = indexed ? estimate
+                 : base  ? base_count
+                         : filter->packages->count;
+  size_t *indices = malloc((count > 0 ? count : 1) * sizeof(size_t));
+  if (!indices)
+    return false;
+
+  bool ok;
+  if (indexed) {
+    size_t candidates = trigram_index_query(filter->index, query, indices);
+    ok = match_all(filter, indices, candidates, query, indices, kept);
+  } else {
+    ok = match_all(filter, base, count, query, indices, kept);
+  }
+
+  if (!ok) {
+    free(indices);
+    return false;
+  }
+
+  *out = indices;
+  return true;
+}
+
+// Score restored matches against the query they are restored for
+static bool rescore(filter_t *filter, const size_t *indices, size_t count,
+                    const char *query) {
+  for (size_t i = 0; i < count; i++) {
+    if ((i & CANCEL_CHECK_MASK) == 0 && canceled(filter))
+      return false;
+    package_matches(filter, indices[i], query);
+  }
+
+  return true;
+}
+
+// Exchange `scores` with the spare array
+static void swap_scores(filter_t *filter) {
+  int *scores = filter->scores;
+  filter->scores = filter->spare_scores;
+  filter->spare_scores = scores;
+}
+
+// Substring and fuzzy passes start from the saved result of the longest prefix
+// the new query shares with the previous one. Saved results are only replaced
+// once the pass completes
+static bool prefix_run(filter_t *filter, const char *query, size_t len,
+                       bool valid) {
+  // Length of the common prefix of the previous and the new query
+  size_t common = 0;
+  if (valid) {
+    while (common < filter->query_len && common < len &&
+           filter->query[common] == query[common])
+      common++;
+  }
+
+  if (valid && common == len && filter->query_len == len)
+    return true;
+
+  char prefix[FILTER_QUERY_MAX];
+  memcpy(prefix, query, len);
+  prefix[len] = '\0';
+
+  // Base is the current result when the query extends it, else the topmost
+  // level kept after an edit. None means the whole catalog
+  bool extends = valid && common == filter->query_len;
+  const size_t *base = NULL;
+  size_t base_count = 0, base_len = 0;
+  if (extends && filter->query_len > 0) {
+    base = filter->indices;
+    base_count = filter->count;
+    base_len = filter->query_len;
+  } else if (!extends && filter->depth > 0 &&
+             filter->levels[0].query_len <= common) {
+    size_t depth = 1;
+    while (depth < filter->depth &&
+           filter->levels[depth].query_len <= common)
+      depth++;
+
+    const filter_level_t *level = &filter->levels[depth - 1];
+    base = level->indices;
+    base_count = level->count;
+    base_len = level->query_len;
+  }
+
+  if (filter->mode == MATCH_FUZZY)
+    swap_scores(filter);
+
+  // Narrow the base, or score it again if it's the result of this very query
+  size_t *indices = NULL, count = 0;
+  bool ok = true;
+  if (base_len < len)
+    ok = narrow_elements(filter, base, base_count, prefix, &indices, &count);
+  else if (filter->mode == MATCH_FUZZY)
+    ok = rescore(filter, base, base_count, prefix);
+
+  if (!ok) {
+    if (filter->mode == MATCH_FUZZY)
+      swap_scores(filter);
+    return false;
+  }
+
+  if (extends && filter->query_len > 0) {
+    // Empty query matches everything, no need to save it
+    filter->levels[filter->depth++] = (filter_level_t){
+        .query_len = filter->query_len,
+        .indices = filter->indices,
+        .count = filter->count,
+    };
+  } else {
+    drop_levels(filter, common);
+    if (base_len == len) {
+      pop_level(filter);
+    } else {
+      free(filter->indices);
+      filter->indices = NULL;
+    }
+  }
+
+  if (indices) {
+    filter->indices = indices;
+    filter->count = count;
+    filter->cap = count > 0 ? count : 1;
+  }
+
+  memcpy(filter->query, prefix, len + 1);
+  filter->query_len = len;
+  filter->valid = true;
+  filter->invalid = false;
+  return true;
+}
+
+// Exchange `indices` with the spare buffer
+static void swap_spare(filter_t *filter) {
+  size_t *indices = filter->indices;
+  size_t cap = filter->cap;
+
+  filter->indices = filter->spare;
+  filter->cap = filter->spare_cap;
+  filter->spare = indices;
+  filter->spare_cap = cap;
+}
+
+// Matches of a longer pattern aren't a subset of the shorter one's, so every
+// regex pass starts from the whole catalog, or from the trigram candidates of
+// its longest literal. The pass fills the spare buffer, previous matches stay
+// untouched until it completes
+static bool regex_run(filter_t *filter, const char *query, size_t len,
+                      bool valid) {
+  if (valid && filter->query_len == len &&
+      memcmp(filter->query, query, len) == 0)
+    return true;
+
+  char pattern[FILTER_QUERY_MAX];
+  memcpy(pattern, query, len);
+  pattern[len] = '\0';
+
+  // Pattern is likely still being typed
+  if (regcomp(&filter->regex, pattern,
+              REG_EXTENDED | REG_NOSUB | REG_ICASE) != 0) {
+    drop_levels(filter, 0);
+    memcpy(filter->query, pattern, len + 1);
+    filter->query_len = len;
+    filter->valid = true;
+    filter->invalid = true;
+    return true;
+  }
+  regex_literals_extract(pattern, &filter->literals);
+
+  const char *longest = filter->literals.count > 0
+                            ? regex_literals_get(&filter->literals, 0)
+                            : NULL;
+  size_t estimate =
+      longest ? trigram_index_estimate(filter->index, longest) : SIZE_MAX;
+
+  size_t count = filter->count;
+  swap_spare(filter);
+
+  bool ok;
+  if (estimate != SIZE_MAX) {
+    ok = reserve_indices(filter, estimate);
+    if (ok) {
+      size_t candidates =
+          trigram_index_query(filter->index, longest, filter->indices);
+      ok = match_all(filter, filter->indices, candidates, pattern,
+                     filter->indices, &filter->count);
+    }
+  } else {
+    ok = reserve_indices(filter, filter->packages->count) &&
+         match_all(filter, NULL, filter->packages->count, pattern,
+                   filter->indices, &filter->count);
+  }
+
+  regfree(&filter->regex);
+
+  if (!ok) {
+    swap_spare(filter);
+    filter->count = count;
+    return false;
+  }
+
+  drop_levels(filter, 0);
+  memcpy(filter->query, pattern, len + 1);
+  filter->query_len = len;
+  filter->valid = true;
+  filter->invalid = false;
+  return true;
+}
+
+// $XUI_PARALLEL_THRESHOLD overrides the default, so the crossover can be tried
+// without a rebuild. Anything but a plain number keeps the default
+static size_t parallel_threshold(void) {
+  const char *env = getenv("XUI_PARALLEL_THRESHOLD");
+  if (!env || *env < '0' || *env > '9')
+    return FILTER_PARALLEL_THRESHOLD;
+
+  char *end = NULL;
+  errno = 0;
+  unsigned long long threshold = strtoull(env, &end, 10);
+  if (*end != '\0' || errno == ERANGE || threshold > SIZE_MAX)
+    return FILTER_PARALLEL_THRESHOLD;
+
+  return (size_t)threshold;
+}
+
+bool filter_init(filter_t *filter, const search_result_t *packages,
+                 const trigram_index_t *index) {
+  if (!filter || !packages)
+    return false;
+
+  *filter = (filter_t){
+      .packages = packages,
+      .index = index,
+      .parallel_threshold = parallel_threshold(),
+  };
+
+  size_t count = packages->count > 0 ? packages->count : 1;
+  filter->scores = malloc(count * sizeof(int));
+  filter->spare_scores = malloc(count * sizeof(int));
+  if (!filter->scores || !filter->spare_scores) {
+    filter_cleanup(filter);
+    return false;
+  }
+
+  return true;
+}
+
+bool filter_set_catalog(filter_t *filter, const search_result_t *packages,
+                        const trigram_index_t *index) {
+  if (!filter || !packages)
+    return false;
+
+  size_t count = packages->count > 0 ? packages->count : 1;
+  int *scores = realloc(filter->scores, count * sizeof(int));
+  if (!scores)
+    return false;
+
+  filter->scores = scores;
+
+  scores = realloc(filter->spare_scores, count * sizeof(int));
+  if (!scores)
+    return false;
+
+  filter->spare_scores = scores;
+  filter->packages = packages;
+  filter->index = index;
+  filter_reset(filter);
+
+  return true;
+}
+
+// Every package matches the empty query
+static bool match_everything(filter_t *filter) {
+  if (!reserve_indices(filter, filter->packages->count))
+    return false;
+
+  filter_reset(filter);
+  filter->count = filter->packages->count;
+  for (size_t i = 0; i < filter->packages->count; i++) {
+    filter->indices[i] = i;
+  }
+  filter->valid = true;
+  return true;
+}
+
+bool filter_run(filter_t *filter, const char *query, MATCH_MODE mode) {
+  if (!filter || !query)
+    return false;
+
+  // Saved results belong to the other matcher, the mode is switched back if
+  // the pass doesn't complete
+  MATCH_MODE previous = filter->mode;
+  bool valid = filter->valid && previous == mode;
+  filter->mode = mode;
+
+  size_t len = strnlen(query, FILTER_QUERY_MAX - 1);
+  bool ok = len == 0               ? match_everything(filter)
+            : mode == MATCH_REGEX ? regex_run(filter, query, len, valid)
+                                  : prefix_run(filter, query, len, valid);
+  if (!ok)
+    filter->mode = previous;
+
+  return ok;
+}
+
+/* ============= Fuzzy ranking ============= */
+
+// Better score first, pkgdb order between equal scores
+static int compare_ranked(const void *a, const void *b, void *arg) {
+  const int *scores = arg;
+  size_t x = *(const size_t *)a, y = *(const size_t *)b;
+
+  if (scores[x] != scores[y])
+    return scores[x] > scores[y] ? -1 : 1;
+  return (x > y) - (x < y);
+}
+
+static inline void swap_indices(size_t *a, size_t *b) {
+  size_t tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+// Move the `ranked` best matches to the front of `indices` and sort them,
+// leaving the rest unordered
+static void rank_front(size_t *v, size_t count, size_t ranked,
+                       const int *scores) {
+  if (ranked > count)
+    ranked = count;
+
+  // Quickselect, the comparison is a total order so it always terminates
+  size_t lo = 0, hi = count;
+  while (ranked < count && hi - lo > 1) {
+    swap_indices(&v[lo + (hi - lo) / 2], &v[hi - 1]);
+
+    size_t store = lo;
+    for (size_t i = lo; i < hi - 1; i++) {
+      if (compare_ranked(&v[i], &v[hi - 1], (void *)scores) < 0)
+        swap_indices(&v[i], &v[store++]);
+    }
+    swap_indices(&v[store], &v[hi - 1]);
+
+    if (store == ranked || store + 1 == ranked)
+      break;
+    if (ranked < store)
+      hi = store;
+    else
+      lo = store + 1;
+  }
+
+  qsort_r(v, ranked, sizeof(size_t), compare_ranked, (void *)scores);
+}
+
+void filter_rank_rest(size_t *indices, size_t count, size_t from,
+                      const int *scores) {
+  if (!indices || !scores || from >= count)
+    return;
+
+  qsort_r(indices + from, count - from, sizeof(size_t), compare_ranked,
+          (void *)scores);
+}
+
+filter_result_t *filter_publish(const filter_t *filter, size_t ranked) {
+  if (!filter)
+    return NULL;
+
+  filter_result_t *result = calloc(1, sizeof(filter_result_t));
+  if (!result)
+    return NULL;
+
+  result->count = filter->count;
+  result->generation = filter->generation;
+  result->invalid = filter->invalid;
+  result->indices =
+      malloc((filter->count > 0 ? filter->count : 1) * sizeof(size_t));
+  if (!result->indices)
+    goto error;
+  memcpy(result->indices, filter->indices, filter->count * sizeof(size_t));
+
+  if (filter->mode != MATCH_FUZZY || filter->query_len == 0) {
+    result->ranked_count = result->count;
+    return result;
+  }
+
+  // Only scores of the matches are copied, the rest stays uninitialized
+  result->scores = malloc(
+      (filter->packages->count > 0 ? filter->packages->count : 1) *
+      sizeof(int));
+  if (!result->scores)
+    goto error;
+  for (size_t i = 0; i < filter->count; i++)
+    result->scores[filter->indices[i]] = filter->scores[filter->indices[i]];
+
+  rank_front(result->indices, result->count, ranked, result->scores);
+  result->ranked_count = ranked < result->count ? ranked : result->count;
+
+  return result;
+
+error:
+  filter_result_cleanup(result);
+  return NULL;
+}
+
+/* ============= Cleanup functions ============= */
+
+void filter_cleanup(filter_t *filter) {
+  if (!filter)
+    return;
+
+  filter_reset(filter);
+
+  if (filter->indices)
+    free(filter->indices);
+  if (filter->spare)
+    free(filter->spare);
+  if (filter->scores)
+    free(filter->scores);
+  if (filter->spare_scores)
+    free(filter->spare_scores);
+
+  *filter = (filter_t){0};
+}
+
+void filter_result_cleanup(filter_result_t *result) {
+  if (!result)
+    return;
+
+  if (result->indices)
+    free(result->indices);
+  if (result->scores)
+    free(result->scores);
+
+  free(result);
+}
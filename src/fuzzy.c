@@ -0,0 +1,91 @@
+#include "fuzzy.h"
+#include "utils.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SCORE_MATCH 16
+#define SCORE_GAP_START -3
+#define SCORE_GAP_EXTENSION -1
+
+#define BONUS_BOUNDARY 8
+#define BONUS_CAMEL 7
+#define BONUS_CONSECUTIVE 4
+#define BONUS_FIRST_CHAR_MULTIPLIER 2
+
+static inline bool is_separator(char c) {
+  return c == ' ' || c == '-' || c == '_' || c == '.' || c == '/' ||
+         c == ',' || c == ':' || c == '+';
+}
+
+// Bonus for match at text[i], based on the character before it
+static int position_bonus(const char *text, size_t i) {
+  if (i == 0 || is_separator(text[i - 1]))
+    return BONUS_BOUNDARY;
+
+  if (text[i - 1] >= 'a' && text[i - 1] <= 'z' && text[i] >= 'A' &&
+      text[i] <= 'Z')
+    return BONUS_CAMEL;
+
+  return 0;
+}
+
+static inline bool equal(char a, char b) {
+  return fold_ascii((unsigned char)a) == fold_ascii((unsigned char)b);
+}
+
+int fuzzy_score(const char *text, const char *pattern) {
+  if (!text || !pattern)
+    return FUZZY_NO_MATCH;
+  if (!*pattern)
+    return 0;
+
+  // Find the earliest end of the subsequence
+  size_t p = 0, end = 0;
+  for (size_t t = 0; text[t]; t++) {
+    if (equal(text[t], pattern[p]) && !pattern[++p]) {
+      end = t + 1;
+      break;
+    }
+  }
+  if (end == 0)
+    return FUZZY_NO_MATCH;
+
+  // Walk back to find the shortest window ending there
+  size_t start = end;
+  while (p > 0) {
+    start--;
+    if (equal(text[start], pattern[p - 1]))
+      p--;
+  }
+
+  // Score the window
+  int score = 0, chunk_bonus = 0;
+  bool in_gap = false, consecutive = false;
+  for (size_t t = start; t < end; t++) {
+    if (pattern[p] && equal(text[t], pattern[p])) {
+      int bonus = position_bonus(text, t);
+      if (consecutive) {
+        // Chunk keeps the bonus of its first character
+        if (chunk_bonus < BONUS_CONSECUTIVE)
+          chunk_bonus = BONUS_CONSECUTIVE;
+        if (bonus < chunk_bonus)
+          bonus = chunk_bonus;
+      } else {
+        chunk_bonus = bonus;
+      }
+
+      score += SCORE_MATCH +
+               (p == 0 ? bonus * BONUS_FIRST_CHAR_MULTIPLIER : bonus);
+      p++;
+      in_gap = false;
+      consecutive = true;
+    } else {
+      score += in_gap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+      in_gap = true;
+      consecutive = false;
+    }
+  }
+
+  return score;
+}
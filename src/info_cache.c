@@ -0,0 +1,111 @@
+#include "info_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NONE UINT32_MAX
+
+// FNV-1a
+static uint32_t hash(const char *str) {
+  uint32_t h = 2166136261u;
+  for (; *str; str++) {
+    h ^= (unsigned char)*str;
+    h *= 16777619u;
+  }
+  return h & (INFO_CACHE_BUCKETS - 1);
+}
+
+static void list_unlink(info_cache_t *cache, uint32_t idx) {
+  info_cache_entry_t *entry = &cache->entries[idx];
+
+  if (entry->prev != NONE)
+    cache->entries[entry->prev].next = entry->next;
+  else
+    cache->head = entry->next;
+
+  if (entry->next != NONE)
+    cache->entries[entry->next].prev = entry->prev;
+  else
+    cache->tail = entry->prev;
+}
+
+static void list_push_front(info_cache_t *cache, uint32_t idx) {
+  info_cache_entry_t *entry = &cache->entries[idx];
+
+  entry->prev = NONE;
+  entry->next = cache->head;
+  if (cache->head != NONE)
+    cache->entries[cache->head].prev = idx;
+  cache->head = idx;
+  if (cache->tail == NONE)
+    cache->tail = idx;
+}
+
+static void chain_unlink(info_cache_t *cache, uint32_t idx) {
+  uint32_t *link = &cache->buckets[hash(cache->entries[idx].pkgname)];
+  while (*link != idx)
+    link = &cache->entries[*link].chain;
+  *link = cache->entries[idx].chain;
+}
+
+void info_cache_init(info_cache_t *cache) {
+  memset(cache, 0, sizeof(info_cache_t));
+  for (uint32_t i = 0; i < INFO_CACHE_BUCKETS; i++)
+    cache->buckets[i] = NONE;
+  cache->head = cache->tail = NONE;
+}
+
+const package_info_t *info_cache_get(info_cache_t *cache,
+                                     struct xbps_handle *xhp,
+                                     const char *pkgname, REPO_TYPE repo_type) {
+  if (!cache || !pkgname)
+    return NULL;
+
+  uint32_t bucket = hash(pkgname);
+  for (uint32_t idx = cache->buckets[bucket]; idx != NONE;
+       idx = cache->entries[idx].chain) {
+    if (strcmp(cache->entries[idx].pkgname, pkgname) == 0) {
+      list_unlink(cache, idx);
+      list_push_front(cache, idx);
+      return cache->entries[idx].info;
+    }
+  }
+
+  char *key = strdup(pkgname);
+  if (!key)
+    return NULL;
+
+  uint32_t idx;
+  if (cache->count < INFO_CACHE_SIZE) {
+    idx = cache->count++;
+  } else {
+    // Evict the least recently used package
+    idx = cache->tail;
+    list_unlink(cache, idx);
+    chain_unlink(cache, idx);
+    free(cache->entries[idx].pkgname);
+    package_info_cleanup(cache->entries[idx].info);
+  }
+
+  info_cache_entry_t *entry = &cache->entries[idx];
+  entry->pkgname = key;
+  // Misses are cached too, so a missing package is looked up only once
+  entry->info = get_package_info(xhp, pkgname, repo_type);
+  entry->chain = cache->buckets[bucket];
+  cache->buckets[bucket] = idx;
+  list_push_front(cache, idx);
+
+  return entry->info;
+}
+
+void info_cache_cleanup(info_cache_t *cache) {
+  if (!cache)
+    return;
+
+  for (uint32_t i = 0; i < cache->count; i++) {
+    free(cache->entries[i].pkgname);
+    package_info_cleanup(cache->entries[i].info);
+  }
+
+  info_cache_init(cache);
+}
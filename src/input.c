@@ -6,6 +6,88 @@
 #define IS_DOWN_KEY(ch) (ch == 'j' || ch == NCKEY_DOWN)
 #define IS_UP_KEY(ch) (ch == 'k' || ch == NCKEY_UP)
 
+// Move selection of a list of `count` elements, `rows` of them visible
+static void move_selection(size_t *selected_idx, size_t *visible_start,
+                           size_t count, unsigned int rows, uint32_t key) {
+  if (IS_DOWN_KEY(key) && *selected_idx + 1 < count) {
+    (*selected_idx)++;
+    if (*selected_idx >= *visible_start + (size_t)rows) {
+      (*visible_start)++;
+    }
+  } else if (IS_UP_KEY(key) && *selected_idx > 0) {
+    (*selected_idx)--;
+    if (*selected_idx < *visible_start) {
+      if (*visible_start > 0)
+        (*visible_start)--;
+    }
+  } else if (key == NCKEY_PGUP) { // Page Up
+    if (*selected_idx > 0) {
+      *selected_idx = (*selected_idx > (size_t)rows) ? *selected_idx - rows : 0;
+    }
+    if (*visible_start > *selected_idx) {
+      *visible_start = *selected_idx;
+    }
+  } else if (key == NCKEY_PGDOWN && count > 0) { // Page Down
+    if (*selected_idx < count - 1) {
+      *selected_idx =
+          (*selected_idx + rows < count) ? *selected_idx + rows : count - 1;
+    }
+    if (*selected_idx >= *visible_start + (size_t)rows) {
+      *visible_start = *selected_idx - rows + 1;
+    }
+  }
+}
+
+// Edit files query, arrows move through the paths
+static void handle_files_input(model_t *state, const ncinput *ni) {
+  files_pane_t *files = &state->files;
+
+  unsigned int rows, cols;
+  ncplane_dim_yx(state->info_plane, &rows, &cols);
+
+  if (ni->id == NCKEY_BACKSPACE && files->query_len > 0) {
+    files->query[--files->query_len] = '\0';
+    files->query_edited = true;
+    state->dirty |= DIRTY_INFO;
+  } else if (ni->id >= 32 && ni->id <= 126 &&
+             files->query_len < sizeof(files->query) - 1) {
+    files->query[files->query_len++] = (char)ni->id;
+    files->query[files->query_len] = '\0';
+    files->query_edited = true;
+    state->dirty |= DIRTY_INFO;
+  } else {
+    // Header takes the first row
+    size_t selected = files->selected_idx;
+    move_selection(&files->selected_idx, &files->visible_start, files->count,
+                   rows > 1 ? rows - 1 : 1, ni->id);
+    if (files->selected_idx != selected)
+      state->dirty |= DIRTY_INFO;
+  }
+}
+
+// Walk dependency tree, right expands a package and left collapses it
+static void handle_deps_input(model_t *state, const ncinput *ni) {
+  deps_pane_t *deps = &state->deps;
+
+  if (ni->id == NCKEY_ENTER) {
+    deps_reroot(state);
+  } else if (ni->id == 'l' || ni->id == NCKEY_RIGHT) {
+    deps_expand(state);
+  } else if (ni->id == 'h' || ni->id == NCKEY_LEFT) {
+    deps_collapse(state);
+  } else {
+    unsigned int rows, cols;
+    ncplane_dim_yx(state->info_plane, &rows, &cols);
+
+    // Header takes the first row
+    size_t selected = deps->selected_idx;
+    move_selection(&deps->selected_idx, &deps->visible_start, deps->count,
+                   rows > 1 ? rows - 1 : 1, ni->id);
+    if (deps->selected_idx != selected)
+      state->dirty |= DIRTY_INFO;
+  }
+}
+
 ACTION handle_input(model_t *state, const ncinput *ni) {
   if (!state || !ni)
     return ERROR;
@@ -20,18 +102,58 @@ ACTION handle_input(model_t *state, const ncinput *ni) {
   if (ni->id == NCKEY_TAB)
     return SWITCH_TAB;
 
+  if (ni->id == NCKEY_F02) {
+    stats_toggle(state);
+    return SKIP;
+  }
+
+  // Toggle fuzzy matching
+  if ((state->focus == INPUT || state->focus == FILES) &&
+      ncinput_ctrl_p(ni) && (ni->id == 'f' || ni->id == 'F')) {
+    filter_set_mode(state, state->match_mode == MATCH_FUZZY ? MATCH_SUBSTRING
+                                                            : MATCH_FUZZY);
+    return SKIP;
+  }
+
+  // Toggle regex matching
+  if ((state->focus == INPUT || state->focus == FILES) &&
+      ncinput_ctrl_p(ni) && (ni->id == 'r' || ni->id == 'R')) {
+    filter_set_mode(state, state->match_mode == MATCH_REGEX ? MATCH_SUBSTRING
+                                                            : MATCH_REGEX);
+    return SKIP;
+  }
+
+  if (state->focus == FILES) {
+    handle_files_input(state, ni);
+    return SKIP;
+  }
+
+  if (state->focus == DEPS) {
+    handle_deps_input(state, ni);
+    return SKIP;
+  }
+
+  // Toggle path lookup
+  if (ncinput_ctrl_p(ni) && (ni->id == 'o' || ni->id == 'O')) {
+    owner_toggle(state);
+    return SKIP;
+  }
+
   // Hahdle user input
   if (state->focus == INPUT) {
     if (ni->id == NCKEY_ENTER) {
       state->focus = LIST;
+      state->dirty |= DIRTY_ALL;
     } else if (ni->id == NCKEY_BACKSPACE && state->input_len > 0) {
       state->input_buffer[--state->input_len] = '\0';
-      filter_elements(state);
+      state->query_edited = true;
+      state->dirty |= DIRTY_INPUT;
     } else if (ni->id >= 32 && ni->id <= 126 &&
                state->input_len < sizeof(state->input_buffer) - 1) {
       state->input_buffer[state->input_len++] = (char)ni->id;
       state->input_buffer[state->input_len] = '\0';
-      filter_elements(state);
+      state->query_edited = true;
+      state->dirty |= DIRTY_INPUT;
     }
 
     return SKIP;
@@ -42,38 +164,50 @@ ACTION handle_input(model_t *state, const ncinput *ni) {
     unsigned int rows, cols;
     ncplane_dim_yx(state->list_plane, &rows, &cols);
 
-    if (IS_DOWN_KEY(ni->id) &&
-        state->selected_idx + 1 < state->filtered_count) {
-      state->selected_idx++;
-      if (state->selected_idx >= state->visible_start + (size_t)rows) {
-        state->visible_start++;
-      }
-    } else if (IS_UP_KEY(ni->id) && state->selected_idx > 0) {
-      state->selected_idx--;
-      if (state->selected_idx < state->visible_start) {
-        if (state->visible_start > 0)
-          state->visible_start--;
-      }
-    } else if (ni->id == NCKEY_PGUP) { // Page Up
-      if (state->selected_idx > 0) {
-        state->selected_idx = (state->selected_idx > (size_t)rows)
-                                  ? state->selected_idx - rows
-                                  : 0;
-      }
-      if (state->visible_start > state->selected_idx) {
-        state->visible_start = state->selected_idx;
-      }
-    } else if (ni->id == NCKEY_PGDOWN) { // Page Down
-      if (state->selected_idx < state->filtered_count - 1) {
-        state->selected_idx =
-            (state->selected_idx + rows < state->filtered_count)
-                ? state->selected_idx + rows
-                : state->filtered_count - 1;
-      }
-      if (state->selected_idx >= state->visible_start + (size_t)rows) {
-        state->visible_start = state->selected_idx - rows + 1;
-      }
+    size_t count = state->owners.active ? state->owners.matches.count
+                                        : state->filtered_count;
+    if (ni->id == 'f') {
+      files_open(state);
+      return SKIP;
+    }
+    if (ni->id == 'd') {
+      deps_open(state);
+      return SKIP;
+    }
+    if (ni->id == 'o') {
+      orphans_toggle(state);
+      return SKIP;
+    }
+    if (ni->id == 'u') {
+      upgrades_toggle(state);
+      return SKIP;
+    }
+    if (ni->id == ' ') {
+      batch_mark(state);
+      return SKIP;
     }
+    if (ni->id == 'x') {
+      batch_submit(state);
+      return SKIP;
+    }
+    if ((ni->id == 'y' || ni->id == 'n') && state->batch.transaction) {
+      batch_answer(state, ni->id == 'y');
+      return SKIP;
+    }
+    if (ni->id == 's' || ni->id == 'S') {
+      sort_cycle(state, ni->id == 'S');
+      return SKIP;
+    }
+
+    size_t selected = state->selected_idx, start = state->visible_start;
+    move_selection(&state->selected_idx, &state->visible_start, count, rows,
+                   ni->id);
+
+    // Within the viewport only two rows change
+    if (state->visible_start != start)
+      state->dirty |= DIRTY_LIST | DIRTY_INFO;
+    else if (state->selected_idx != selected)
+      state->dirty |= DIRTY_SELECTION | DIRTY_INFO;
   }
 
   return SKIP;
@@ -1,20 +1,102 @@
 #include "defer.h"
 #include "model.h"
+#include "perf.h"
 #include "tui.h"
 #include <assert.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 #include <notcurses/notcurses.h>
 
-int main(void) {
+// Most --repository options accepted
+#define MAX_REPOSITORIES 32
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "Usage: %s [OPTIONS]\n"
+          "  -R, --remote            Browse packages of repositories\n"
+          "  -r, --rootdir <dir>     Full path to rootdir\n"
+          "  -C, --config <dir>      Path to confdir (xbps.d)\n"
+          "      --repository <url>  Add repository to the top of the list\n"
+          "      --trace <file>      Save Chrome trace of the session\n"
+          "  -h, --help              Show this help\n"
+          "\n"
+          "Environment:\n"
+          "  XUI_STATS=1             Start with stats overlay shown (F2)\n"
+          "  XUI_TRACE=<file>        Same as --trace\n"
+          "  XUI_PARALLEL_THRESHOLD=<n>\n"
+          "                          Split filter passes over at least n\n"
+          "                          packages across threads (default %d)\n",
+          name, FILTER_PARALLEL_THRESHOLD);
+}
+
+int main(int argc, char **argv) {
+  const struct option long_opts[] = {
+      {"remote", no_argument, NULL, 'R'},
+      {"rootdir", required_argument, NULL, 'r'},
+      {"config", required_argument, NULL, 'C'},
+      {"repository", required_argument, NULL, 1},
+      {"trace", required_argument, NULL, 2},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+
+  REPO_TYPE repo_type = LOCAL;
+  const char *repositories[MAX_REPOSITORIES];
+  search_config_t config = {.repositories = repositories};
+  const char *trace = getenv("XUI_TRACE");
+
+  int c;
+  while ((c = getopt_long(argc, argv, "Rr:C:h", long_opts, NULL)) != -1) {
+    switch (c) {
+    case 'R':
+      repo_type = REMOTE;
+      break;
+    case 'r':
+      config.rootdir = optarg;
+      break;
+    case 'C':
+      config.confdir = optarg;
+      break;
+    case 1:
+      if (config.repositories_count == MAX_REPOSITORIES) {
+        fprintf(stderr, "Too many repositories\n");
+        return 1;
+      }
+      repositories[config.repositories_count++] = optarg;
+      break;
+    case 2:
+      trace = optarg;
+      break;
+    case 'h':
+      usage(argv[0]);
+      return 0;
+    default:
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
   struct notcurses_options opts = {
       .flags = NCOPTION_NO_CLEAR_BITMAPS | NCOPTION_PRESERVE_CURSOR,
       .loglevel = NCLOGLEVEL_WARNING,
   };
-  model_t state = model_t_init(opts);
+  // Opened first, so that it's closed after every thread of the model stopped
+  if (trace && *trace && !perf_trace_open(trace)) {
+    fprintf(stderr, "Failed to open trace file: %s\n", trace);
+    return 1;
+  }
+  defer { perf_trace_close(); };
+
+  model_t state = model_t_init(opts, repo_type, &config);
   assert(state.nc);
 
   defer { model_t_cleanup(&state); };
 
+  const char *stats = getenv("XUI_STATS");
+  state.stats.visible = stats && *stats && *stats != '0';
+
   assert(run_app(&state) != 0);
 
   return 0;
@@ -1,13 +1,25 @@
 #include "model.h"
 
+#include "catalog_cache.h"
+#include "catalog_merge.h"
 #include "pkg_search.h"
-#include "utils.h"
+#include "sort_order.h"
+#include "trigram.h"
+#include <linux/limits.h>
 #include <notcurses/notcurses.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <xbps.h>
 
-model_t model_t_init(struct notcurses_options opts) {
+// Number of packages on each side of selection to prefetch
+#define INFO_PREFETCH 2
+
+model_t model_t_init(struct notcurses_options opts, REPO_TYPE repo_type,
+                     const search_config_t *config) {
   model_t state = {0};
+  state.stats.started = perf_now();
+  info_cache_init(&state.info_cache);
 
   state.nc = notcurses_init(&opts, NULL);
   if (!state.nc) {
@@ -16,43 +28,153 @@ model_t model_t_init(struct notcurses_options opts) {
   }
   ncplane_set_scrolling(notcurses_stdplane(state.nc), false);
 
-  if (xbps_init(&state.xhp) != 0) {
+  if (config)
+    state.config = *config;
+
+  if (!search_handle_init(&state.xhp, config)) {
     fprintf(stderr, "Initialization error: libxbps\n");
     notcurses_stop(state.nc);
     return (model_t){0};
   }
 
-  state.packages = search_packages(&state.xhp, "", LOCAL, false);
+  if (repo_type == REMOTE) {
+    // List starts empty, repositories are streamed in by the loader
+    state.packages = calloc(1, sizeof(search_result_t));
+    if (state.packages)
+      state.packages->repo_type = REMOTE;
+  } else {
+    state.packages = catalog_load(&state.xhp, LOCAL);
+  }
+
   if (!state.packages) {
     xbps_end(&state.xhp);
     notcurses_stop(state.nc);
     return (model_t){0};
   }
 
-  state.filtered_indices_cap = state.packages->count;
-  state.filtered_indices = malloc(state.filtered_indices_cap * sizeof(size_t));
-  if (!state.filtered_indices) {
+  // Index is optional, filtering falls back to scanning without it
+  if (state.packages->count > 0)
+    state.index = trigram_index_build(state.packages);
+
+  // Worker only reads the catalog, it's replaced only through
+  // `search_worker_set_catalog`
+  state.worker = search_worker_start(state.packages, state.index);
+  if (!state.worker) {
+    trigram_index_cleanup(state.index);
     search_result_cleanup(state.packages);
     xbps_end(&state.xhp);
     notcurses_stop(state.nc);
     return (model_t){0};
   }
 
+  if (repo_type == REMOTE) {
+    state.loader = catalog_loader_start(config, REMOTE);
+    if (!state.loader) {
+      search_worker_stop(state.worker);
+      trigram_index_cleanup(state.index);
+      search_result_cleanup(state.packages);
+      xbps_end(&state.xhp);
+      notcurses_stop(state.nc);
+      return (model_t){0};
+    }
+  }
+
+  // Without inotify the catalog just isn't updated live
+  state.watch = pkgdb_watch_start(config, state.xhp.metadir);
+
+  uint64_t elapsed = perf_span("model_t_init", state.stats.started);
+  if (!state.loader)
+    state.stats.load_ns = elapsed;
+
   return state;
 }
 
+static void files_pane_cleanup(files_pane_t *files) {
+  if (files->loader)
+    files_loader_stop(files->loader);
+  if (files->worker)
+    search_worker_stop(files->worker);
+
+  if (files->files)
+    search_result_cleanup(files->files);
+  if (files->index)
+    trigram_index_cleanup(files->index);
+
+  if (files->indices)
+    free(files->indices);
+  if (files->scores)
+    free(files->scores);
+
+  *files = (files_pane_t){0};
+}
+
+// Permutations belong to the catalog
+static void sort_orders_cleanup(model_t *state) {
+  for (int order = 0; order < SORT_ORDERS; order++) {
+    free(state->sort_orders[order]);
+    state->sort_orders[order] = NULL;
+  }
+}
+
 void model_t_cleanup(model_t *state) {
   if (!state)
     return;
 
+  if (state->loader)
+    catalog_loader_stop(state->loader);
+
+  if (state->watch)
+    pkgdb_watch_stop(state->watch);
+
+  if (state->worker)
+    search_worker_stop(state->worker);
+
+  files_pane_cleanup(&state->files);
+
+  if (state->deps.graph)
+    dep_graph_cleanup(state->deps.graph);
+  if (state->deps.rows)
+    free(state->deps.rows);
+
+  if (state->orphans.graph)
+    dep_graph_cleanup(state->orphans.graph);
+  free(state->orphans.ids);
+  free(state->orphans.members);
+  free(state->upgrades.members);
+
+  // Waits for a running transaction, it can't be left half-done
+  transaction_stop(state->batch.transaction);
+  free(state->batch.marked);
+  free(state->batch.submitted);
+
+  if (state->owners.loader)
+    owner_loader_stop(state->owners.loader);
+  if (state->owners.worker)
+    owner_worker_stop(state->owners.worker);
+  if (state->owners.index)
+    owner_index_cleanup(state->owners.index);
+  owner_matches_cleanup(&state->owners.matches);
+
   if (state->packages)
     search_result_cleanup(state->packages);
 
+  if (state->index)
+    trigram_index_cleanup(state->index);
+
   if (state->filtered_indices)
     free(state->filtered_indices);
 
+  if (state->scores)
+    free(state->scores);
+
+  sort_orders_cleanup(state);
+
+  info_cache_cleanup(&state->info_cache);
+
   xbps_end(&state->xhp);
 
+  if (state->stats_plane)
+    ncplane_destroy(state->stats_plane);
   if (state->info_plane)
     ncplane_destroy(state->info_plane);
   if (state->input_plane)
@@ -63,48 +185,1312 @@ void model_t_cleanup(model_t *state) {
     notcurses_stop(state->nc);
 }
 
+// Number of rows of the list, i.e. how many matches have to be ranked
+static size_t page_size(const model_t *state) {
+  unsigned rows = 0, cols = 0;
+  if (state->list_plane)
+    ncplane_dim_yx(state->list_plane, &rows, &cols);
+
+  return rows > 0 ? rows : 1;
+}
+
+// Put matches in the chosen sort order. Permutation of the catalog is built
+// once, every result after that is ordered in one pass over it
+static void order_matches(model_t *state) {
+  if (state->sort == SORT_MATCH)
+    return;
+
+  // Every other order starts from the name order, it breaks their ties
+  uint32_t **by_name = &state->sort_orders[SORT_NAME];
+  uint32_t **permutation = &state->sort_orders[state->sort];
+  if (!*permutation) {
+    uint64_t start = perf_now();
+    if (!*by_name)
+      *by_name = sort_order_build(state->packages, SORT_NAME, NULL);
+    if (!*permutation)
+      *permutation = sort_order_build(state->packages, state->sort, *by_name);
+    perf_span("sort_order_build", start);
+  }
+
+  uint64_t start = perf_now();
+  if (sort_order_apply(*permutation, state->packages->count,
+                       state->filtered_indices, state->filtered_count))
+    state->ranked_count = state->filtered_count;
+  perf_span("sort_order_apply", start);
+}
+
+// Drop matches that aren't in `members` bitmap of the view, order of the
+// rest is kept
+static void restrict_matches(model_t *state, const uint64_t *members) {
+  size_t kept = 0, ranked = 0;
+
+  for (size_t i = 0; i < state->filtered_count; i++) {
+    size_t idx = state->filtered_indices[i];
+    if (!members || !(members[idx / 64] & (1ull << (idx % 64))))
+      continue;
+
+    state->filtered_indices[kept++] = idx;
+    if (i < state->ranked_count)
+      ranked++;
+  }
+
+  state->filtered_count = kept;
+  state->ranked_count = ranked;
+}
+
+// Mark orphans in catalog, which numbers packages its own way
+static bool orphans_map(model_t *state) {
+  orphans_view_t *orphans = &state->orphans;
+  const search_result_t *packages = state->packages;
+
+  free(orphans->members);
+  orphans->members =
+      calloc(((size_t)packages->count + 63) / 64 + 1, sizeof(uint64_t));
+  uint64_t *orphan = calloc(
+      ((size_t)orphans->graph->nodes->count + 63) / 64 + 1, sizeof(uint64_t));
+  if (!orphans->members || !orphan) {
+    free(orphan);
+    return false;
+  }
+
+  for (uint32_t i = 0; i < orphans->count; i++)
+    orphan[orphans->ids[i] / 64] |= 1ull << (orphans->ids[i] % 64);
+
+  for (uint32_t i = 0; i < packages->count; i++) {
+    uint32_t id = pkgname_table_find(&orphans->graph->names,
+                                     search_result_pkgver(packages, i),
+                                     packages->packages[i].name_len);
+    if (id != PKGNAME_NOT_FOUND && (orphan[id / 64] & (1ull << (id % 64))))
+      orphans->members[i / 64] |= 1ull << (i % 64);
+  }
+
+  free(orphan);
+  return true;
+}
+
+// Find upgradable packages of the current catalog
+static bool upgrades_find(model_t *state) {
+  upgrades_view_t *upgrades = &state->upgrades;
+  uint64_t start = perf_now();
+
+  free(upgrades->members);
+  upgrades->count = 0;
+  upgrades->members =
+      calloc(((size_t)state->packages->count + 63) / 64 + 1, sizeof(uint64_t));
+  if (!upgrades->members)
+    return false;
+
+  bool found = catalog_upgrades(state->packages, upgrades->members,
+                                &upgrades->count);
+  perf_span("upgrades_find", start);
+  state->dirty |= DIRTY_INFO;
+  return found;
+}
+
 void filter_elements(model_t *state) {
-  if (state->input_len == 0) {
-    state->filtered_count = state->packages->count;
-    if (state->filtered_indices_cap < state->packages->count) {
-      state->filtered_indices = realloc(
-          state->filtered_indices, state->packages->count * sizeof(size_t));
-      state->filtered_indices_cap = state->packages->count;
-    }
-    for (size_t i = 0; i < state->packages->count; i++) {
-      state->filtered_indices[i] = i;
-    }
-    state->selected_idx = 0;
-    state->visible_start = 0;
-    return;
-  }
-
-  // Filtering by substring
-  state->filtered_count = 0;
-  for (size_t i = 0; i < state->packages->count; i++) {
-    package_info_t *pkg = &state->packages->packages[i];
-    if ((pkg->pkgver &&
-         strcasestr_portable(pkg->pkgver, state->input_buffer)) ||
-        (pkg->short_desc &&
-         strcasestr_portable(pkg->short_desc, state->input_buffer))) {
-
-      if (state->filtered_count >= state->filtered_indices_cap) {
-        state->filtered_indices_cap = state->filtered_indices_cap > 0
-                                          ? state->filtered_indices_cap * 2
-                                          : 128;
-        state->filtered_indices =
-            realloc(state->filtered_indices,
-                    state->filtered_indices_cap * sizeof(size_t));
-      }
-      state->filtered_indices[state->filtered_count++] = i;
-    }
+  uint64_t start = perf_now();
+  state->filter_generation = search_worker_submit(
+      state->worker, state->input_buffer, state->match_mode, page_size(state));
+  state->filter_pending = true;
+  perf_span("filter_elements", start);
+}
+
+void query_flush(model_t *state) {
+  if (!state)
+    return;
+
+  if (state->query_edited) {
+    state->query_edited = false;
+    if (state->owners.active)
+      owner_lookup(state);
+    else
+      filter_elements(state);
+  }
+
+  if (state->files.query_edited) {
+    state->files.query_edited = false;
+    files_filter(state);
   }
+}
+
+// Position of catalog package `idx` among matches, filtered_count if it
+// isn't one of them
+static size_t match_position(const model_t *state, uint32_t idx) {
+  size_t i = 0;
+  while (i < state->filtered_count && state->filtered_indices[i] != idx)
+    i++;
+
+  return i;
+}
+
+// Select followed package on the row it had, false if it doesn't match
+static bool follow_selection(model_t *state) {
+  size_t position = match_position(state, state->follow);
+  if (position >= state->filtered_count)
+    return false;
+
+  // Fuzzy matches past the first page aren't in their final place yet
+  if (position >= state->ranked_count) {
+    filter_rank(state, state->filtered_count);
+    position = match_position(state, state->follow);
+  }
+
+  size_t row = state->selected_idx - state->visible_start;
+  state->selected_idx = position;
+  state->visible_start = position >= row ? position - row : 0;
+  return true;
+}
 
-  if (state->filtered_count == 0) {
+bool filter_poll(model_t *state, bool wait) {
+  if (!state->filter_pending)
+    return false;
+
+  if (wait)
+    search_worker_wait(state->worker, state->filter_generation);
+
+  filter_result_t *result = search_worker_take(state->worker);
+  if (!result)
+    return false;
+
+  // Never display result of an outdated query
+  if (result->generation != state->filter_generation) {
+    filter_result_cleanup(result);
+    return false;
+  }
+
+  free(state->filtered_indices);
+  free(state->scores);
+  state->filtered_indices = result->indices;
+  state->filtered_count = result->count;
+  state->scores = result->scores;
+  state->ranked_count = result->ranked_count;
+  state->filter_pending = false;
+  state->filter_invalid = result->invalid;
+  state->stats.filter_ns = result->elapsed_ns;
+  state->dirty |= DIRTY_LIST | DIRTY_INFO;
+  perf_counter("matches", state->filtered_count);
+
+  result->indices = NULL;
+  result->scores = NULL;
+  filter_result_cleanup(result);
+
+  if (state->orphans.active)
+    restrict_matches(state, state->orphans.members);
+  else if (state->upgrades.active)
+    restrict_matches(state, state->upgrades.members);
+  order_matches(state);
+
+  // Selection belongs to the path lookup meanwhile
+  if (state->owners.active)
+    return true;
+
+  if (state->following) {
+    state->following = false;
+    if (follow_selection(state))
+      return true;
+  }
+
+  if (state->input_len == 0 || state->filtered_count == 0) {
     state->selected_idx = 0;
   } else if (state->selected_idx >= state->filtered_count) {
     state->selected_idx = state->filtered_count - 1;
   }
 
   state->visible_start = 0;
+  return true;
+}
+
+void filter_set_mode(model_t *state, MATCH_MODE mode) {
+  state->match_mode = mode;
+  state->dirty |= DIRTY_INPUT | DIRTY_INFO;
+  filter_elements(state);
+
+  // File list uses the same matcher
+  files_filter(state);
+}
+
+void filter_rank(model_t *state, size_t count) {
+  if (!state || count <= state->ranked_count)
+    return;
+
+  // Everything past the ranked prefix ranks lower, sort it once
+  if (state->scores) {
+    filter_rank_rest(state->filtered_indices, state->filtered_count,
+                     state->ranked_count, state->scores);
+    state->ranked_count = state->filtered_count;
+  }
+}
+
+void sort_cycle(model_t *state, bool backwards) {
+  if (!state || state->owners.active)
+    return;
+
+  unsigned step = backwards ? SORT_ORDERS - 1 : 1;
+  state->sort = (SORT_ORDER)((state->sort + step) % SORT_ORDERS);
+  state->selected_idx = 0;
+  state->visible_start = 0;
+  state->dirty |= DIRTY_LIST | DIRTY_INPUT | DIRTY_INFO;
+
+  // Matcher's order is only known to the worker, ask it again
+  if (state->sort != SORT_MATCH)
+    order_matches(state);
+  else
+    filter_elements(state);
+}
+
+bool catalog_poll(model_t *state) {
+  if (!state || !state->loader)
+    return false;
+
+  catalog_snapshot_t *snapshot = catalog_loader_take(state->loader);
+  if (!snapshot)
+    return false;
+
+  state->repos_loaded = snapshot->repos_loaded;
+  state->repos_total = snapshot->repos_total;
+  state->dirty |= DIRTY_INFO;
+
+  if (snapshot->packages &&
+      search_worker_set_catalog(state->worker, snapshot->packages,
+                                snapshot->index)) {
+    search_result_cleanup(state->packages);
+    trigram_index_cleanup(state->index);
+    sort_orders_cleanup(state);
+    state->packages = snapshot->packages;
+    state->index = snapshot->index;
+    snapshot->packages = NULL;
+    snapshot->index = NULL;
+    state->dirty |= DIRTY_LIST;
+
+    if (state->orphans.graph)
+      orphans_map(state);
+    if (state->upgrades.members)
+      upgrades_find(state);
+
+    // Snapshot extends the old catalog, so current matches stay valid and
+    // remain on screen until the new result arrives. Selected package keeps
+    // its row once it does, like after a pkgdb patch
+    if (!state->owners.active && state->selected_idx < state->filtered_count) {
+      state->follow = (uint32_t)state->filtered_indices[state->selected_idx];
+      state->following = true;
+    }
+    filter_elements(state);
+  }
+
+  if (snapshot->complete) {
+    catalog_loader_stop(state->loader);
+    state->loader = NULL;
+    state->stats.load_ns = perf_span("catalog_load", state->stats.started);
+  }
+
+  catalog_snapshot_cleanup(snapshot);
+  return true;
+}
+
+// Move matches, marks and orphans over to the patched catalog, so that the
+// screen stays valid until the new result arrives
+// Bitmap over the old catalog moved to `words` long bitmap over the patched
+// one, NULL on error. `count` is set to the number of bits kept
+static uint64_t *remap_bits(const uint64_t *bits, uint32_t bits_words,
+                            const catalog_patch_t *patch, uint32_t words,
+                            uint32_t *count) {
+  uint64_t *moved = calloc(words, sizeof(uint64_t));
+  *count = 0;
+  for (uint32_t word = 0; moved && word < bits_words; word++) {
+    for (uint64_t set = bits[word]; set; set &= set - 1) {
+      uint32_t idx = patch->remap[word * 64 + (uint32_t)__builtin_ctzll(set)];
+      if (idx == CATALOG_REMOVED)
+        continue;
+
+      moved[idx / 64] |= 1ull << (idx % 64);
+      (*count)++;
+    }
+  }
+
+  return moved;
+}
+
+static void remap_catalog(model_t *state, const catalog_patch_t *patch) {
+  const uint32_t *remap = patch->remap;
+  size_t kept = 0;
+
+  if (state->selected_idx < state->filtered_count) {
+    state->follow = remap[state->filtered_indices[state->selected_idx]];
+    state->following = state->follow != CATALOG_REMOVED;
+  }
+
+  for (size_t i = 0; i < state->filtered_count; i++) {
+    if (remap[state->filtered_indices[i]] != CATALOG_REMOVED)
+      state->filtered_indices[kept++] = remap[state->filtered_indices[i]];
+  }
+
+  // Scores are of the old indices, these matches are only shown as they are
+  state->filtered_count = kept;
+  state->ranked_count = kept;
+  if (state->selected_idx >= kept)
+    state->selected_idx = kept > 0 ? kept - 1 : 0;
+  if (state->visible_start > state->selected_idx)
+    state->visible_start = state->selected_idx;
+
+  // Marks are dropped rather than left on wrong packages
+  batch_view_t *batch = &state->batch;
+  uint32_t words = (patch->packages->count + 63) / 64 + 1;
+  uint64_t *marked = remap_bits(batch->marked, batch->marked_words, patch,
+                                words, &batch->marked_count);
+  free(batch->marked);
+  batch->marked = marked;
+  batch->marked_words = marked ? words : 0;
+
+  uint32_t submitted_count;
+  uint64_t *submitted = remap_bits(batch->submitted, batch->submitted_words,
+                                   patch, words, &submitted_count);
+  free(batch->submitted);
+  batch->submitted = submitted;
+  batch->submitted_words = submitted ? words : 0;
+}
+
+// Read pkgdb of the UI handle again, details are read again as well. Never
+// blocks, if another thread uses pkgdb it's retried by the next poll
+static bool pkgdb_reload(model_t *state) {
+  state->pkgdb_stale = !search_pkgdb_update(&state->xhp, false);
+  if (state->pkgdb_stale)
+    return false;
+
+  info_cache_cleanup(&state->info_cache);
+  deps_refresh(state);
+  state->dirty |= DIRTY_INFO;
+  return true;
+}
+
+// Loaders with their own handle read the new pkgdb as well. Owner index is
+// loaded again if it was ever asked for, lookup is repeated once it arrives
+static void pkgdb_loaders_refresh(model_t *state) {
+  if (state->files.loader)
+    files_loader_refresh(state->files.loader);
+
+  owner_search_t *owners = &state->owners;
+  if (!owners->index && !owners->loader)
+    return;
+
+  owner_loader_stop(owners->loader);
+  owner_worker_stop(owners->worker);
+  owner_index_cleanup(owners->index);
+  owner_matches_cleanup(&owners->matches);
+  owners->index = NULL;
+  owners->worker = NULL;
+  owners->pending = false;
+  owners->loader = owner_loader_start(&state->config);
+  state->dirty |= DIRTY_LIST | DIRTY_INFO;
+}
+
+bool pkgdb_poll(model_t *state) {
+  if (state && state->pkgdb_stale)
+    pkgdb_reload(state);
+  if (!state || !state->watch || state->loader)
+    return false;
+
+  search_result_t *local = pkgdb_watch_take(state->watch);
+  if (!local)
+    return false;
+
+  uint64_t start = perf_now();
+  catalog_patch_t patch;
+  bool patched = catalog_patch(state->packages, local, &patch);
+  search_result_cleanup(local);
+  if (!patched)
+    return false;
+
+  // Written by a transaction that changed nothing, or written twice
+  if (patch.added + patch.removed + patch.changed == 0) {
+    catalog_patch_cleanup(&patch);
+    return false;
+  }
+
+  // Index only needs rebuilding if packages moved or their text changed
+  trigram_index_t *index = state->index;
+  if (patch.reindex)
+    index = patch.packages->count > 0
+                ? trigram_index_build(patch.packages)
+                : NULL;
+
+  if (!search_worker_set_catalog(state->worker, patch.packages, index)) {
+    if (index != state->index)
+      trigram_index_cleanup(index);
+    catalog_patch_cleanup(&patch);
+    return false;
+  }
+
+  remap_catalog(state, &patch);
+  search_result_cleanup(state->packages);
+  if (index != state->index)
+    trigram_index_cleanup(state->index);
+  sort_orders_cleanup(state);
+  state->packages = patch.packages;
+  state->index = index;
+  patch.packages = NULL;
+
+  if (state->orphans.graph)
+    orphans_map(state);
+  if (state->upgrades.members)
+    upgrades_find(state);
+
+  // Handle of the UI reads the new pkgdb
+  pkgdb_reload(state);
+  pkgdb_loaders_refresh(state);
+
+  catalog_patch_cleanup(&patch);
+  perf_span("pkgdb_patch", start);
+  state->dirty |= DIRTY_LIST | DIRTY_INFO;
+
+  filter_elements(state);
+  return true;
+}
+
+// Installed packages of the joined catalog are read from pkgdb, it's cheaper
+// than repodata
+static REPO_TYPE package_source(const model_t *state, uint32_t pkg) {
+  if (search_result_installed(state->packages, pkg))
+    return LOCAL;
+
+  return state->packages->repo_type;
+}
+
+const package_info_t *filtered_info(model_t *state, size_t idx) {
+  if (!state || idx >= state->filtered_count)
+    return NULL;
+
+  uint32_t pkg = (uint32_t)state->filtered_indices[idx];
+  REPO_TYPE repo_type = package_source(state, pkg);
+
+  // Looking package up would make libxbps parse repodata on the UI thread,
+  // while the loader is still doing the same
+  if (state->loader && repo_type == REMOTE)
+    return NULL;
+
+  const char *pkgver = search_result_pkgver(state->packages, pkg);
+  if (!pkgver)
+    return NULL;
+
+  char pkgname[XBPS_NAME_SIZE];
+  if (!xbps_pkg_name(pkgname, sizeof(pkgname), pkgver))
+    return NULL;
+
+  return info_cache_get(&state->info_cache, &state->xhp, pkgname, repo_type);
+}
+
+const package_info_t *owner_info(model_t *state, size_t idx) {
+  const owner_search_t *owners = &state->owners;
+  if (!owners->index || idx >= owners->matches.count)
+    return NULL;
+
+  const char *pkgver = owner_index_owner(
+      owners->index, owner_matches_get(&owners->matches, (uint32_t)idx));
+
+  char pkgname[XBPS_NAME_SIZE];
+  if (!xbps_pkg_name(pkgname, sizeof(pkgname), pkgver))
+    return NULL;
+
+  return info_cache_get(&state->info_cache, &state->xhp, pkgname, LOCAL);
+}
+
+void prefetch_info(model_t *state) {
+  if (!state || state->owners.active)
+    return;
+
+  for (size_t i = 1; i <= INFO_PREFETCH; i++) {
+    filtered_info(state, state->selected_idx + i);
+    if (state->selected_idx >= i)
+      filtered_info(state, state->selected_idx - i);
+  }
+
+  // Selected package stays the most recently used one
+  filtered_info(state, state->selected_idx);
+}
+
+/* ============= Files pane ============= */
+
+// Number of rows of the files pane, below its header
+static size_t files_page_size(const model_t *state) {
+  unsigned rows = 0, cols = 0;
+  if (state->info_plane)
+    ncplane_dim_yx(state->info_plane, &rows, &cols);
+
+  return rows > 1 ? rows - 1 : 1;
+}
+
+// Name and source of the selected package, or owner of the selected path
+static bool selected_package(const model_t *state, char *pkgname, size_t size,
+                             REPO_TYPE *repo_type) {
+  const char *pkgver = NULL;
+
+  if (state->owners.active) {
+    const owner_search_t *owners = &state->owners;
+    if (!owners->index || state->selected_idx >= owners->matches.count)
+      return false;
+
+    pkgver = owner_index_owner(
+        owners->index,
+        owner_matches_get(&owners->matches, (uint32_t)state->selected_idx));
+    *repo_type = LOCAL;
+  } else {
+    if (state->selected_idx >= state->filtered_count)
+      return false;
+
+    uint32_t pkg = (uint32_t)state->filtered_indices[state->selected_idx];
+    pkgver = search_result_pkgver(state->packages, pkg);
+    *repo_type = package_source(state, pkg);
+  }
+
+  return pkgver && xbps_pkg_name(pkgname, size, pkgver);
+}
+
+bool files_open(model_t *state) {
+  if (!state)
+    return false;
+
+  files_pane_t *files = &state->files;
+
+  char pkgname[XBPS_NAME_SIZE];
+  REPO_TYPE repo_type;
+  if (!selected_package(state, pkgname, sizeof(pkgname), &repo_type))
+    return false;
+
+  if (!files->loader) {
+    files->loader = files_loader_start(&state->config);
+    if (!files->loader)
+      return false;
+  }
+
+  // Same package is still loaded or loading, keep its query and position
+  if (strcmp(files->pkgname, pkgname) != 0 ||
+      (!files->files && !files->loading)) {
+    memcpy(files->pkgname, pkgname, sizeof(pkgname));
+    files->request = files_loader_request(files->loader, pkgname, repo_type);
+    files->loading = true;
+    files->count = 0;
+    files->selected_idx = 0;
+    files->visible_start = 0;
+  }
+
+  state->focus = FILES;
+  state->dirty |= DIRTY_ALL;
+  return true;
+}
+
+void files_filter(model_t *state) {
+  files_pane_t *files = &state->files;
+  if (!files->worker || !files->files)
+    return;
+
+  files->filter_generation =
+      search_worker_submit(files->worker, files->query, state->match_mode,
+                           files_page_size(state));
+  files->filter_pending = true;
+  state->dirty |= DIRTY_INFO;
+}
+
+// Replace file list with a newly loaded one
+static bool files_adopt(model_t *state, files_snapshot_t *snapshot) {
+  files_pane_t *files = &state->files;
+
+  // Worker has to let go of the old list before it's freed
+  if (snapshot->files && files->worker) {
+    if (!search_worker_set_catalog(files->worker, snapshot->files,
+                                   snapshot->index))
+      return false;
+  } else if (snapshot->files) {
+    files->worker = search_worker_start(snapshot->files, snapshot->index);
+    if (!files->worker)
+      return false;
+  } else if (files->worker) {
+    // Package has no file list, there's nothing to filter
+    search_worker_stop(files->worker);
+    files->worker = NULL;
+    files->filter_pending = false;
+  }
+
+  if (files->files)
+    search_result_cleanup(files->files);
+  if (files->index)
+    trigram_index_cleanup(files->index);
+
+  files->files = snapshot->files;
+  files->index = snapshot->index;
+  snapshot->files = NULL;
+  snapshot->index = NULL;
+
+  // Matches belong to the old list
+  files->count = 0;
+  files->selected_idx = 0;
+  files->visible_start = 0;
+
+  if (files->files)
+    files_filter(state);
+
+  return true;
+}
+
+bool files_poll(model_t *state) {
+  files_pane_t *files = &state->files;
+  bool changed = false;
+
+  files_snapshot_t *snapshot =
+      files->loader ? files_loader_take(files->loader) : NULL;
+  if (snapshot && snapshot->generation == files->request) {
+    files->loading = false;
+    files_adopt(state, snapshot);
+    state->dirty |= DIRTY_INFO;
+    changed = true;
+  }
+  files_snapshot_cleanup(snapshot);
+
+  if (!files->filter_pending)
+    return changed;
+
+  filter_result_t *result = search_worker_take(files->worker);
+  if (!result)
+    return changed;
+
+  // Never display result of an outdated query
+  if (result->generation != files->filter_generation) {
+    filter_result_cleanup(result);
+    return changed;
+  }
+
+  free(files->indices);
+  free(files->scores);
+  files->indices = result->indices;
+  files->count = result->count;
+  files->scores = result->scores;
+  files->ranked_count = result->ranked_count;
+  files->filter_pending = false;
+  files->filter_invalid = result->invalid;
+  state->dirty |= DIRTY_INFO;
+
+  result->indices = NULL;
+  result->scores = NULL;
+  filter_result_cleanup(result);
+
+  if (files->selected_idx >= files->count)
+    files->selected_idx = files->count > 0 ? files->count - 1 : 0;
+  files->visible_start = 0;
+
+  return true;
+}
+
+void files_rank(model_t *state, size_t count) {
+  files_pane_t *files = &state->files;
+  if (!files->scores || count <= files->ranked_count)
+    return;
+
+  filter_rank_rest(files->indices, files->count, files->ranked_count,
+                   files->scores);
+  files->ranked_count = files->count;
+}
+
+/* ============= Dependencies pane ============= */
+
+// Make room for `extra` more rows
+static bool deps_reserve(deps_pane_t *deps, size_t extra) {
+  if (deps->count + extra <= deps->cap)
+    return true;
+
+  size_t cap = deps->cap > 0 ? deps->cap * 2 : 64;
+  while (cap < deps->count + extra)
+    cap *= 2;
+
+  dep_row_t *rows = realloc(deps->rows, cap * sizeof(dep_row_t));
+  if (!rows)
+    return false;
+
+  deps->rows = rows;
+  deps->cap = cap;
+  return true;
+}
+
+// Insert neighbours of `node` right after row `at`, one level deeper
+static bool deps_insert(deps_pane_t *deps, size_t at, uint32_t node) {
+  uint32_t count;
+  DEP_DIRECTION dir = (DEP_DIRECTION)deps->rows[at].direction;
+  const uint32_t *edges = dep_graph_edges(deps->graph, node, dir, &count);
+  if (!deps_reserve(deps, count))
+    return false;
+
+  dep_row_t *rows = deps->rows;
+  memmove(&rows[at + 1 + count], &rows[at + 1],
+          (deps->count - at - 1) * sizeof(dep_row_t));
+  for (uint32_t i = 0; i < count; i++) {
+    rows[at + 1 + i] = (dep_row_t){.node = edges[i],
+                                   .depth = (uint16_t)(rows[at].depth + 1),
+                                   .direction = (uint8_t)dir};
+  }
+
+  deps->count += count;
+  rows[at].expanded = true;
+  return true;
+}
+
+// Show tree of `root`: both sections with their direct neighbours
+static void deps_show(model_t *state, uint32_t root) {
+  deps_pane_t *deps = &state->deps;
+  deps->root = root;
+  deps->count = 0;
+  deps->selected_idx = 0;
+  deps->visible_start = 0;
+  state->dirty |= DIRTY_INFO;
+
+  if (root == DEP_GRAPH_NONE)
+    return;
+
+  for (int dir = DEP_DEPENDS; dir <= DEP_RDEPENDS; dir++) {
+    deps->closure[dir] =
+        dep_graph_closure(deps->graph, root, (DEP_DIRECTION)dir, NULL);
+
+    if (!deps_reserve(deps, 1))
+      return;
+    deps->rows[deps->count++] = (dep_row_t){
+        .node = DEP_GRAPH_NONE, .depth = 0, .direction = (uint8_t)dir};
+    deps_insert(deps, deps->count - 1, root);
+  }
+}
+
+bool deps_cycle(const deps_pane_t *deps, size_t row) {
+  if (!deps || row >= deps->count)
+    return false;
+
+  uint32_t node = deps->rows[row].node;
+  if (node == deps->root)
+    return true;
+
+  // Ancestors are the nearest preceding rows of each smaller depth
+  uint16_t depth = deps->rows[row].depth;
+  for (size_t i = row; i-- > 0 && depth > 1;) {
+    if (deps->rows[i].depth >= depth)
+      continue;
+
+    if (deps->rows[i].node == node)
+      return true;
+    depth = deps->rows[i].depth;
+  }
+
+  return false;
+}
+
+bool deps_open(model_t *state) {
+  if (!state)
+    return false;
+
+  deps_pane_t *deps = &state->deps;
+
+  char pkgname[XBPS_NAME_SIZE];
+  REPO_TYPE repo_type;
+  if (!selected_package(state, pkgname, sizeof(pkgname), &repo_type))
+    return false;
+
+  // Graph covers what the list shows: pkgdb or every repository
+  if (!deps->graph) {
+    deps->graph = dep_graph_build(&state->xhp, state->packages->repo_type);
+    if (!deps->graph)
+      return false;
+  }
+
+  deps_show(state, dep_graph_find(deps->graph, pkgname));
+
+  state->focus = DEPS;
+  state->dirty |= DIRTY_ALL;
+  return true;
+}
+
+void deps_reroot(model_t *state) {
+  deps_pane_t *deps = &state->deps;
+  if (deps->selected_idx >= deps->count)
+    return;
+
+  uint32_t node = deps->rows[deps->selected_idx].node;
+  if (node != DEP_GRAPH_NONE)
+    deps_show(state, node);
+}
+
+void deps_refresh(model_t *state) {
+  deps_pane_t *deps = &state->deps;
+  if (!deps->graph || deps->graph->nodes->repo_type != LOCAL)
+    return;
+
+  char pkgname[XBPS_NAME_SIZE] = "";
+  if (deps->root != DEP_GRAPH_NONE)
+    xbps_pkg_name(pkgname, sizeof(pkgname),
+                  search_result_pkgver(deps->graph->nodes, deps->root));
+
+  dep_graph_cleanup(deps->graph);
+  deps->graph = NULL;
+  if (state->focus != DEPS)
+    return;
+
+  // Root that was removed leaves the tree empty
+  deps->graph = dep_graph_build(&state->xhp, LOCAL);
+  if (!deps->graph) {
+    deps->count = 0;
+    state->focus = LIST;
+    state->dirty |= DIRTY_ALL;
+    return;
+  }
+
+  deps_show(state, dep_graph_find(deps->graph, pkgname));
+}
+
+void deps_expand(model_t *state) {
+  deps_pane_t *deps = &state->deps;
+  size_t at = deps->selected_idx;
+  if (at >= deps->count || deps->rows[at].expanded)
+    return;
+
+  // Header holds neighbours of root, cycles would never end
+  uint32_t node = deps->rows[at].node;
+  if (node == DEP_GRAPH_NONE)
+    node = deps->root;
+  else if (deps_cycle(deps, at))
+    return;
+
+  uint32_t count;
+  dep_graph_edges(deps->graph, node, (DEP_DIRECTION)deps->rows[at].direction,
+                  &count);
+  if (count > 0 && deps_insert(deps, at, node))
+    state->dirty |= DIRTY_INFO;
+}
+
+void deps_collapse(model_t *state) {
+  deps_pane_t *deps = &state->deps;
+  size_t at = deps->selected_idx;
+  if (at >= deps->count)
+    return;
+
+  dep_row_t *rows = deps->rows;
+  if (rows[at].expanded) {
+    size_t end = at + 1;
+    while (end < deps->count && rows[end].depth > rows[at].depth)
+      end++;
+
+    memmove(&rows[at + 1], &rows[end], (deps->count - end) * sizeof(dep_row_t));
+    deps->count -= end - at - 1;
+    rows[at].expanded = false;
+  } else {
+    // Select parent
+    while (at > 0 && rows[at - 1].depth >= rows[deps->selected_idx].depth)
+      at--;
+    if (at > 0)
+      deps->selected_idx = at - 1;
+    if (deps->visible_start > deps->selected_idx)
+      deps->visible_start = deps->selected_idx;
+  }
+
+  state->dirty |= DIRTY_INFO;
+}
+
+/* ============= Orphans ============= */
+
+// Modification time of pkgdb in nanoseconds, 0 if it can't be read
+static uint64_t pkgdb_mtime(const model_t *state) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", state->xhp.metadir, XBPS_PKGDB);
+
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return 0;
+
+  return (uint64_t)st.st_mtim.tv_sec * 1000000000ull +
+         (uint64_t)st.st_mtim.tv_nsec;
+}
+
+// Build graph of pkgdb and find orphans in it, unless pkgdb is unchanged.
+// Returns true if they were found again
+static bool orphans_find(model_t *state) {
+  orphans_view_t *orphans = &state->orphans;
+  uint64_t mtime = pkgdb_mtime(state);
+  if (orphans->graph && mtime == orphans->pkgdb_mtime)
+    return false;
+
+  uint64_t start = perf_now();
+
+  // libxbps keeps pkgdb in memory, it has to read the new one first. Tree
+  // built from the old one is dropped as well, unless it's on screen
+  if (orphans->graph) {
+    if (!pkgdb_reload(state))
+      return false;
+    dep_graph_cleanup(orphans->graph);
+    orphans->graph = NULL;
+  }
+
+  orphans->graph = dep_graph_build(&state->xhp, LOCAL);
+  if (!orphans->graph)
+    return false;
+
+  uint32_t *ids = malloc(
+      ((size_t)orphans->graph->nodes->count + 1) * sizeof(uint32_t));
+  if (!ids) {
+    dep_graph_cleanup(orphans->graph);
+    orphans->graph = NULL;
+    return false;
+  }
+
+  free(orphans->ids);
+  orphans->ids = ids;
+  orphans->count = dep_graph_orphans(orphans->graph, ids, &orphans->freed);
+  orphans->pkgdb_mtime = mtime;
+  orphans_map(state);
+
+  perf_span("orphans_find", start);
+  state->dirty |= DIRTY_INFO;
+  return true;
+}
+
+bool orphans_toggle(model_t *state) {
+  if (!state || state->owners.active)
+    return false;
+
+  orphans_view_t *orphans = &state->orphans;
+  if (!orphans->active) {
+    orphans_find(state);
+    if (!orphans->graph)
+      return false;
+  }
+
+  orphans->active = !orphans->active;
+  state->upgrades.active = false;
+  state->selected_idx = 0;
+  state->visible_start = 0;
+  state->dirty |= DIRTY_ALL;
+
+  // Result of the worker is restricted to orphans once it arrives
+  filter_elements(state);
+  return true;
+}
+
+bool orphans_poll(model_t *state) {
+  if (!state || !state->orphans.active || !orphans_find(state))
+    return false;
+
+  filter_elements(state);
+  return true;
+}
+
+/* ============= Upgrades ============= */
+
+bool upgrades_toggle(model_t *state) {
+  if (!state || state->owners.active)
+    return false;
+
+  upgrades_view_t *upgrades = &state->upgrades;
+  if (!upgrades->active && !upgrades->members && !upgrades_find(state))
+    return false;
+
+  upgrades->active = !upgrades->active;
+  state->orphans.active = false;
+  state->selected_idx = 0;
+  state->visible_start = 0;
+  state->dirty |= DIRTY_ALL;
+
+  // Result of the worker is restricted to upgrades once it arrives
+  filter_elements(state);
+  return true;
+}
+
+/* ============= Batch transaction ============= */
+
+TRANSACTION_ACTION batch_action(const model_t *state, uint32_t idx) {
+  const search_result_t *packages = state->packages;
+  if (packages->repo_type == LOCAL || search_result_installed(packages, idx))
+    return TRANSACTION_REMOVE;
+
+  return TRANSACTION_INSTALL;
+}
+
+bool batch_mark(model_t *state) {
+  if (!state || state->owners.active ||
+      state->selected_idx >= state->filtered_count)
+    return false;
+
+  batch_view_t *batch = &state->batch;
+  uint32_t idx = (uint32_t)state->filtered_indices[state->selected_idx];
+
+  // Catalog may have grown since the bitmap was allocated
+  if (idx / 64 >= batch->marked_words) {
+    uint32_t words = (state->packages->count + 63) / 64 + 1;
+    uint64_t *marked = realloc(batch->marked, words * sizeof(uint64_t));
+    if (!marked)
+      return false;
+
+    memset(marked + batch->marked_words, 0,
+           (words - batch->marked_words) * sizeof(uint64_t));
+    batch->marked = marked;
+    batch->marked_words = words;
+  }
+
+  uint64_t bit = 1ull << (idx % 64);
+  batch->marked[idx / 64] ^= bit;
+  if (batch->marked[idx / 64] & bit)
+    batch->marked_count++;
+  else
+    batch->marked_count--;
+
+  // Holding the key marks a run of packages
+  if (state->selected_idx + 1 < state->filtered_count) {
+    state->selected_idx++;
+    if (state->selected_idx >= state->visible_start + page_size(state))
+      state->visible_start++;
+  }
+
+  state->dirty |= DIRTY_LIST | DIRTY_INFO;
+  return true;
+}
+
+// Free transaction and the marks it was started with
+static void batch_drop(model_t *state) {
+  batch_view_t *batch = &state->batch;
+  transaction_stop(batch->transaction);
+  batch->transaction = NULL;
+  batch->canceled = false;
+
+  free(batch->submitted);
+  batch->submitted = NULL;
+  batch->submitted_words = 0;
+  state->dirty |= DIRTY_INFO;
+}
+
+bool batch_submit(model_t *state) {
+  if (!state)
+    return false;
+
+  batch_view_t *batch = &state->batch;
+  if (batch->marked_count == 0 || batch->transaction)
+    return false;
+
+  uint32_t count = 0;
+  const char **pkgnames = malloc(batch->marked_count * sizeof(char *));
+  char(*names)[XBPS_NAME_SIZE] = malloc(batch->marked_count * sizeof(*names));
+  TRANSACTION_ACTION *actions =
+      malloc(batch->marked_count * sizeof(TRANSACTION_ACTION));
+  if (!pkgnames || !names || !actions)
+    goto out;
+
+  for (uint32_t word = 0; word < batch->marked_words; word++) {
+    for (uint64_t bits = batch->marked[word]; bits; bits &= bits - 1) {
+      uint32_t idx = word * 64 + (uint32_t)__builtin_ctzll(bits);
+      if (idx >= state->packages->count || count == batch->marked_count)
+        continue;
+
+      const char *pkgver = search_result_pkgver(state->packages, idx);
+      if (!xbps_pkg_name(names[count], XBPS_NAME_SIZE, pkgver))
+        snprintf(names[count], XBPS_NAME_SIZE, "%s", pkgver);
+
+      pkgnames[count] = names[count];
+      actions[count] = batch_action(state, idx);
+      count++;
+    }
+  }
+
+  // Marks added while it runs stay once it's done
+  batch->submitted = malloc(batch->marked_words * sizeof(uint64_t));
+  if (!batch->submitted)
+    goto out;
+  memcpy(batch->submitted, batch->marked,
+         batch->marked_words * sizeof(uint64_t));
+  batch->submitted_words = batch->marked_words;
+
+  batch->transaction =
+      transaction_start(&state->config, pkgnames, actions, count);
+  if (!batch->transaction)
+    batch_drop(state);
+  batch->status = (transaction_status_t){.phase = TRANSACTION_RESOLVING};
+  batch->seen = 0;
+  state->dirty |= DIRTY_INFO;
+
+out:
+  free(pkgnames);
+  free(names);
+  free(actions);
+  return batch->transaction != NULL;
+}
+
+void batch_answer(model_t *state, bool confirm) {
+  if (!state || !state->batch.transaction)
+    return;
+
+  batch_view_t *batch = &state->batch;
+  switch (batch->status.phase) {
+  case TRANSACTION_RESOLVING:
+    // Resolving can't be interrupted, thread is reaped once it's over.
+    // Confirmation comes too early
+    if (!confirm && !batch->canceled) {
+      transaction_cancel(batch->transaction);
+      batch->canceled = true;
+      state->dirty |= DIRTY_INFO;
+    }
+    return;
+  case TRANSACTION_READY:
+    // Shown as running right away, so that no key can cancel it anymore
+    if (confirm && transaction_confirm(batch->transaction)) {
+      batch->status.phase = TRANSACTION_RUNNING;
+      state->dirty |= DIRTY_INFO;
+      return;
+    }
+    break;
+  case TRANSACTION_RUNNING:
+    return;
+  default:
+    break;
+  }
+
+  batch_drop(state);
+}
+
+bool batch_poll(model_t *state) {
+  if (!state || !state->batch.transaction)
+    return false;
+
+  batch_view_t *batch = &state->batch;
+  if (!transaction_status(batch->transaction, &batch->status, &batch->seen))
+    return false;
+
+  state->dirty |= DIRTY_INFO;
+
+  // Thread of a canceled transaction quits right after resolving
+  if (batch->canceled && batch->status.phase != TRANSACTION_RESOLVING) {
+    batch_drop(state);
+    return true;
+  }
+
+  if (batch->status.phase != TRANSACTION_DONE)
+    return true;
+
+  // Marks of the transaction are done with, newer ones stay. Handle of the
+  // UI reads the new pkgdb, orphans notice it by its modification time
+  uint32_t words = batch->marked_words < batch->submitted_words
+                       ? batch->marked_words
+                       : batch->submitted_words;
+  for (uint32_t word = 0; word < words; word++) {
+    uint64_t done = batch->marked[word] & batch->submitted[word];
+    batch->marked[word] &= ~done;
+    batch->marked_count -= (uint32_t)__builtin_popcountll(done);
+  }
+  free(batch->submitted);
+  batch->submitted = NULL;
+  batch->submitted_words = 0;
+  pkgdb_reload(state);
+  if (!state->watch)
+    pkgdb_loaders_refresh(state);
+  state->dirty |= DIRTY_LIST;
+
+  return true;
+}
+
+/* ============= Owner lookup ============= */
+
+bool owner_toggle(model_t *state) {
+  if (!state)
+    return false;
+
+  owner_search_t *owners = &state->owners;
+
+  // Loading again after a failed attempt is fine, it's user's request
+  if (!owners->active && !owners->index && !owners->loader) {
+    owners->loader = owner_loader_start(&state->config);
+    if (!owners->loader)
+      return false;
+  }
+
+  owners->active = !owners->active;
+  state->selected_idx = 0;
+  state->visible_start = 0;
+  state->dirty |= DIRTY_ALL;
+
+  if (owners->active)
+    owner_lookup(state);
+  else
+    filter_elements(state);
+
+  return true;
+}
+
+// New matches are shown from the top
+static void owner_show(model_t *state) {
+  state->selected_idx = 0;
+  state->visible_start = 0;
+  state->dirty |= DIRTY_LIST | DIRTY_INFO;
+}
+
+void owner_lookup(model_t *state) {
+  owner_search_t *owners = &state->owners;
+
+  // Nothing to look up yet, `owner_poll` repeats the lookup
+  if (!owners->index)
+    return;
+
+  // Lookup thread failed to start, the lookup runs here
+  if (!owners->worker) {
+    uint64_t start = perf_now();
+    owner_matches_cleanup(&owners->matches);
+    owners->matches = owner_index_lookup(owners->index, state->input_buffer);
+    state->stats.filter_ns = perf_span("owner_lookup", start);
+    owner_show(state);
+    return;
+  }
+
+  owners->generation =
+      owner_worker_submit(owners->worker, state->input_buffer);
+  owners->pending = true;
+}
+
+bool owner_poll(model_t *state) {
+  owner_search_t *owners = &state->owners;
+  bool changed = false;
+
+  if (owners->loader && owner_loader_take(owners->loader, &owners->index)) {
+    owner_loader_stop(owners->loader);
+    owners->loader = NULL;
+    if (owners->index)
+      owners->worker = owner_worker_start(owners->index);
+    state->dirty |= DIRTY_LIST | DIRTY_INFO;
+    changed = true;
+
+    if (owners->active)
+      owner_lookup(state);
+  }
+
+  if (!owners->pending)
+    return changed;
+
+  owner_result_t *result = owner_worker_take(owners->worker);
+  if (!result)
+    return changed;
+
+  // Result of a query typed over since is dropped, a newer one is coming
+  if (result->generation != owners->generation) {
+    owner_result_cleanup(result);
+    return changed;
+  }
+
+  owner_matches_cleanup(&owners->matches);
+  owners->matches = result->matches;
+  owners->pending = false;
+  state->stats.filter_ns = result->elapsed_ns;
+
+  result->matches = (owner_matches_t){0};
+  owner_result_cleanup(result);
+  owner_show(state);
+  return true;
+}
+
+void stats_toggle(model_t *state) {
+  if (!state)
+    return;
+
+  state->stats.visible = !state->stats.visible;
+
+  // Planes below are intact, dropping overlay uncovers them
+  if (!state->stats.visible && state->stats_plane) {
+    ncplane_destroy(state->stats_plane);
+    state->stats_plane = NULL;
+  }
+
+  state->dirty |= DIRTY_STATS;
 }
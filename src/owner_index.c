@@ -0,0 +1,574 @@
+#include "owner_index.h"
+#include "catalog_cache.h"
+#include "perf.h"
+
+#include <fcntl.h>
+#include <linux/limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define OWNER_MAGIC "XUIOWNR"
+#define OWNER_CACHE_NAME "owners.bin"
+
+/// On-disk layout: header, sorted owner_entry_t array, paths blob and pkgvers
+/// blob. Header size keeps the entries aligned
+struct owner_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t count;
+  uint64_t fingerprint;
+  uint32_t paths_len;
+  uint32_t pkgvers_len;
+};
+
+// How often the substring scan checks for a newer lookup
+#define CANCEL_CHECK_MASK 1023
+
+static inline bool canceled(const _Atomic bool *cancel) {
+  return cancel && atomic_load_explicit(cancel, memory_order_relaxed);
+}
+
+static inline bool superseded(const _Atomic uint64_t *latest,
+                              uint64_t generation) {
+  return latest &&
+         atomic_load_explicit(latest, memory_order_relaxed) != generation;
+}
+
+/* ============= Build ============= */
+
+static int compare_paths(const void *a, const void *b, void *arg) {
+  const string_arena_t *paths = (const string_arena_t *)arg;
+  return strcmp(string_arena_get(paths, ((const owner_entry_t *)a)->path),
+                string_arena_get(paths, ((const owner_entry_t *)b)->path));
+}
+
+// Make sure `entries` can take `more` entries, growing by doubling
+static bool reserve_entries(owner_index_t *index, uint32_t *cap,
+                            uint32_t more) {
+  if ((uint64_t)index->count + more <= *cap)
+    return true;
+
+  uint64_t new_cap = *cap > 0 ? *cap : 4096;
+  while (new_cap < (uint64_t)index->count + more)
+    new_cap *= 2;
+  if (new_cap >= UINT32_MAX)
+    return false;
+
+  owner_entry_t *entries =
+      realloc(index->entries, new_cap * sizeof(owner_entry_t));
+  if (!entries)
+    return false;
+
+  index->entries = entries;
+  *cap = (uint32_t)new_cap;
+  return true;
+}
+
+// Append every file of package, paths are copied in one block
+static bool add_package(owner_index_t *index, uint32_t *cap,
+                        const package_files_t *files, const char *pkgver) {
+  uint32_t owner = string_arena_push(&index->pkgvers, pkgver);
+  if (owner == NO_STRING || !reserve_entries(index, cap, files->count) ||
+      !string_arena_reserve(&index->paths, files->paths.len))
+    return false;
+
+  uint32_t base = index->paths.len;
+  memcpy(index->paths.data + base, files->paths.data, files->paths.len);
+  index->paths.len += files->paths.len;
+
+  for (uint32_t i = 0; i < files->count; i++) {
+    index->entries[index->count++] = (owner_entry_t){
+        .path = base + files->offsets[i],
+        .owner = owner,
+    };
+  }
+
+  return true;
+}
+
+owner_index_t *owner_index_build(struct xbps_handle *xhp,
+                                 const search_result_t *local,
+                                 const _Atomic bool *cancel) {
+  if (!xhp || !local)
+    return NULL;
+
+  owner_index_t *index = calloc(1, sizeof(owner_index_t));
+  if (!index)
+    return NULL;
+
+  uint32_t cap = 0;
+  for (uint32_t i = 0; i < local->count; i++) {
+    if (canceled(cancel))
+      goto error;
+
+    const char *pkgver = search_result_pkgver(local, i);
+    char pkgname[XBPS_NAME_SIZE];
+    if (!pkgver || !xbps_pkg_name(pkgname, sizeof(pkgname), pkgver))
+      continue;
+
+    // Package without files plist doesn't own anything
+    package_files_t *files = get_package_files(xhp, pkgname, LOCAL);
+    if (!files)
+      continue;
+
+    bool ok = add_package(index, &cap, files, pkgver);
+    package_files_cleanup(files);
+    if (!ok)
+      goto error;
+  }
+
+  qsort_r(index->entries, index->count, sizeof(owner_entry_t), compare_paths,
+          &index->paths);
+
+  return index;
+
+error:
+  owner_index_cleanup(index);
+  return NULL;
+}
+
+/* ============= Cache file ============= */
+
+static bool owner_index_write(const owner_index_t *index,
+                              uint64_t fingerprint) {
+  char path[PATH_MAX], tmp[PATH_MAX];
+  if (!catalog_cache_path(path, sizeof(path), OWNER_CACHE_NAME, true))
+    return false;
+
+  struct owner_header header = {
+      .magic = OWNER_MAGIC,
+      .version = OWNER_INDEX_VERSION,
+      .count = index->count,
+      .fingerprint = fingerprint,
+      .paths_len = index->paths.len,
+      .pkgvers_len = index->pkgvers.len,
+  };
+
+  FILE *file = catalog_cache_create(path, tmp, sizeof(tmp));
+  if (!file)
+    return false;
+
+  bool ok =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(index->entries, sizeof(owner_entry_t), index->count, file) ==
+          index->count &&
+      fwrite(index->paths.data, 1, index->paths.len, file) ==
+          index->paths.len &&
+      fwrite(index->pkgvers.data, 1, index->pkgvers.len, file) ==
+          index->pkgvers.len;
+
+  if (fclose(file) != 0)
+    ok = false;
+
+  // Readers see either the old file or the complete new one
+  if (!ok || rename(tmp, path) != 0) {
+    unlink(tmp);
+    return false;
+  }
+
+  return true;
+}
+
+static owner_index_t *owner_index_map(uint64_t fingerprint) {
+  char path[PATH_MAX];
+  if (!catalog_cache_path(path, sizeof(path), OWNER_CACHE_NAME, false))
+    return NULL;
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      (size_t)st.st_size < sizeof(struct owner_header)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t size = (size_t)st.st_size;
+  char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  const struct owner_header *header = (const struct owner_header *)map;
+  uint64_t entries_size = (uint64_t)header->count * sizeof(owner_entry_t);
+  bool valid =
+      memcmp(header->magic, OWNER_MAGIC, sizeof(header->magic)) == 0 &&
+      header->version == OWNER_INDEX_VERSION &&
+      header->fingerprint == fingerprint &&
+      sizeof(*header) + entries_size + header->paths_len +
+              header->pkgvers_len ==
+          size;
+
+  const owner_entry_t *entries =
+      (const owner_entry_t *)(map + sizeof(*header));
+  const char *paths = (const char *)entries + entries_size;
+  const char *pkgvers = paths + header->paths_len;
+
+  // Every string has to be terminated and every offset in bounds, so a
+  // corrupted file can't send lookups out of the mapping
+  valid = valid && (header->paths_len == 0 ||
+                    paths[header->paths_len - 1] == '\0');
+  valid = valid && (header->pkgvers_len == 0 ||
+                    pkgvers[header->pkgvers_len - 1] == '\0');
+  for (uint32_t i = 0; valid && i < header->count; i++) {
+    valid = entries[i].path < header->paths_len &&
+            entries[i].owner < header->pkgvers_len;
+  }
+
+  owner_index_t *index = valid ? calloc(1, sizeof(owner_index_t)) : NULL;
+  if (!index) {
+    munmap(map, size);
+    return NULL;
+  }
+
+  index->entries = (owner_entry_t *)entries;
+  index->count = header->count;
+  index->paths = (string_arena_t){(char *)paths, header->paths_len,
+                                  header->paths_len};
+  index->pkgvers = (string_arena_t){(char *)pkgvers, header->pkgvers_len,
+                                    header->pkgvers_len};
+  index->mapping = map;
+  index->mapping_size = size;
+
+  return index;
+}
+
+owner_index_t *owner_index_load(struct xbps_handle *xhp,
+                                const _Atomic bool *cancel) {
+  uint64_t fingerprint = 0;
+  bool cacheable = catalog_fingerprint(xhp, LOCAL, &fingerprint);
+
+  if (cacheable) {
+    owner_index_t *cached = owner_index_map(fingerprint);
+    if (cached)
+      return cached;
+  }
+
+  search_result_t *local = catalog_load(xhp, LOCAL);
+  if (!local)
+    return NULL;
+
+  owner_index_t *index = owner_index_build(xhp, local, cancel);
+  search_result_cleanup(local);
+
+  // Failing to write cache only costs the next lookup
+  if (index && cacheable)
+    owner_index_write(index, fingerprint);
+
+  return index;
+}
+
+/* ============= Lookups ============= */
+
+// First entry whose path compares >= `key` in the first `len` bytes, or the
+// first one that compares > with `after`
+static uint32_t bound(const owner_index_t *index, const char *key, size_t len,
+                      bool after) {
+  uint32_t lo = 0, hi = index->count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    int cmp = strncmp(owner_index_path(index, mid), key, len);
+    if (cmp < 0 || (after && cmp == 0))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Entries that agree with `key` in the first `len` bytes
+static owner_matches_t range(const owner_index_t *index, const char *key,
+                             size_t len) {
+  if (!index || !key)
+    return (owner_matches_t){0};
+
+  uint32_t begin = bound(index, key, len, false);
+  uint32_t end = bound(index, key, len, true);
+  return (owner_matches_t){.begin = begin, .count = end - begin};
+}
+
+owner_matches_t owner_index_exact(const owner_index_t *index,
+                                  const char *path) {
+  // Terminating NUL takes part in the comparison
+  return range(index, path, path ? strlen(path) + 1 : 0);
+}
+
+owner_matches_t owner_index_prefix(const owner_index_t *index,
+                                   const char *prefix) {
+  return range(index, prefix, prefix ? strlen(prefix) : 0);
+}
+
+// Entries whose path contains `needle`. Scan stops early, returning false, as
+// soon as `*latest` differs from `generation`
+static bool substring(const owner_index_t *index, const char *needle,
+                      const _Atomic uint64_t *latest, uint64_t generation,
+                      owner_matches_t *out) {
+  owner_matches_t matches = {0};
+  if (!index || !needle) {
+    *out = matches;
+    return true;
+  }
+
+  uint32_t cap = 0;
+  for (uint32_t i = 0; i < index->count; i++) {
+    if ((i & CANCEL_CHECK_MASK) == 0 && superseded(latest, generation)) {
+      owner_matches_cleanup(&matches);
+      return false;
+    }
+    if (!strstr(owner_index_path(index, i), needle))
+      continue;
+
+    if (matches.count == cap) {
+      cap = cap > 0 ? cap * 2 : 256;
+      uint32_t *entries = realloc(matches.entries, cap * sizeof(uint32_t));
+      if (!entries) {
+        owner_matches_cleanup(&matches);
+        break;
+      }
+      matches.entries = entries;
+    }
+    matches.entries[matches.count++] = i;
+  }
+
+  *out = matches;
+  return true;
+}
+
+owner_matches_t owner_index_substring(const owner_index_t *index,
+                                      const char *needle) {
+  owner_matches_t matches;
+  substring(index, needle, NULL, 0, &matches);
+  return matches;
+}
+
+static bool lookup(const owner_index_t *index, const char *query,
+                   const _Atomic uint64_t *latest, uint64_t generation,
+                   owner_matches_t *out) {
+  if (!index || !query) {
+    *out = (owner_matches_t){0};
+    return true;
+  }
+
+  if (query[0] == '=') {
+    *out = owner_index_exact(index, query + 1);
+    return true;
+  }
+  if (query[0] == '/' || query[0] == '\0') {
+    *out = owner_index_prefix(index, query);
+    return true;
+  }
+
+  return substring(index, query, latest, generation, out);
+}
+
+owner_matches_t owner_index_lookup(const owner_index_t *index,
+                                   const char *query) {
+  owner_matches_t matches;
+  lookup(index, query, NULL, 0, &matches);
+  return matches;
+}
+
+/* ============= Loader thread ============= */
+
+static void *loader_main(void *arg) {
+  owner_loader_t *loader = (owner_loader_t *)arg;
+
+  if (search_handle_init(&loader->xhp, &loader->config)) {
+    loader->index = owner_index_load(&loader->xhp, &loader->stop);
+    xbps_end(&loader->xhp);
+  }
+
+  atomic_store(&loader->finished, true);
+  return NULL;
+}
+
+owner_loader_t *owner_loader_start(const search_config_t *config) {
+  owner_loader_t *loader = calloc(1, sizeof(owner_loader_t));
+  if (!loader)
+    return NULL;
+
+  if (config)
+    loader->config = *config;
+
+  atomic_init(&loader->stop, false);
+  atomic_init(&loader->finished, false);
+
+  if (pthread_create(&loader->thread, NULL, loader_main, loader) != 0) {
+    free(loader);
+    return NULL;
+  }
+
+  return loader;
+}
+
+bool owner_loader_take(owner_loader_t *loader, owner_index_t **index) {
+  if (!atomic_load(&loader->finished))
+    return false;
+
+  *index = loader->index;
+  loader->index = NULL;
+  return true;
+}
+
+void owner_loader_stop(owner_loader_t *loader) {
+  if (!loader)
+    return;
+
+  atomic_store(&loader->stop, true);
+  pthread_join(loader->thread, NULL);
+
+  owner_index_cleanup(loader->index);
+  free(loader);
+}
+
+/* ============= Lookup thread ============= */
+
+static void *worker_main(void *arg) {
+  owner_worker_t *worker = (owner_worker_t *)arg;
+  char query[OWNER_QUERY_MAX];
+
+  pthread_mutex_lock(&worker->lock);
+  while (!worker->stop) {
+    uint64_t generation = atomic_load(&worker->latest);
+    if (worker->finished == generation) {
+      pthread_cond_wait(&worker->wake, &worker->lock);
+      continue;
+    }
+
+    // Take a copy of the request, so the UI can submit a new one meanwhile
+    memcpy(query, worker->query, sizeof(query));
+    pthread_mutex_unlock(&worker->lock);
+
+    uint64_t start = perf_now();
+    owner_matches_t matches;
+    if (lookup(worker->index, query, &worker->latest, generation, &matches)) {
+      owner_result_t *result = malloc(sizeof(owner_result_t));
+      if (result) {
+        *result = (owner_result_t){
+            .matches = matches,
+            .generation = generation,
+            .elapsed_ns = perf_span("owner_lookup", start),
+        };
+        // Unclaimed older result is never going to be displayed
+        owner_result_cleanup(atomic_exchange(&worker->published, result));
+      } else {
+        owner_matches_cleanup(&matches);
+      }
+    } else {
+      // Superseded by a newer query
+      perf_span("owner_lookup/cancelled", start);
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    worker->finished = generation;
+  }
+  pthread_mutex_unlock(&worker->lock);
+
+  return NULL;
+}
+
+owner_worker_t *owner_worker_start(const owner_index_t *index) {
+  owner_worker_t *worker = calloc(1, sizeof(owner_worker_t));
+  if (!worker)
+    return NULL;
+
+  worker->index = index;
+  atomic_init(&worker->latest, 0);
+  atomic_init(&worker->published, NULL);
+
+  pthread_mutex_init(&worker->lock, NULL);
+  pthread_cond_init(&worker->wake, NULL);
+
+  if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->lock);
+    free(worker);
+    return NULL;
+  }
+
+  return worker;
+}
+
+uint64_t owner_worker_submit(owner_worker_t *worker, const char *query) {
+  pthread_mutex_lock(&worker->lock);
+
+  strncpy(worker->query, query, sizeof(worker->query) - 1);
+  worker->query[sizeof(worker->query) - 1] = '\0';
+
+  // Bumping generation also cancels the scan in flight
+  uint64_t generation = atomic_fetch_add(&worker->latest, 1) + 1;
+
+  pthread_cond_signal(&worker->wake);
+  pthread_mutex_unlock(&worker->lock);
+
+  return generation;
+}
+
+owner_result_t *owner_worker_take(owner_worker_t *worker) {
+  return atomic_exchange(&worker->published, NULL);
+}
+
+void owner_worker_stop(owner_worker_t *worker) {
+  if (!worker)
+    return;
+
+  pthread_mutex_lock(&worker->lock);
+  worker->stop = true;
+  // Cancel the scan in flight
+  atomic_fetch_add(&worker->latest, 1);
+  pthread_cond_signal(&worker->wake);
+  pthread_mutex_unlock(&worker->lock);
+
+  pthread_join(worker->thread, NULL);
+
+  owner_result_cleanup(atomic_exchange(&worker->published, NULL));
+  pthread_cond_destroy(&worker->wake);
+  pthread_mutex_destroy(&worker->lock);
+  free(worker);
+}
+
+/* ============= Cleanup functions ============= */
+
+void owner_index_cleanup(owner_index_t *index) {
+  if (!index)
+    return;
+
+  // Arrays point into the mapping
+  if (index->mapping) {
+    munmap(index->mapping, index->mapping_size);
+    free(index);
+    return;
+  }
+
+  if (index->entries)
+    free(index->entries);
+
+  string_arena_cleanup(&index->paths);
+  string_arena_cleanup(&index->pkgvers);
+
+  free(index);
+}
+
+void owner_matches_cleanup(owner_matches_t *matches) {
+  if (!matches)
+    return;
+
+  if (matches->entries)
+    free(matches->entries);
+
+  *matches = (owner_matches_t){0};
+}
+
+void owner_result_cleanup(owner_result_t *result) {
+  if (!result)
+    return;
+
+  owner_matches_cleanup(&result->matches);
+  free(result);
+}
@@ -0,0 +1,86 @@
+#include "perf.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+// Trace of the session, events are appended to one JSON array
+static struct {
+  FILE *file; // NULL when tracing is off
+  pthread_mutex_t lock;
+  uint64_t origin; // Timestamps are relative to the start of the trace
+  bool first;      // No event was written yet
+
+} trace = {.lock = PTHREAD_MUTEX_INITIALIZER};
+
+uint64_t perf_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+bool perf_trace_open(const char *path) {
+  if (!path || trace.file)
+    return false;
+
+  trace.file = fopen(path, "w");
+  if (!trace.file)
+    return false;
+
+  trace.origin = perf_now();
+  trace.first = true;
+  fputs("[", trace.file);
+
+  return true;
+}
+
+void perf_trace_close(void) {
+  if (!trace.file)
+    return;
+
+  fputs("\n]\n", trace.file);
+  fclose(trace.file);
+  trace.file = NULL;
+}
+
+// Separator before the next event, caller holds the lock
+static void next_event(void) {
+  fputs(trace.first ? "\n" : ",\n", trace.file);
+  trace.first = false;
+}
+
+uint64_t perf_span(const char *name, uint64_t start) {
+  uint64_t end = perf_now();
+  if (!trace.file)
+    return end - start;
+
+  // Chrome trace timestamps are in microseconds, fractions are allowed
+  pthread_mutex_lock(&trace.lock);
+  next_event();
+  fprintf(trace.file,
+          "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+          "\"ts\":%" PRIu64 ".%03u,\"dur\":%" PRIu64 ".%03u}",
+          name, (int)getpid(), (int)gettid(), (start - trace.origin) / 1000,
+          (unsigned)((start - trace.origin) % 1000), (end - start) / 1000,
+          (unsigned)((end - start) % 1000));
+  pthread_mutex_unlock(&trace.lock);
+
+  return end - start;
+}
+
+void perf_counter(const char *name, uint64_t value) {
+  if (!trace.file)
+    return;
+
+  uint64_t now = perf_now() - trace.origin;
+
+  pthread_mutex_lock(&trace.lock);
+  next_event();
+  fprintf(trace.file,
+          "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":%d,\"ts\":%" PRIu64
+          ".%03u,\"args\":{\"value\":%" PRIu64 "}}",
+          name, (int)getpid(), now / 1000, (unsigned)(now % 1000), value);
+  pthread_mutex_unlock(&trace.lock);
+}
@@ -1,12 +1,16 @@
 #include "pkg_search.h"
+#include "perf.h"
 #include "utils.h"
 
 #include <linux/limits.h>
+#include <pthread.h>
 #include <regex.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <time.h>
 
 /* ============= Context for callback's  ============= */
 
@@ -17,8 +21,62 @@ struct search_context {
   search_result_t *results;
 };
 
+/* ============= Catalog ============= */
+
+// Catalog grows by doubling
+package_entry_t *search_result_append(search_result_t *results,
+                                      const char *pkgver,
+                                      const char *short_desc) {
+  // Mapped catalog is read-only
+  if (results->mapping)
+    return NULL;
+
+  if (results->count == results->cap) {
+    uint32_t cap = results->cap > 0 ? results->cap * 2 : 256;
+    package_entry_t *packages =
+        realloc(results->packages, cap * sizeof(package_entry_t));
+    if (!packages)
+      return NULL;
+
+    results->packages = packages;
+    results->cap = cap;
+  }
+
+  package_entry_t *pkg = &results->packages[results->count];
+  *pkg = (package_entry_t){.repository = NO_STRING, .installed = NO_STRING};
+
+  // Copy info
+  pkg->pkgver = string_arena_push(&results->pkgvers, pkgver);
+  pkg->short_desc = string_arena_push(&results->short_descs, short_desc);
+  if (pkg->pkgver == NO_STRING || pkg->short_desc == NO_STRING)
+    return NULL;
+
+  // Name and version are split once, lookups by name only compare lengths
+  size_t name_len = pkgver_name_len(pkgver);
+  pkg->name_len = (uint16_t)(name_len < UINT16_MAX ? name_len : UINT16_MAX);
+
+  results->count++;
+
+  return pkg;
+}
+
 /* ============= Local search (pkgdb) ============= */
 
+// "install-date" is written by libxbps as "%F %R %Z" in local time
+static int64_t install_date(xbps_dictionary_t pkg_dict) {
+  const char *date = NULL;
+  if (!xbps_dictionary_get_cstring_nocopy(pkg_dict, "install-date", &date))
+    return 0;
+
+  struct tm tm = {0};
+  if (!strptime(date, "%Y-%m-%d %H:%M", &tm))
+    return 0;
+
+  tm.tm_isdst = -1;
+  time_t seconds = mktime(&tm);
+  return seconds > 0 ? (int64_t)seconds : 0;
+}
+
 static int local_search_callback(struct xbps_handle *xhp,
                                  xbps_object_t pkg_dict, const char *key,
                                  void *arg, bool *loop_done) {
@@ -53,43 +111,14 @@ static int local_search_callback(struct xbps_handle *xhp,
   if (!match)
     return 0;
 
-  ctx->results->packages =
-      realloc(ctx->results->packages,
-              (ctx->results->count + 1) * sizeof(package_info_t));
-  if (!ctx->results->packages)
+  package_entry_t *pkg = search_result_append(ctx->results, pkgver, short_desc);
+  if (!pkg)
     return 0;
 
-  package_info_t *pkg = &ctx->results->packages[ctx->results->count];
-  memset(pkg, 0, sizeof(package_info_t));
-
-  // Copy info
-  pkg->pkgver = strdup(pkgver);
-  pkg->short_desc = strdup(short_desc);
-
-  const char *long_desc = NULL;
-  xbps_dictionary_get_cstring_nocopy(pkg_dict, "long_desc", &long_desc);
-  if (long_desc)
-    pkg->long_desc = strdup(long_desc);
-
-  const char *maintainer = NULL;
-  xbps_dictionary_get_cstring_nocopy(pkg_dict, "maintainer", &maintainer);
-  if (maintainer)
-    pkg->maintainer = strdup(maintainer);
-
-  const char *homepage = NULL;
-  xbps_dictionary_get_cstring_nocopy(pkg_dict, "homepage", &homepage);
-  if (homepage)
-    pkg->homepage = strdup(homepage);
-
-  const char *license = NULL;
-  xbps_dictionary_get_cstring_nocopy(pkg_dict, "license", &license);
-  if (license)
-    pkg->license = strdup(license);
-
   // Get pkg state
   xbps_pkg_state_dictionary(pkg_dict, &pkg->state);
-
-  ctx->results->count++;
+  xbps_dictionary_get_uint64(pkg_dict, "installed_size", &pkg->installed_size);
+  pkg->install_date = install_date(pkg_dict);
 
   return 0;
 }
@@ -98,7 +127,10 @@ static int local_search_callback(struct xbps_handle *xhp,
 
 struct remote_search_context {
   struct search_context base;
-  const char *repo_uri;
+  uint32_t repo_uri; // offset of current repo's uri in `details`
+
+  search_progress_cb progress; // may be NULL
+  void *progress_arg;
 };
 
 static int remote_search_callback(struct xbps_handle *xhp,
@@ -125,56 +157,45 @@ static int remote_search_callback(struct xbps_handle *xhp,
         regexec(&ctx->base.regexp, short_desc, 0, 0, 0) == 0)
       match = true;
   } else {
-    if (strcasestr(pkgver, ctx->base.pattern) != NULL ||
-        strcasestr(short_desc, ctx->base.pattern) != NULL)
+    // Case-insensitive substring search
+    if (strcasestr_portable(pkgver, ctx->base.pattern) ||
+        strcasestr_portable(short_desc, ctx->base.pattern))
       match = true;
   }
 
   if (!match)
     return 0;
 
-  ctx->base.results->packages =
-      realloc(ctx->base.results->packages,
-              (ctx->base.results->count + 1) * sizeof(package_info_t));
-  if (!ctx->base.results->packages)
+  package_entry_t *pkg =
+      search_result_append(ctx->base.results, pkgver, short_desc);
+  if (!pkg)
     return 0;
 
-  package_info_t *pkg = &ctx->base.results->packages[ctx->base.results->count];
-  memset(pkg, 0, sizeof(package_info_t));
-
-  pkg->pkgver = strdup(pkgver);
-  pkg->short_desc = strdup(short_desc);
-  pkg->repository = strdup(ctx->repo_uri);
-
-  // Copy info
-  const char *long_desc = NULL;
-  xbps_dictionary_get_cstring_nocopy(pkg_dict, "long_desc", &long_desc);
-  if (long_desc)
-    pkg->long_desc = strdup(long_desc);
-
-  const char *maintainer = NULL;
-  xbps_dictionary_get_cstring_nocopy(pkg_dict, "maintainer", &maintainer);
-  if (maintainer)
-    pkg->maintainer = strdup(maintainer);
-
-  const char *homepage = NULL;
-  xbps_dictionary_get_cstring_nocopy(pkg_dict, "homepage", &homepage);
-  if (homepage)
-    pkg->homepage = strdup(homepage);
+  pkg->repository = ctx->repo_uri;
+  xbps_dictionary_get_uint64(pkg_dict, "installed_size", &pkg->installed_size);
 
-  const char *license = NULL;
-  xbps_dictionary_get_cstring_nocopy(pkg_dict, "license", &license);
-  if (license)
-    pkg->license = strdup(license);
+  return 0;
+}
 
-  ctx->base.results->count++;
+// Regex, if any, is compiled on success and has to be freed
+static bool remote_context_init(struct remote_search_context *ctx,
+                                const char *pattern, bool use_regex,
+                                search_result_t *results) {
+  *ctx = (struct remote_search_context){
+      .base = {.pattern = pattern, .use_regex = use_regex, .results = results},
+      .repo_uri = NO_STRING,
+  };
+
+  if (use_regex && regcomp(&ctx->base.regexp, pattern,
+                           REG_EXTENDED | REG_NOSUB | REG_ICASE) != 0) {
+    fprintf(stderr, "Failed to compile regex: %s\n", pattern);
+    return false;
+  }
 
-  return 0;
+  return true;
 }
 
 static int remote_repo_callback(struct xbps_repo *repo, void *arg, bool *done) {
-  (void)done;
-
   struct remote_search_context *ctx = (struct remote_search_context *)arg;
   xbps_array_t keys;
 
@@ -183,41 +204,94 @@ static int remote_repo_callback(struct xbps_repo *repo, void *arg, bool *done) {
   if (!keys)
     return 0;
 
-  ctx->repo_uri = repo->uri;
+  // Every package of repo shares one copy of its uri
+  ctx->repo_uri = string_arena_push(&ctx->base.results->details, repo->uri);
 
   xbps_array_foreach_cb(repo->xhp, keys, repo->idx, remote_search_callback,
                         ctx);
 
   xbps_object_release(keys);
 
+  if (ctx->progress && !ctx->progress(ctx->base.results, ctx->progress_arg))
+    *done = true;
+
   return 0;
 }
 
 /* ============= Search package ============= */
 
+// Held by the thread that reads or writes pkgdb through libxbps
+static pthread_mutex_t pkgdb_lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool search_handle_init(struct xbps_handle *xhp,
+                        const search_config_t *config) {
+  if (!xhp)
+    return false;
+
+  memset(xhp, 0, sizeof(struct xbps_handle));
+
+  if (config && config->rootdir)
+    snprintf(xhp->rootdir, sizeof(xhp->rootdir), "%s", config->rootdir);
+  if (config && config->confdir)
+    snprintf(xhp->confdir, sizeof(xhp->confdir), "%s", config->confdir);
+
+  // Like --repository of xbps-query, stored before the configured ones
+  for (size_t i = 0; config && i < config->repositories_count; i++)
+    xbps_repo_store(xhp, config->repositories[i]);
+
+  if (xbps_init(xhp) != 0)
+    return false;
+
+  // Read now rather than lazily by whichever libxbps call needs it first.
+  // pkgdb that doesn't exist yet is fine, e.g. in a fresh rootdir
+  search_pkgdb_acquire();
+  xbps_pkgdb_init(xhp);
+  search_pkgdb_release();
+
+  return true;
+}
+
+bool search_pkgdb_update(struct xbps_handle *xhp, bool wait) {
+  if (wait)
+    pthread_mutex_lock(&pkgdb_lock);
+  else if (pthread_mutex_trylock(&pkgdb_lock) != 0)
+    return false;
+
+  xbps_pkgdb_update(xhp, false, true);
+  pthread_mutex_unlock(&pkgdb_lock);
+  return true;
+}
+
+void search_pkgdb_acquire(void) {
+  pthread_mutex_lock(&pkgdb_lock);
+}
+
+void search_pkgdb_release(void) {
+  pthread_mutex_unlock(&pkgdb_lock);
+}
+
 search_result_t *search_packages(struct xbps_handle *xhp, const char *pattern,
                                  REPO_TYPE repo_type, bool use_regex) {
+  return search_packages_progress(xhp, pattern, repo_type, use_regex, NULL,
+                                  NULL);
+}
+
+search_result_t *search_packages_progress(struct xbps_handle *xhp,
+                                          const char *pattern,
+                                          REPO_TYPE repo_type, bool use_regex,
+                                          search_progress_cb progress,
+                                          void *arg) {
+  uint64_t start = perf_now();
   struct remote_search_context ctx;
-  search_result_t *results = malloc(sizeof(search_result_t));
+  search_result_t *results = calloc(1, sizeof(search_result_t));
   if (!results)
     return NULL;
 
-  memset(results, 0, sizeof(search_result_t));
-  results->packages = NULL;
-  results->count = 0;
-
-  ctx.base.pattern = pattern;
-  ctx.base.use_regex = use_regex;
-  ctx.base.results = results;
-  ctx.repo_uri = NULL;
-
-  if (use_regex) {
-    if (regcomp(&ctx.base.regexp, pattern,
-                REG_EXTENDED | REG_NOSUB | REG_ICASE) != 0) {
-      fprintf(stderr, "Failed to compile regex: %s\n", pattern);
-      return results;
-    }
-  }
+  results->repo_type = repo_type;
+  if (!remote_context_init(&ctx, pattern, use_regex, results))
+    return results;
+  ctx.progress = progress;
+  ctx.progress_arg = arg;
 
   if (repo_type == REMOTE)
     xbps_rpool_foreach(xhp, remote_repo_callback, &ctx);
@@ -227,9 +301,68 @@ search_result_t *search_packages(struct xbps_handle *xhp, const char *pattern,
   if (use_regex)
     regfree(&ctx.base.regexp);
 
+  perf_span("search_packages", start);
   return results;
 }
 
+bool search_repository(struct xbps_repo *repo, const char *pattern,
+                       bool use_regex, search_result_t *results) {
+  if (!repo || !results)
+    return false;
+
+  struct remote_search_context ctx;
+  if (!remote_context_init(&ctx, pattern, use_regex, results))
+    return false;
+
+  bool done = false;
+  remote_repo_callback(repo, &ctx, &done);
+
+  if (use_regex)
+    regfree(&ctx.base.regexp);
+  return true;
+}
+
+search_result_t *search_result_copy(const search_result_t *result) {
+  if (!result)
+    return NULL;
+
+  search_result_t *copy = calloc(1, sizeof(search_result_t));
+  if (!copy)
+    return NULL;
+
+  copy->repo_type = result->repo_type;
+  copy->packages =
+      malloc((result->count > 0 ? result->count : 1) * sizeof(package_entry_t));
+  if (!copy->packages) {
+    search_result_cleanup(copy);
+    return NULL;
+  }
+  memcpy(copy->packages, result->packages,
+         result->count * sizeof(package_entry_t));
+  copy->count = result->count;
+  copy->cap = result->count > 0 ? result->count : 1;
+
+  if (!string_arena_copy(&copy->pkgvers, &result->pkgvers) ||
+      !string_arena_copy(&copy->short_descs, &result->short_descs) ||
+      !string_arena_copy(&copy->details, &result->details)) {
+    search_result_cleanup(copy);
+    return NULL;
+  }
+
+  return copy;
+}
+
+size_t search_result_memory(const search_result_t *result) {
+  if (!result)
+    return 0;
+
+  if (result->mapping)
+    return result->mapping_size;
+
+  return result->cap * sizeof(package_entry_t) + result->pkgvers.cap +
+         result->short_descs.cap + result->details.cap;
+}
+
 /* ============= Get package metadata ============= */
 
 package_info_t *get_package_info(struct xbps_handle *xhp, const char *pkgname,
@@ -292,6 +425,12 @@ package_info_t *get_package_info(struct xbps_handle *xhp, const char *pkgname,
   if (value)
     pkg->license = strdup(value);
 
+  uint64_t size = 0;
+  char size_str[8]; // xbps_humanize_number needs 7 bytes
+  if (xbps_dictionary_get_uint64(pkg_dict, "installed_size", &size) &&
+      xbps_humanize_number(size_str, (int64_t)size) != -1)
+    pkg->installed_size = strdup(size_str);
+
   if (repo_type == LOCAL)
     xbps_pkg_state_dictionary(pkg_dict, &pkg->state);
 
@@ -300,15 +439,29 @@ package_info_t *get_package_info(struct xbps_handle *xhp, const char *pkgname,
 
 /* ============= Get package files  ============= */
 
+// Append path, growing offsets by doubling
+static bool package_files_push(package_files_t *files, const char *path) {
+  if (files->count == files->cap) {
+    uint32_t cap = files->cap > 0 ? files->cap * 2 : 256;
+    uint32_t *offsets = realloc(files->offsets, cap * sizeof(uint32_t));
+    if (!offsets)
+      return false;
+
+    files->offsets = offsets;
+    files->cap = cap;
+  }
+
+  uint32_t offset = string_arena_push(&files->paths, path);
+  if (offset == NO_STRING)
+    return false;
+
+  files->offsets[files->count++] = offset;
+  return true;
+}
+
 package_files_t *get_package_files(struct xbps_handle *xhp, const char *pkgname,
                                    REPO_TYPE repo_type) {
-  package_files_t *files = (package_files_t *)malloc(sizeof(package_files_t));
-  if (!files)
-    return NULL;
-  memset(files, 0, sizeof(package_files_t));
-
-  xbps_dictionary_t files_dict, file_obj;
-  xbps_array_t files_array;
+  xbps_dictionary_t files_dict;
 
   if (repo_type == REMOTE) {
     xbps_dictionary_t pkg_dict = xbps_rpool_get_pkg(xhp, pkgname);
@@ -328,44 +481,28 @@ package_files_t *get_package_files(struct xbps_handle *xhp, const char *pkgname,
   if (!files_dict)
     return NULL;
 
-  // Ordinary files
-  files_array = xbps_dictionary_get(files_dict, "files");
-  if (files_array) {
-    for (uint32_t i = 0; i < xbps_array_count(files_array); i++) {
-      file_obj = xbps_array_get(files_array, i);
-      const char *filepath = NULL;
-      xbps_dictionary_get_cstring_nocopy(file_obj, "file", &filepath);
-      if (filepath) {
-        files->data = realloc(files->data, (files->count + 1) * sizeof(char *));
-        files->data[files->count++] = strdup(filepath);
-      }
-    }
+  package_files_t *files = calloc(1, sizeof(package_files_t));
+  if (!files) {
+    xbps_object_release(files_dict);
+    return NULL;
   }
 
-  // Config files
-  files_array = xbps_dictionary_get(files_dict, "conf_files");
-  if (files_array) {
-    for (unsigned int i = 0; i < xbps_array_count(files_array); i++) {
-      file_obj = xbps_array_get(files_array, i);
-      const char *filepath = NULL;
-      xbps_dictionary_get_cstring_nocopy(file_obj, "file", &filepath);
-      if (filepath) {
-        files->data = realloc(files->data, (files->count + 1) * sizeof(char *));
-        files->data[files->count++] = strdup(filepath);
-      }
-    }
-  }
+  // Ordinary files, config files and links
+  static const char *const sections[] = {"files", "conf_files", "links"};
+
+  for (size_t s = 0; s < sizeof(sections) / sizeof(sections[0]); s++) {
+    xbps_array_t files_array = xbps_dictionary_get(files_dict, sections[s]);
+    if (!files_array)
+      continue;
 
-  // Links
-  files_array = xbps_dictionary_get(files_dict, "links");
-  if (files_array) {
     for (unsigned int i = 0; i < xbps_array_count(files_array); i++) {
-      file_obj = xbps_array_get(files_array, i);
+      xbps_dictionary_t file_obj = xbps_array_get(files_array, i);
       const char *filepath = NULL;
       xbps_dictionary_get_cstring_nocopy(file_obj, "file", &filepath);
-      if (filepath) {
-        files->data = realloc(files->data, (files->count + 1) * sizeof(char *));
-        files->data[files->count++] = strdup(filepath);
+      if (filepath && !package_files_push(files, filepath)) {
+        package_files_cleanup(files);
+        xbps_object_release(files_dict);
+        return NULL;
       }
     }
   }
@@ -413,44 +550,31 @@ void search_result_cleanup(search_result_t *result) {
   if (!result)
     return;
 
-  for (unsigned int i = 0; i < result->count; i++) {
-    package_info_t *pkg = &result->packages[i];
-    if (pkg->pkgver)
-      free(pkg->pkgver);
-    if (pkg->short_desc)
-      free(pkg->short_desc);
-    if (pkg->long_desc)
-      free(pkg->long_desc);
-    if (pkg->maintainer)
-      free(pkg->maintainer);
-    if (pkg->homepage)
-      free(pkg->homepage);
-    if (pkg->license)
-      free(pkg->license);
-    if (pkg->installed_size)
-      free(pkg->installed_size);
-    if (pkg->repository)
-      free(pkg->repository);
+  // Arrays point into the mapping
+  if (result->mapping) {
+    munmap(result->mapping, result->mapping_size);
+    free(result);
+    return;
   }
 
   if (result->packages)
     free(result->packages);
 
-  if (result)
-    free(result);
+  string_arena_cleanup(&result->pkgvers);
+  string_arena_cleanup(&result->short_descs);
+  string_arena_cleanup(&result->details);
+
+  free(result);
 }
 
-void package_files_cleanup(package_files_t *files, unsigned int count) {
-  if (!files->data)
+void package_files_cleanup(package_files_t *files) {
+  if (!files)
     return;
 
-  for (uint32_t i = 0; i < count; i++) {
-    if (files->data[i])
-      free(files->data[i]);
-  }
-  if (files->data)
-    free(files->data);
+  if (files->offsets)
+    free(files->offsets);
+
+  string_arena_cleanup(&files->paths);
 
-  if (files)
-    free(files);
+  free(files);
 }
@@ -0,0 +1,155 @@
+#include "pkgdb_watch.h"
+#include "catalog_cache.h"
+#include "perf.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+// Read every pending event, true if any of them was about pkgdb
+static bool drain_events(int inotify) {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  bool pkgdb = false;
+
+  ssize_t len;
+  while ((len = read(inotify, buf, sizeof(buf))) > 0) {
+    for (char *ptr = buf; ptr < buf + len;) {
+      const struct inotify_event *event = (const struct inotify_event *)ptr;
+      if (event->len > 0 && strcmp(event->name, XBPS_PKGDB) == 0)
+        pkgdb = true;
+
+      ptr += sizeof(struct inotify_event) + event->len;
+    }
+  }
+
+  return pkgdb;
+}
+
+static void load_pkgdb(pkgdb_watch_t *watch) {
+  uint64_t start = perf_now();
+
+  // Fresh handle reads the new pkgdb. `xbps_pkgdb_update` isn't used, its
+  // state is shared by every handle of the process
+  struct xbps_handle xhp;
+  if (!search_handle_init(&xhp, &watch->config))
+    return;
+
+  search_result_t *local = catalog_load(&xhp, LOCAL);
+  xbps_end(&xhp);
+  if (!local)
+    return;
+
+  // Older catalog is superseded, nobody needs it anymore
+  search_result_t *old = atomic_exchange(&watch->published, local);
+  if (old)
+    search_result_cleanup(old);
+  perf_span("pkgdb_watch_load", start);
+
+  // UI sleeps until there's input or this, the counter is reset by every take
+  uint64_t one = 1;
+  if (write(watch->notify, &one, sizeof(one)) != sizeof(one))
+    return;
+}
+
+static void *watch_main(void *arg) {
+  pkgdb_watch_t *watch = (pkgdb_watch_t *)arg;
+
+  struct pollfd fds[2] = {
+      {.fd = watch->inotify, .events = POLLIN},
+      {.fd = watch->wake, .events = POLLIN},
+  };
+
+  // pkgdb is loaded once it stays untouched for PKGDB_WATCH_SETTLE_MS
+  bool changed = false;
+  while (true) {
+    int rv = poll(fds, 2, changed ? PKGDB_WATCH_SETTLE_MS : -1);
+    if (rv < 0 && errno == EINTR)
+      continue;
+    if (rv < 0 || (fds[1].revents & POLLIN))
+      break;
+
+    if (rv == 0) {
+      changed = false;
+      load_pkgdb(watch);
+    } else if (fds[0].revents & POLLIN) {
+      changed |= drain_events(watch->inotify);
+    }
+  }
+
+  return NULL;
+}
+
+pkgdb_watch_t *pkgdb_watch_start(const search_config_t *config,
+                                 const char *metadir) {
+  if (!metadir)
+    return NULL;
+
+  pkgdb_watch_t *watch = calloc(1, sizeof(pkgdb_watch_t));
+  if (!watch)
+    return NULL;
+
+  if (config)
+    watch->config = *config;
+
+  atomic_init(&watch->published, NULL);
+
+  // xbps writes a temporary file and renames it over pkgdb
+  watch->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  watch->wake = eventfd(0, EFD_CLOEXEC);
+  watch->notify = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (watch->inotify < 0 || watch->wake < 0 || watch->notify < 0 ||
+      inotify_add_watch(watch->inotify, metadir,
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    goto error;
+
+  if (pthread_create(&watch->thread, NULL, watch_main, watch) != 0)
+    goto error;
+
+  return watch;
+
+error:
+  if (watch->inotify >= 0)
+    close(watch->inotify);
+  if (watch->wake >= 0)
+    close(watch->wake);
+  if (watch->notify >= 0)
+    close(watch->notify);
+  free(watch);
+  return NULL;
+}
+
+search_result_t *pkgdb_watch_take(pkgdb_watch_t *watch) {
+  // Counter is reset before taking, a catalog published meanwhile signals it
+  // again. Nonblocking read of a reset counter fails, that's fine
+  uint64_t count;
+  ssize_t drained = read(watch->notify, &count, sizeof(count));
+  (void)drained;
+
+  return atomic_exchange(&watch->published, NULL);
+}
+
+void pkgdb_watch_stop(pkgdb_watch_t *watch) {
+  if (!watch)
+    return;
+
+  // Thread that can't be woken is leaked, it's better than hanging on exit
+  uint64_t one = 1;
+  if (write(watch->wake, &one, sizeof(one)) != sizeof(one))
+    return;
+
+  pthread_join(watch->thread, NULL);
+
+  search_result_t *local = atomic_exchange(&watch->published, NULL);
+  if (local)
+    search_result_cleanup(local);
+
+  close(watch->inotify);
+  close(watch->wake);
+  close(watch->notify);
+  free(watch);
+}
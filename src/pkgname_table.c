@@ -0,0 +1,84 @@
+#include "pkgname_table.h"
+#include "pkg_search.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a, names are short so it's as fast as anything fancier
+static inline uint32_t hash_name(const char *name, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)name[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Slot holding `name`, or the empty slot where it would go
+static pkgname_slot_t *find_slot(const pkgname_table_t *table,
+                                 const char *name, size_t len,
+                                 uint32_t hash) {
+  for (uint32_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+    pkgname_slot_t *slot = &table->slots[i];
+    if (slot->idx == PKGNAME_NOT_FOUND)
+      return slot;
+
+    if (slot->hash != hash)
+      continue;
+
+    // Name lengths are stored, most other names are told apart by them
+    const search_result_t *packages = table->packages;
+    if (packages->packages[slot->idx].name_len == len &&
+        memcmp(search_result_pkgver(packages, slot->idx), name, len) == 0)
+      return slot;
+  }
+}
+
+bool pkgname_table_build(pkgname_table_t *table,
+                         const search_result_t *packages) {
+  if (!table || !packages)
+    return false;
+
+  // Load factor stays at or below 1/2
+  uint32_t size = 16;
+  while (size < packages->count * 2u)
+    size *= 2;
+
+  *table = (pkgname_table_t){.packages = packages, .mask = size - 1};
+  table->slots = malloc(size * sizeof(pkgname_slot_t));
+  if (!table->slots)
+    return false;
+
+  for (uint32_t i = 0; i < size; i++)
+    table->slots[i] = (pkgname_slot_t){.idx = PKGNAME_NOT_FOUND};
+
+  for (uint32_t idx = 0; idx < packages->count; idx++) {
+    const char *pkgver = search_result_pkgver(packages, idx);
+    size_t len = packages->packages[idx].name_len;
+    uint32_t hash = hash_name(pkgver, len);
+
+    pkgname_slot_t *slot = find_slot(table, pkgver, len, hash);
+    if (slot->idx == PKGNAME_NOT_FOUND)
+      *slot = (pkgname_slot_t){.hash = hash, .idx = idx};
+  }
+
+  return true;
+}
+
+uint32_t pkgname_table_find(const pkgname_table_t *table, const char *name,
+                            size_t len) {
+  if (!table || !table->slots || !name)
+    return PKGNAME_NOT_FOUND;
+
+  return find_slot(table, name, len, hash_name(name, len))->idx;
+}
+
+void pkgname_table_cleanup(pkgname_table_t *table) {
+  if (!table)
+    return;
+
+  if (table->slots)
+    free(table->slots);
+
+  *table = (pkgname_table_t){0};
+}
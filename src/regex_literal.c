@@ -0,0 +1,219 @@
+#include "regex_literal.h"
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <string.h>
+
+/// @brief How many times the preceding atom may occur
+typedef enum REPEAT {
+  REPEAT_ONCE = 0,     // No quantifier
+  REPEAT_MANY = 1,     // At least once, but not contiguous with what follows
+  REPEAT_OPTIONAL = 2, // May be absent
+
+} REPEAT;
+
+struct extractor {
+  regex_literals_t *out;
+  size_t used; // Bytes of `out->text` taken
+
+  char run[REGEX_LITERALS_TEXT]; // Literal being collected
+  size_t run_len;
+};
+
+// Keep literal if it's among the longest ones, longest first
+static void add_literal(struct extractor *ex, const char *text, size_t len) {
+  regex_literals_t *out = ex->out;
+  if (len < REGEX_LITERAL_MIN || ex->used + len + 1 > sizeof(out->text))
+    return;
+
+  size_t pos = out->count;
+  while (pos > 0 && out->lengths[pos - 1] < len)
+    pos--;
+  if (pos >= REGEX_LITERALS_MAX)
+    return;
+
+  // Shortest literal makes room
+  if (out->count == REGEX_LITERALS_MAX)
+    out->count--;
+
+  memmove(&out->offsets[pos + 1], &out->offsets[pos],
+          (out->count - pos) * sizeof(out->offsets[0]));
+  memmove(&out->lengths[pos + 1], &out->lengths[pos],
+          (out->count - pos) * sizeof(out->lengths[0]));
+
+  memcpy(out->text + ex->used, text, len);
+  out->text[ex->used + len] = '\0';
+  out->offsets[pos] = (uint16_t)ex->used;
+  out->lengths[pos] = (uint16_t)len;
+  out->count++;
+
+  ex->used += len + 1;
+}
+
+// End literal being collected
+static void flush(struct extractor *ex) {
+  add_literal(ex, ex->run, ex->run_len);
+  ex->run_len = 0;
+}
+
+static void append(struct extractor *ex, char c) {
+  if (ex->run_len < sizeof(ex->run))
+    ex->run[ex->run_len++] = c;
+}
+
+// Index past the bracket expression starting at `i`
+static size_t skip_bracket(const char *p, size_t i) {
+  i++;
+  if (p[i] == '^')
+    i++;
+  if (p[i] == ']') // Leading ']' is a member
+    i++;
+
+  while (p[i] && p[i] != ']') {
+    // Classes like [:alpha:] may contain ']'
+    if (p[i] == '[' && (p[i + 1] == ':' || p[i + 1] == '=' ||
+                        p[i + 1] == '.')) {
+      char delim = p[i + 1];
+      i += 2;
+      while (p[i] && !(p[i] == delim && p[i + 1] == ']'))
+        i++;
+      if (p[i])
+        i += 2;
+    } else {
+      i++;
+    }
+  }
+
+  return p[i] ? i + 1 : i;
+}
+
+// Index past the group starting at `i`
+static size_t skip_group(const char *p, size_t i) {
+  size_t depth = 0;
+  while (p[i]) {
+    if (p[i] == '\\' && p[i + 1]) {
+      i += 2;
+      continue;
+    }
+    if (p[i] == '[') {
+      i = skip_bracket(p, i);
+      continue;
+    }
+
+    if (p[i] == '(')
+      depth++;
+    else if (p[i] == ')' && --depth == 0)
+      return i + 1;
+    i++;
+  }
+
+  return i;
+}
+
+// Consume quantifiers following an atom
+static REPEAT quantifier(const char *p, size_t *i) {
+  REPEAT repeat = REPEAT_ONCE;
+
+  while (true) {
+    char c = p[*i];
+    if (c == '?' || c == '*') {
+      repeat = REPEAT_OPTIONAL;
+      (*i)++;
+    } else if (c == '+') {
+      if (repeat == REPEAT_ONCE)
+        repeat = REPEAT_MANY;
+      (*i)++;
+    } else if (c == '{') {
+      // {,n} is accepted by glibc and means {0,n}
+      size_t j = *i + 1;
+      bool zero = !isdigit((unsigned char)p[j]);
+      while (p[j] == '0')
+        j++;
+      if (!isdigit((unsigned char)p[j]))
+        zero = true;
+
+      if (zero)
+        repeat = REPEAT_OPTIONAL;
+      else if (repeat == REPEAT_ONCE)
+        repeat = REPEAT_MANY;
+
+      while (p[j] && p[j] != '}')
+        j++;
+      *i = p[j] ? j + 1 : j;
+    } else {
+      return repeat;
+    }
+  }
+}
+
+void regex_literals_extract(const char *pattern, regex_literals_t *literals) {
+  if (!literals)
+    return;
+
+  literals->count = 0;
+  if (!pattern)
+    return;
+
+  struct extractor ex = {.out = literals};
+  const char *p = pattern;
+  size_t i = 0;
+
+  while (p[i]) {
+    char c = p[i];
+
+    // Alternatives don't have to share anything
+    if (c == '|') {
+      literals->count = 0;
+      return;
+    }
+
+    // Atoms that aren't literals, whatever quantifies them
+    if (c == '(' || c == '[' || c == '.' || c == '^' || c == '$' ||
+        c == ')' || c == '*' || c == '+' || c == '?' || c == '{') {
+      flush(&ex);
+      if (c == '(')
+        i = skip_group(p, i);
+      else if (c == '[')
+        i = skip_bracket(p, i);
+      else
+        i++;
+      quantifier(p, &i);
+      continue;
+    }
+
+    // \w, \b, backreferences and the like aren't literals. Non-ASCII bytes
+    // are skipped too, they may be part of a multibyte character that the
+    // quantifier applies to, and they aren't folded by the substring matcher
+    unsigned char lit = (unsigned char)c;
+    if (c == '\\') {
+      lit = (unsigned char)p[i + 1];
+      if (!lit) {
+        i++;
+        break;
+      }
+      i++;
+    }
+    i++;
+
+    if (lit >= 0x80 || (c == '\\' && isalnum(lit))) {
+      flush(&ex);
+      quantifier(p, &i);
+      continue;
+    }
+
+    switch (quantifier(p, &i)) {
+    case REPEAT_ONCE:
+      append(&ex, (char)lit);
+      break;
+    case REPEAT_MANY:
+      append(&ex, (char)lit);
+      flush(&ex);
+      break;
+    case REPEAT_OPTIONAL:
+      flush(&ex);
+      break;
+    }
+  }
+
+  flush(&ex);
+}
@@ -0,0 +1,156 @@
+#include "search_worker.h"
+#include "perf.h"
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void *worker_main(void *arg) {
+  search_worker_t *worker = (search_worker_t *)arg;
+  char query[FILTER_QUERY_MAX];
+
+  pthread_mutex_lock(&worker->lock);
+  while (!worker->stop) {
+    uint64_t generation = atomic_load(&worker->latest);
+    if (worker->finished == generation) {
+      pthread_cond_wait(&worker->wake, &worker->lock);
+      continue;
+    }
+
+    // Take a copy of the request, so the UI can submit a new one meanwhile
+    memcpy(query, worker->query, sizeof(query));
+    MATCH_MODE mode = worker->mode;
+    size_t ranked = worker->ranked;
+    worker->busy = true;
+    pthread_mutex_unlock(&worker->lock);
+
+    worker->filter.generation = generation;
+    uint64_t start = perf_now();
+    if (filter_run(&worker->filter, query, mode)) {
+      filter_result_t *result = filter_publish(&worker->filter, ranked);
+      uint64_t elapsed = perf_span("filter_run", start);
+      if (result) {
+        result->elapsed_ns = elapsed;
+        // Unclaimed older result is never going to be displayed
+        filter_result_cleanup(atomic_exchange(&worker->published, result));
+      }
+    } else {
+      // Superseded by a newer query
+      perf_span("filter_run/cancelled", start);
+    }
+
+    pthread_mutex_lock(&worker->lock);
+    worker->finished = generation;
+    worker->busy = false;
+    pthread_cond_broadcast(&worker->done);
+  }
+  pthread_mutex_unlock(&worker->lock);
+
+  return NULL;
+}
+
+search_worker_t *search_worker_start(const search_result_t *packages,
+                                     const trigram_index_t *index) {
+  search_worker_t *worker = calloc(1, sizeof(search_worker_t));
+  if (!worker)
+    return NULL;
+
+  if (!filter_init(&worker->filter, packages, index)) {
+    free(worker);
+    return NULL;
+  }
+  worker->filter.latest = &worker->latest;
+
+  // Filter works serially without the pool
+  worker->filter.pool = thread_pool_create(0);
+
+  atomic_init(&worker->latest, 0);
+  atomic_init(&worker->published, NULL);
+
+  pthread_mutex_init(&worker->lock, NULL);
+  pthread_cond_init(&worker->wake, NULL);
+  pthread_cond_init(&worker->done, NULL);
+
+  if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+    pthread_cond_destroy(&worker->done);
+    pthread_cond_destroy(&worker->wake);
+    pthread_mutex_destroy(&worker->lock);
+    thread_pool_destroy(worker->filter.pool);
+    filter_cleanup(&worker->filter);
+    free(worker);
+    return NULL;
+  }
+
+  return worker;
+}
+
+bool search_worker_set_catalog(search_worker_t *worker,
+                               const search_result_t *packages,
+                               const trigram_index_t *index) {
+  pthread_mutex_lock(&worker->lock);
+
+  // Cancel the pass in flight and wait for the worker to let go of `filter`
+  atomic_fetch_add(&worker->latest, 1);
+  while (worker->busy)
+    pthread_cond_wait(&worker->done, &worker->lock);
+
+  bool ok = filter_set_catalog(&worker->filter, packages, index);
+
+  // Result of the old catalog is never going to be displayed
+  filter_result_cleanup(atomic_exchange(&worker->published, NULL));
+
+  pthread_mutex_unlock(&worker->lock);
+  return ok;
+}
+
+uint64_t search_worker_submit(search_worker_t *worker, const char *query,
+                              MATCH_MODE mode, size_t ranked) {
+  pthread_mutex_lock(&worker->lock);
+
+  strncpy(worker->query, query, sizeof(worker->query) - 1);
+  worker->query[sizeof(worker->query) - 1] = '\0';
+  worker->mode = mode;
+  worker->ranked = ranked;
+
+  // Bumping generation also cancels the pass in flight
+  uint64_t generation = atomic_fetch_add(&worker->latest, 1) + 1;
+
+  pthread_cond_signal(&worker->wake);
+  pthread_mutex_unlock(&worker->lock);
+
+  return generation;
+}
+
+filter_result_t *search_worker_take(search_worker_t *worker) {
+  return atomic_exchange(&worker->published, NULL);
+}
+
+void search_worker_wait(search_worker_t *worker, uint64_t generation) {
+  pthread_mutex_lock(&worker->lock);
+  while (worker->finished < generation && !worker->stop)
+    pthread_cond_wait(&worker->done, &worker->lock);
+  pthread_mutex_unlock(&worker->lock);
+}
+
+void search_worker_stop(search_worker_t *worker) {
+  if (!worker)
+    return;
+
+  pthread_mutex_lock(&worker->lock);
+  worker->stop = true;
+  // Cancel the pass in flight
+  atomic_fetch_add(&worker->latest, 1);
+  pthread_cond_broadcast(&worker->wake);
+  pthread_mutex_unlock(&worker->lock);
+
+  pthread_join(worker->thread, NULL);
+
+  filter_result_cleanup(atomic_exchange(&worker->published, NULL));
+  thread_pool_destroy(worker->filter.pool);
+  filter_cleanup(&worker->filter);
+
+  pthread_cond_destroy(&worker->done);
+  pthread_cond_destroy(&worker->wake);
+  pthread_mutex_destroy(&worker->lock);
+  free(worker);
+}
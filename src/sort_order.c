@@ -0,0 +1,269 @@
+#include "sort_order.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const labels[SORT_ORDERS] = {
+    [SORT_MATCH] = "by match",
+    [SORT_NAME] = "by name",
+    [SORT_VERSION] = "newest first",
+    [SORT_DATE] = "recent first",
+    [SORT_SIZE] = "largest first",
+    [SORT_REPOSITORY] = "by repository",
+};
+
+const char *sort_order_label(SORT_ORDER order) {
+  return order < SORT_ORDERS ? labels[order] : "";
+}
+
+/* ============= Comparison ============= */
+
+struct sort_context {
+  const search_result_t *packages;
+  SORT_ORDER order;
+  uint16_t *name_len; // Name part of every pkgver, packed for locality
+};
+
+static int compare_names(const struct sort_context *ctx, uint32_t x,
+                         uint32_t y) {
+  size_t len_x = ctx->name_len[x], len_y = ctx->name_len[y];
+  int cmp = memcmp(search_result_pkgver(ctx->packages, x),
+                   search_result_pkgver(ctx->packages, y),
+                   len_x < len_y ? len_x : len_y);
+  if (cmp != 0)
+    return cmp;
+
+  return (len_x > len_y) - (len_x < len_y);
+}
+
+static int compare_versions(const struct sort_context *ctx, uint32_t x,
+                            uint32_t y) {
+  const char *ver_x = search_result_pkgver(ctx->packages, x);
+  const char *ver_y = search_result_pkgver(ctx->packages, y);
+  ver_x += ctx->name_len[x];
+  ver_y += ctx->name_len[y];
+
+  // Skip the dash, name without version has an empty one
+  return strverscmp(*ver_x ? ver_x + 1 : ver_x, *ver_y ? ver_y + 1 : ver_y);
+}
+
+// Negative if package `x` goes first
+static int compare_packages(const void *a, const void *b, void *arg) {
+  const struct sort_context *ctx = arg;
+  uint32_t x = (uint32_t)*(const uint64_t *)a;
+  uint32_t y = (uint32_t)*(const uint64_t *)b;
+  const package_entry_t *px = &ctx->packages->packages[x];
+  const package_entry_t *py = &ctx->packages->packages[y];
+
+  int cmp = 0;
+  switch (ctx->order) {
+  case SORT_VERSION:
+    cmp = -compare_versions(ctx, x, y);
+    break;
+  case SORT_DATE:
+    cmp = (px->install_date < py->install_date) -
+          (px->install_date > py->install_date);
+    break;
+  case SORT_SIZE:
+    cmp = (px->installed_size < py->installed_size) -
+          (px->installed_size > py->installed_size);
+    break;
+  case SORT_REPOSITORY:
+    cmp = (px->repository > py->repository) -
+          (px->repository < py->repository);
+    break;
+  default:
+    break;
+  }
+
+  if (cmp == 0)
+    cmp = compare_names(ctx, x, y);
+  if (cmp == 0)
+    cmp = (x > y) - (x < y);
+
+  return cmp;
+}
+
+// Number at the start of version part, capped to 16 bits. Strings that
+// aren't a plain number get the lowest or the highest value, the way
+// strverscmp compares them to numbers
+static uint32_t version_number(const char **version) {
+  const char *str = *version;
+
+  // Leading zeros make it a fraction, below "0"
+  if (str[0] == '0' && str[1] >= '0' && str[1] <= '9')
+    return 0;
+  if (str[0] < '0' || str[0] > '9')
+    return str[0] > '9' ? 0xffff : 0;
+
+  uint32_t number = 0;
+  for (; *str >= '0' && *str <= '9'; str++) {
+    if (number < 0xffff)
+      number = number * 10 + (uint32_t)(*str - '0');
+  }
+
+  *version = str;
+  return number < 0xffff ? number : 0xffff;
+}
+
+// Major and minor of version, e.g. 12 and 1 of "12.1_1"
+static uint32_t version_key(const char *version) {
+  const char *rest = version;
+  uint32_t major = version_number(&rest);
+  if (rest == version)
+    return major << 16 | major;
+
+  // Anything but ".N" after major compares as below or above every minor
+  uint32_t minor = 0;
+  if (rest[0] == '.') {
+    rest++;
+    minor = version_number(&rest);
+  } else if (rest[0] > '.') {
+    minor = 0xffff;
+  }
+
+  return major << 16 | minor;
+}
+
+// Key of package, keys of packages in order never decrease
+static uint32_t sort_key(const struct sort_context *ctx, uint32_t idx) {
+  const package_entry_t *pkg = &ctx->packages->packages[idx];
+  const char *pkgver = search_result_pkgver(ctx->packages, idx);
+
+  switch (ctx->order) {
+  case SORT_VERSION: {
+    const char *version = pkgver + ctx->name_len[idx];
+    return ~version_key(*version ? version + 1 : version);
+  }
+  case SORT_DATE:
+    return pkg->install_date > 0 && pkg->install_date <= UINT32_MAX
+               ? ~(uint32_t)pkg->install_date
+               : UINT32_MAX;
+  case SORT_SIZE: {
+    uint64_t kib = pkg->installed_size >> 10;
+    return ~(uint32_t)(kib < UINT32_MAX ? kib : UINT32_MAX);
+  }
+  case SORT_REPOSITORY:
+    return pkg->repository;
+  default: {
+    // First four bytes of name, big-endian
+    uint32_t key = 0;
+    for (size_t i = 0; i < 4; i++) {
+      unsigned char c = i < ctx->name_len[idx] ? (unsigned char)pkgver[i] : 0;
+      key = (key << 8) | c;
+    }
+    return key;
+  }
+  }
+}
+
+/* ============= Permutation ============= */
+
+// LSD radix sort of (key << 32 | index) pairs by key, like in trigram.c.
+// Passes over a byte that's the same in every key are skipped
+static bool sort_pairs(uint64_t **pairs, uint32_t count) {
+  uint64_t *tmp = malloc(count * sizeof(uint64_t));
+  if (!tmp)
+    return false;
+
+  uint64_t *src = *pairs, *dst = tmp;
+  for (unsigned shift = 32; shift < 64; shift += 8) {
+    size_t counts[257] = {0};
+    for (uint32_t i = 0; i < count; i++)
+      counts[((src[i] >> shift) & 0xff) + 1]++;
+    if (counts[((src[0] >> shift) & 0xff) + 1] == count)
+      continue;
+
+    for (size_t i = 1; i < 257; i++)
+      counts[i] += counts[i - 1];
+    for (uint32_t i = 0; i < count; i++)
+      dst[counts[(src[i] >> shift) & 0xff]++] = src[i];
+
+    uint64_t *swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  *pairs = src;
+  free(dst);
+  return true;
+}
+
+uint32_t *sort_order_build(const search_result_t *packages, SORT_ORDER order,
+                           const uint32_t *by_name) {
+  if (!packages || order == SORT_MATCH || order >= SORT_ORDERS)
+    return NULL;
+
+  uint32_t count = packages->count;
+  uint32_t *permutation = malloc((count > 0 ? count : 1) * sizeof(uint32_t));
+  uint64_t *pairs = malloc((count > 0 ? count : 1) * sizeof(uint64_t));
+  struct sort_context ctx = {
+      .packages = packages,
+      .order = order,
+      .name_len = malloc((count > 0 ? count : 1) * sizeof(uint16_t)),
+  };
+  if (!permutation || !pairs || !ctx.name_len)
+    goto error;
+
+  for (uint32_t i = 0; i < count; i++)
+    ctx.name_len[i] = packages->packages[i].name_len;
+
+  // Radix sort is stable, packages with equal keys stay in order of name
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t idx = by_name ? by_name[i] : i;
+    pairs[i] = ((uint64_t)sort_key(&ctx, idx) << 32) | idx;
+  }
+
+  if (count > 0 && !sort_pairs(&pairs, count))
+    goto error;
+
+  // Only packages with the same key are compared, and only when the key
+  // doesn't hold the whole value
+  bool exact = by_name && (order == SORT_DATE || order == SORT_REPOSITORY);
+  for (uint32_t run = 0, end; run < count && !exact; run = end) {
+    for (end = run + 1;
+         end < count && (pairs[end] >> 32) == (pairs[run] >> 32); end++)
+      ;
+
+    if (end - run > 1)
+      qsort_r(pairs + run, end - run, sizeof(uint64_t), compare_packages,
+              &ctx);
+  }
+
+  for (uint32_t i = 0; i < count; i++)
+    permutation[i] = (uint32_t)pairs[i];
+
+  free(pairs);
+  free(ctx.name_len);
+  return permutation;
+
+error:
+  free(permutation);
+  free(pairs);
+  free(ctx.name_len);
+  return NULL;
+}
+
+bool sort_order_apply(const uint32_t *permutation, uint32_t packages_count,
+                      size_t *indices, size_t count) {
+  if (!permutation || !indices)
+    return false;
+
+  uint64_t *matched = calloc(((size_t)packages_count + 63) / 64 + 1,
+                             sizeof(uint64_t));
+  if (!matched)
+    return false;
+
+  for (size_t i = 0; i < count; i++)
+    matched[indices[i] / 64] |= 1ull << (indices[i] % 64);
+
+  size_t out = 0;
+  for (uint32_t i = 0; i < packages_count && out < count; i++) {
+    uint32_t idx = permutation[i];
+    if (matched[idx / 64] & (1ull << (idx % 64)))
+      indices[out++] = idx;
+  }
+
+  free(matched);
+  return true;
+}
@@ -0,0 +1,107 @@
+#include "thread_pool.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+// Take and run tasks of current batch until none is left, `lock` is held
+// on entry and on return
+static void run_tasks(thread_pool_t *pool) {
+  while (pool->next < pool->tasks) {
+    size_t task = pool->next++;
+    thread_pool_task fn = pool->fn;
+    void *arg = pool->arg;
+
+    pthread_mutex_unlock(&pool->lock);
+    fn(arg, task);
+    pthread_mutex_lock(&pool->lock);
+
+    if (++pool->finished == pool->tasks)
+      pthread_cond_broadcast(&pool->done);
+  }
+}
+
+static void *pool_main(void *arg) {
+  thread_pool_t *pool = (thread_pool_t *)arg;
+  uint64_t seen = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  while (!pool->stop) {
+    if (pool->batch == seen) {
+      pthread_cond_wait(&pool->work, &pool->lock);
+      continue;
+    }
+
+    seen = pool->batch;
+    run_tasks(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  return NULL;
+}
+
+thread_pool_t *thread_pool_create(size_t threads) {
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 1 ? (size_t)cpus - 1 : 0;
+  }
+  if (threads > THREAD_POOL_MAX)
+    threads = THREAD_POOL_MAX;
+
+  thread_pool_t *pool = calloc(1, sizeof(thread_pool_t));
+  if (!pool)
+    return NULL;
+
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->work, NULL);
+  pthread_cond_init(&pool->done, NULL);
+
+  // Pool works with fewer threads than requested
+  for (; pool->count < threads; pool->count++) {
+    if (pthread_create(&pool->threads[pool->count], NULL, pool_main, pool) !=
+        0)
+      break;
+  }
+
+  return pool;
+}
+
+void thread_pool_run(thread_pool_t *pool, size_t tasks, thread_pool_task fn,
+                     void *arg) {
+  if (!pool || pool->count == 0) {
+    for (size_t i = 0; i < tasks; i++)
+      fn(arg, i);
+    return;
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->fn = fn;
+  pool->arg = arg;
+  pool->tasks = tasks;
+  pool->next = 0;
+  pool->finished = 0;
+  pool->batch++;
+  pthread_cond_broadcast(&pool->work);
+
+  run_tasks(pool);
+  while (pool->finished < pool->tasks)
+    pthread_cond_wait(&pool->done, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_destroy(thread_pool_t *pool) {
+  if (!pool)
+    return;
+
+  pthread_mutex_lock(&pool->lock);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 0; i < pool->count; i++)
+    pthread_join(pool->threads[i], NULL);
+
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->work);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+}
@@ -0,0 +1,399 @@
+#include "transaction.h"
+#include "perf.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Set status and wake the UI up on its next poll, `lock` has to be held
+static void set_status(transaction_t *transaction, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vsnprintf(transaction->status.message, sizeof(transaction->status.message),
+            format, args);
+  va_end(args);
+
+  transaction->updates++;
+}
+
+static void set_phase(transaction_t *transaction, TRANSACTION_PHASE phase) {
+  pthread_mutex_lock(&transaction->lock);
+  transaction->status.phase = phase;
+  transaction->updates++;
+  pthread_mutex_unlock(&transaction->lock);
+}
+
+/* ============= libxbps callbacks ============= */
+
+// What libxbps is doing in `state`, NULL for states that say nothing new
+static const char *state_verb(xbps_state_t state) {
+  switch (state) {
+  case XBPS_STATE_TRANS_DOWNLOAD:
+    return "Downloading packages";
+  case XBPS_STATE_TRANS_VERIFY:
+    return "Verifying package integrity";
+  case XBPS_STATE_TRANS_RUN:
+    return "Running transaction";
+  case XBPS_STATE_TRANS_CONFIGURE:
+    return "Configuring unpacked packages";
+  case XBPS_STATE_DOWNLOAD:
+    return "Downloading";
+  case XBPS_STATE_VERIFY:
+    return "Verifying";
+  case XBPS_STATE_UNPACK:
+    return "Unpacking";
+  case XBPS_STATE_REMOVE:
+    return "Removing";
+  case XBPS_STATE_CONFIGURE:
+    return "Configuring";
+  case XBPS_STATE_INSTALL_DONE:
+    return "Installed";
+  case XBPS_STATE_UPDATE_DONE:
+    return "Updated";
+  case XBPS_STATE_REMOVE_DONE:
+    return "Removed";
+  default:
+    return NULL;
+  }
+}
+
+static int state_cb(const struct xbps_state_cb_data *xscd, void *arg) {
+  transaction_t *transaction = (transaction_t *)arg;
+  const char *verb = state_verb(xscd->state);
+
+  pthread_mutex_lock(&transaction->lock);
+  if (xscd->state == XBPS_STATE_INSTALL_DONE ||
+      xscd->state == XBPS_STATE_UPDATE_DONE ||
+      xscd->state == XBPS_STATE_REMOVE_DONE)
+    transaction->status.done++;
+
+  // Failures carry their own description
+  if (xscd->err != 0 && xscd->desc)
+    set_status(transaction, "%s", xscd->desc);
+  else if (verb && xscd->arg)
+    set_status(transaction, "%s %s", verb, xscd->arg);
+  else if (verb)
+    set_status(transaction, "%s", verb);
+  pthread_mutex_unlock(&transaction->lock);
+
+  return 0;
+}
+
+static void fetch_cb(const struct xbps_fetch_cb_data *xfcd, void *arg) {
+  transaction_t *transaction = (transaction_t *)arg;
+  off_t fetched = xfcd->file_offset + xfcd->file_dloaded;
+
+  pthread_mutex_lock(&transaction->lock);
+  if (xfcd->file_size > 0)
+    set_status(transaction, "Downloading %s %d%%", xfcd->file_name,
+               (int)(fetched * 100 / xfcd->file_size));
+  else
+    set_status(transaction, "Downloading %s", xfcd->file_name);
+  pthread_mutex_unlock(&transaction->lock);
+}
+
+/* ============= Transaction thread ============= */
+
+// Fail with the first string of `key` array of the transaction, which tells
+// what prepare stumbled on
+static void prepare_failed(transaction_t *transaction, int rv) {
+  const char *what = NULL;
+  const char *keys[] = {"missing_deps", "conflicts", "missing_shlibs"};
+
+  for (size_t i = 0; transaction->xhp.transd && i < 3 && !what; i++) {
+    xbps_array_t array = xbps_dictionary_get(transaction->xhp.transd, keys[i]);
+    if (array && xbps_array_count(array) > 0)
+      xbps_array_get_cstring_nocopy(array, 0, &what);
+  }
+
+  pthread_mutex_lock(&transaction->lock);
+  if (what)
+    set_status(transaction, "%s: %s", strerror(rv), what);
+  else
+    set_status(transaction, "Failed to resolve: %s", strerror(rv));
+  transaction->status.phase = TRANSACTION_FAILED;
+  pthread_mutex_unlock(&transaction->lock);
+}
+
+// Copy what the transaction does out of libxbps dictionaries
+static bool summarize(transaction_t *transaction) {
+  transaction_summary_t *summary = &transaction->summary;
+  xbps_dictionary_t transd = transaction->xhp.transd;
+
+  xbps_dictionary_get_uint64(transd, "total-download-size",
+                             &summary->download_size);
+  xbps_dictionary_get_uint64(transd, "total-installed-size",
+                             &summary->installed_size);
+  xbps_dictionary_get_uint64(transd, "total-removed-size",
+                             &summary->removed_size);
+
+  xbps_array_t packages = xbps_dictionary_get(transd, "packages");
+  unsigned int count = packages ? xbps_array_count(packages) : 0;
+  summary->steps = malloc((count > 0 ? count : 1) * sizeof(transaction_step_t));
+  if (!summary->steps)
+    return false;
+
+  for (unsigned int i = 0; i < count; i++) {
+    xbps_dictionary_t pkg = xbps_array_get(packages, i);
+    const char *pkgver = NULL;
+    xbps_dictionary_get_cstring_nocopy(pkg, "pkgver", &pkgver);
+
+    uint32_t offset = string_arena_push(&summary->pkgvers, pkgver);
+    if (offset == NO_STRING)
+      return false;
+
+    summary->steps[summary->count++] = (transaction_step_t){
+        .pkgver = offset,
+        .type = (uint8_t)xbps_transaction_pkg_type(pkg),
+    };
+  }
+
+  return true;
+}
+
+// Queue every marked package and let libxbps resolve them together
+static bool resolve(transaction_t *transaction) {
+  struct xbps_handle *xhp = &transaction->xhp;
+  uint64_t start = perf_now();
+
+  for (uint32_t i = 0, offset = 0; i < transaction->count; i++) {
+    const char *pkgname = string_arena_get(&transaction->pkgnames, offset);
+    offset += (uint32_t)strlen(pkgname) + 1;
+
+    int rv = transaction->actions[i] == TRANSACTION_REMOVE
+                 ? xbps_transaction_remove_pkg(xhp, pkgname, false)
+                 : xbps_transaction_install_pkg(xhp, pkgname, false);
+
+    // Already installed or already gone, nothing to do for it
+    if (rv == EEXIST || (rv == ENOENT &&
+                         transaction->actions[i] == TRANSACTION_REMOVE))
+      continue;
+
+    if (rv != 0) {
+      pthread_mutex_lock(&transaction->lock);
+      set_status(transaction, "%s: %s", pkgname, strerror(rv));
+      transaction->status.phase = TRANSACTION_FAILED;
+      pthread_mutex_unlock(&transaction->lock);
+      return false;
+    }
+  }
+
+  if (!xhp->transd) {
+    pthread_mutex_lock(&transaction->lock);
+    set_status(transaction, "Nothing to do");
+    transaction->status.phase = TRANSACTION_DONE;
+    pthread_mutex_unlock(&transaction->lock);
+    return false;
+  }
+
+  int rv = xbps_transaction_prepare(xhp);
+  perf_span("transaction_prepare", start);
+  if (rv != 0) {
+    prepare_failed(transaction, rv);
+    return false;
+  }
+
+  if (!summarize(transaction)) {
+    pthread_mutex_lock(&transaction->lock);
+    set_status(transaction, "Failed to read transaction");
+    transaction->status.phase = TRANSACTION_FAILED;
+    pthread_mutex_unlock(&transaction->lock);
+    return false;
+  }
+
+  set_phase(transaction, TRANSACTION_READY);
+  return true;
+}
+
+// Fetch, unpack and configure everything
+static void commit(transaction_t *transaction) {
+  struct xbps_handle *xhp = &transaction->xhp;
+  uint64_t start = perf_now();
+  set_phase(transaction, TRANSACTION_RUNNING);
+
+  // libxbps writes pkgdb and reads it again once it's done
+  search_pkgdb_acquire();
+  int rv = xbps_transaction_commit(xhp);
+  search_pkgdb_release();
+  perf_span("transaction_commit", start);
+
+  pthread_mutex_lock(&transaction->lock);
+  if (rv == 0)
+    set_status(transaction, "Finished");
+  else
+    set_status(transaction, "Transaction failed: %s", strerror(rv));
+  transaction->status.phase = rv == 0 ? TRANSACTION_DONE : TRANSACTION_FAILED;
+  pthread_mutex_unlock(&transaction->lock);
+}
+
+static void *transaction_main(void *arg) {
+  transaction_t *transaction = (transaction_t *)arg;
+  struct xbps_handle *xhp = &transaction->xhp;
+
+  if (!search_handle_init(xhp, &transaction->config)) {
+    pthread_mutex_lock(&transaction->lock);
+    set_status(transaction, "Initialization error: libxbps");
+    transaction->status.phase = TRANSACTION_FAILED;
+    pthread_mutex_unlock(&transaction->lock);
+    return NULL;
+  }
+
+  xhp->state_cb = state_cb;
+  xhp->state_cb_data = transaction;
+  xhp->fetch_cb = fetch_cb;
+  xhp->fetch_cb_data = transaction;
+
+  // Like in xbps-install, pkgdb is locked from resolving until commit or
+  // cancel, so no other xbps changes it under the confirmed plan
+  int rv = xbps_pkgdb_lock(xhp);
+  if (rv != 0) {
+    pthread_mutex_lock(&transaction->lock);
+    set_status(transaction, "Failed to lock pkgdb: %s", strerror(rv));
+    transaction->status.phase = TRANSACTION_FAILED;
+    pthread_mutex_unlock(&transaction->lock);
+    xbps_end(xhp);
+    return NULL;
+  }
+
+  if (resolve(transaction)) {
+    pthread_mutex_lock(&transaction->lock);
+    while (!transaction->confirmed && !transaction->stop)
+      pthread_cond_wait(&transaction->wake, &transaction->lock);
+    bool confirmed = transaction->confirmed;
+    pthread_mutex_unlock(&transaction->lock);
+
+    if (confirmed)
+      commit(transaction);
+  }
+
+  xbps_pkgdb_unlock(xhp);
+  xbps_end(xhp);
+  return NULL;
+}
+
+/* ============= Public API ============= */
+
+transaction_t *transaction_start(const search_config_t *config,
+                                 const char *const *pkgnames,
+                                 const TRANSACTION_ACTION *actions,
+                                 uint32_t count) {
+  transaction_t *transaction = calloc(1, sizeof(transaction_t));
+  if (!transaction)
+    return NULL;
+
+  if (config)
+    transaction->config = *config;
+
+  transaction->actions = malloc((count > 0 ? count : 1) * sizeof(uint8_t));
+  if (!transaction->actions)
+    goto error;
+
+  for (uint32_t i = 0; i < count; i++) {
+    if (string_arena_push(&transaction->pkgnames, pkgnames[i]) == NO_STRING)
+      goto error;
+    transaction->actions[i] = (uint8_t)actions[i];
+  }
+  transaction->count = count;
+
+  pthread_mutex_init(&transaction->lock, NULL);
+  pthread_cond_init(&transaction->wake, NULL);
+
+  if (pthread_create(&transaction->thread, NULL, transaction_main,
+                     transaction) != 0) {
+    pthread_cond_destroy(&transaction->wake);
+    pthread_mutex_destroy(&transaction->lock);
+    goto error;
+  }
+
+  return transaction;
+
+error:
+  string_arena_cleanup(&transaction->pkgnames);
+  free(transaction->actions);
+  free(transaction);
+  return NULL;
+}
+
+bool transaction_status(transaction_t *transaction,
+                        transaction_status_t *status, uint64_t *seen) {
+  pthread_mutex_lock(&transaction->lock);
+  bool changed = transaction->updates != *seen;
+  if (changed) {
+    *status = transaction->status;
+    *seen = transaction->updates;
+  }
+  pthread_mutex_unlock(&transaction->lock);
+
+  return changed;
+}
+
+const transaction_summary_t *transaction_summary(transaction_t *transaction) {
+  pthread_mutex_lock(&transaction->lock);
+  TRANSACTION_PHASE phase = transaction->status.phase;
+  pthread_mutex_unlock(&transaction->lock);
+
+  // Summary of a transaction that failed to resolve is empty
+  return phase == TRANSACTION_RESOLVING ? NULL : &transaction->summary;
+}
+
+bool transaction_confirm(transaction_t *transaction) {
+  pthread_mutex_lock(&transaction->lock);
+  bool ready = transaction->status.phase == TRANSACTION_READY;
+  if (ready) {
+    transaction->confirmed = true;
+    pthread_cond_signal(&transaction->wake);
+  }
+  pthread_mutex_unlock(&transaction->lock);
+
+  return ready;
+}
+
+const char *transaction_step_label(const transaction_step_t *step) {
+  switch ((xbps_trans_type_t)step->type) {
+  case XBPS_TRANS_INSTALL:
+    return "install";
+  case XBPS_TRANS_REINSTALL:
+    return "reinstall";
+  case XBPS_TRANS_UPDATE:
+    return "update";
+  case XBPS_TRANS_CONFIGURE:
+    return "configure";
+  case XBPS_TRANS_REMOVE:
+    return "remove";
+  case XBPS_TRANS_HOLD:
+    return "hold";
+  case XBPS_TRANS_DOWNLOAD:
+    return "download";
+  default:
+    return "unknown";
+  }
+}
+
+void transaction_cancel(transaction_t *transaction) {
+  if (!transaction)
+    return;
+
+  pthread_mutex_lock(&transaction->lock);
+  transaction->stop = true;
+  pthread_cond_signal(&transaction->wake);
+  pthread_mutex_unlock(&transaction->lock);
+}
+
+void transaction_stop(transaction_t *transaction) {
+  if (!transaction)
+    return;
+
+  transaction_cancel(transaction);
+  pthread_join(transaction->thread, NULL);
+
+  free(transaction->summary.steps);
+  string_arena_cleanup(&transaction->summary.pkgvers);
+  string_arena_cleanup(&transaction->pkgnames);
+  free(transaction->actions);
+
+  pthread_cond_destroy(&transaction->wake);
+  pthread_mutex_destroy(&transaction->lock);
+  free(transaction);
+}
@@ -0,0 +1,249 @@
+#include "trigram.h"
+#include "pkg_search.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* ============= Build ============= */
+
+// Pair of trigram (high 32 bits) and package index (low 32 bits)
+struct pairs {
+  uint64_t *data;
+  size_t count;
+  size_t cap;
+};
+
+static bool pairs_push(struct pairs *pairs, uint32_t trigram, uint32_t idx) {
+  if (pairs->count == pairs->cap) {
+    size_t cap = pairs->cap > 0 ? pairs->cap * 2 : 4096;
+    uint64_t *data = realloc(pairs->data, cap * sizeof(uint64_t));
+    if (!data)
+      return false;
+
+    pairs->data = data;
+    pairs->cap = cap;
+  }
+
+  pairs->data[pairs->count++] = ((uint64_t)trigram << 32) | idx;
+  return true;
+}
+
+static inline uint32_t pack_trigram(const char *s) {
+  return ((uint32_t)fold_ascii((unsigned char)s[0]) << 16) |
+         ((uint32_t)fold_ascii((unsigned char)s[1]) << 8) |
+         (uint32_t)fold_ascii((unsigned char)s[2]);
+}
+
+static bool add_string(struct pairs *pairs, const char *str, uint32_t idx) {
+  if (!str)
+    return true;
+
+  size_t len = strlen(str);
+  for (size_t i = 0; i + TRIGRAM_MIN_QUERY <= len; i++) {
+    if (!pairs_push(pairs, pack_trigram(str + i), idx))
+      return false;
+  }
+  return true;
+}
+
+// LSD radix sort by trigram. It is stable, so package indices that were
+// pushed in ascending order stay ascending within each trigram
+static bool sort_pairs(struct pairs *pairs) {
+  uint64_t *tmp = malloc(pairs->count * sizeof(uint64_t));
+  if (!tmp)
+    return false;
+
+  uint64_t *src = pairs->data, *dst = tmp;
+  for (unsigned shift = 32; shift < 56; shift += 8) {
+    size_t counts[257] = {0};
+    for (size_t i = 0; i < pairs->count; i++)
+      counts[((src[i] >> shift) & 0xff) + 1]++;
+    for (size_t i = 1; i < 257; i++)
+      counts[i] += counts[i - 1];
+    for (size_t i = 0; i < pairs->count; i++)
+      dst[counts[(src[i] >> shift) & 0xff]++] = src[i];
+
+    uint64_t *swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  // Odd number of passes leaves result in `tmp`
+  pairs->data = src;
+  free(dst);
+  return true;
+}
+
+trigram_index_t *trigram_index_build(const search_result_t *packages) {
+  if (!packages)
+    return NULL;
+
+  trigram_index_t *index = calloc(1, sizeof(trigram_index_t));
+  if (!index)
+    return NULL;
+
+  struct pairs pairs = {0};
+  for (uint32_t i = 0; i < packages->count; i++) {
+    if (!add_string(&pairs, search_result_pkgver(packages, i), i) ||
+        !add_string(&pairs, search_result_short_desc(packages, i), i))
+      goto error;
+  }
+
+  if (pairs.count > 0 && !sort_pairs(&pairs))
+    goto error;
+
+  // Count distinct trigrams, duplicates within one package are adjacent
+  size_t keys = 0, postings = 0;
+  for (size_t i = 0; i < pairs.count; i++) {
+    if (i > 0 && pairs.data[i] == pairs.data[i - 1])
+      continue;
+    if (i == 0 || (pairs.data[i] >> 32) != (pairs.data[i - 1] >> 32))
+      keys++;
+    postings++;
+  }
+
+  index->keys = malloc((keys > 0 ? keys : 1) * sizeof(uint32_t));
+  index->offsets = malloc((keys + 1) * sizeof(uint32_t));
+  index->postings = malloc((postings > 0 ? postings : 1) * sizeof(uint32_t));
+  if (!index->keys || !index->offsets || !index->postings)
+    goto error;
+
+  for (size_t i = 0; i < pairs.count; i++) {
+    if (i > 0 && pairs.data[i] == pairs.data[i - 1])
+      continue;
+
+    uint32_t trigram = (uint32_t)(pairs.data[i] >> 32);
+    if (index->keys_count == 0 ||
+        index->keys[index->keys_count - 1] != trigram) {
+      index->keys[index->keys_count] = trigram;
+      index->offsets[index->keys_count++] = index->postings_count;
+    }
+    index->postings[index->postings_count++] = (uint32_t)pairs.data[i];
+  }
+  index->offsets[index->keys_count] = index->postings_count;
+
+  free(pairs.data);
+  return index;
+
+error:
+  free(pairs.data);
+  trigram_index_cleanup(index);
+  return NULL;
+}
+
+/* ============= Query ============= */
+
+// Posting list of trigram, or false if no package contains it
+static bool find_list(const trigram_index_t *index, uint32_t trigram,
+                      const uint32_t **list, size_t *len) {
+  size_t lo = 0, hi = index->keys_count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index->keys[mid] < trigram)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == index->keys_count || index->keys[lo] != trigram)
+    return false;
+
+  *list = index->postings + index->offsets[lo];
+  *len = index->offsets[lo + 1] - index->offsets[lo];
+  return true;
+}
+
+size_t trigram_index_estimate(const trigram_index_t *index, const char *query) {
+  size_t len = strlen(query);
+  if (!index || len < TRIGRAM_MIN_QUERY)
+    return SIZE_MAX;
+
+  size_t best = SIZE_MAX;
+  for (size_t i = 0; i + TRIGRAM_MIN_QUERY <= len; i++) {
+    const uint32_t *list;
+    size_t list_len;
+    if (!find_list(index, pack_trigram(query + i), &list, &list_len))
+      return 0;
+    if (list_len < best)
+      best = list_len;
+  }
+  return best;
+}
+
+size_t trigram_index_query(const trigram_index_t *index, const char *query,
+                           size_t *out) {
+  size_t len = strlen(query);
+  if (!index || len < TRIGRAM_MIN_QUERY)
+    return 0;
+
+  // Start from the shortest list, so `out` never grows
+  size_t trigrams = len - TRIGRAM_MIN_QUERY + 1;
+  size_t shortest = 0, shortest_len = SIZE_MAX;
+  for (size_t i = 0; i < trigrams; i++) {
+    const uint32_t *list;
+    size_t list_len;
+    if (!find_list(index, pack_trigram(query + i), &list, &list_len))
+      return 0;
+    if (list_len < shortest_len) {
+      shortest = i;
+      shortest_len = list_len;
+    }
+  }
+
+  // Lists were all found above, the index doesn't change meanwhile
+  const uint32_t *list;
+  size_t count;
+  if (!find_list(index, pack_trigram(query + shortest), &list, &count))
+    return 0;
+  for (size_t i = 0; i < count; i++)
+    out[i] = list[i];
+
+  // Intersect in place with the other lists
+  for (size_t t = 0; t < trigrams && count > 0; t++) {
+    if (t == shortest)
+      continue;
+
+    size_t list_len;
+    if (!find_list(index, pack_trigram(query + t), &list, &list_len))
+      return 0;
+
+    size_t kept = 0, j = 0;
+    for (size_t i = 0; i < count; i++) {
+      while (j < list_len && list[j] < out[i])
+        j++;
+      if (j == list_len)
+        break;
+      if (list[j] == out[i])
+        out[kept++] = out[i];
+    }
+    count = kept;
+  }
+
+  return count;
+}
+
+/* ============= Cleanup functions ============= */
+
+size_t trigram_index_memory(const trigram_index_t *index) {
+  if (!index)
+    return 0;
+
+  return sizeof(trigram_index_t) +
+         (index->keys_count * 2 + 1 + (size_t)index->postings_count) *
+             sizeof(uint32_t);
+}
+
+void trigram_index_cleanup(trigram_index_t *index) {
+  if (!index)
+    return;
+
+  if (index->keys)
+    free(index->keys);
+  if (index->offsets)
+    free(index->offsets);
+  if (index->postings)
+    free(index->postings);
+
+  free(index);
+}
@@ -3,7 +3,57 @@
 #include "input.h"
 #include "model.h"
 
+#include <errno.h>
 #include <notcurses/notcurses.h>
+#include <poll.h>
+
+// How often to check for search results while a query is in flight or the
+// catalog is being loaded
+#define FILTER_POLL_NS (8 * 1000 * 1000)
+
+// Most events applied before the next frame, so that a flood of input can't
+// hold the screen back forever
+#define INPUT_BATCH_MAX 1024
+
+// Apply one input event to the model, false means the app should quit
+static bool apply_event(model_t *state, uint32_t id, const ncinput *ni) {
+  if (id == NCKEY_RESIZE) {
+    state->dirty |= DIRTY_ALL;
+    return true;
+  }
+
+  ACTION input = handle_input(state, ni);
+  if (input == EXIT || input == ERROR)
+    return false;
+
+  if (input == SWITCH_TAB) {
+    state->focus = state->focus == LIST ? INPUT : LIST;
+    state->dirty |= DIRTY_ALL;
+  }
+
+  return true;
+}
+
+// Block until there's input or the pkgdb watcher published a catalog
+static void wait_idle(model_t *state) {
+  struct pollfd fds[2] = {
+      {.fd = notcurses_inputready_fd(state->nc), .events = POLLIN},
+      {.fd = state->watch->notify, .events = POLLIN},
+  };
+
+  while (poll(fds, 2, -1) < 0 && errno == EINTR)
+    ;
+}
+
+// Render frame drawn by `draw_dirty`
+static void render(model_t *state, size_t events) {
+  uint64_t start = perf_now();
+  notcurses_render(state->nc);
+  state->stats.render_ns = perf_span("notcurses_render", start);
+  state->stats.events = events;
+  state->stats.frames++;
+  perf_counter("events", events);
+}
 
 bool run_app(model_t *state) {
   if (!state)
@@ -14,23 +64,70 @@ bool run_app(model_t *state) {
     return false;
   }
 
-  notcurses_render(state->nc);
+  draw_dirty(state);
+  render(state, 0);
 
   ncinput ni = {0};
+  size_t events = 0; // Applied since the last frame
 
   // Main loop
-  while (notcurses_get(state->nc, NULL, &ni) != (uint32_t)-1) {
-    ACTION input = handle_input(state, &ni);
-    if (input == EXIT || input == ERROR)
+  while (true) {
+    // Block on input, unless a search result, catalog or progress of a
+    // transaction is expected. New pkgdb wakes the loop up as well
+    const struct timespec timeout = {.tv_sec = 0, .tv_nsec = FILTER_POLL_NS};
+    bool waiting = state->filter_pending || state->loader ||
+                   state->files.loading || state->files.filter_pending ||
+                   state->owners.loader || state->owners.pending ||
+                   (state->batch.transaction &&
+                    (state->batch.status.phase == TRANSACTION_RESOLVING ||
+                     state->batch.status.phase == TRANSACTION_RUNNING));
+    uint32_t id;
+    if (waiting) {
+      id = notcurses_get(state->nc, &timeout, &ni);
+    } else if (state->watch) {
+      wait_idle(state);
+      id = notcurses_get_nblock(state->nc, &ni);
+    } else {
+      id = notcurses_get(state->nc, NULL, &ni);
+    }
+
+    // Drain everything that is already pending, a paste or a held key then
+    // costs one filter pass and one frame instead of one per event
+    bool quit = false;
+    for (size_t batch = 0; id != 0 && id != (uint32_t)-1; batch++) {
+      if (!apply_event(state, id, &ni)) {
+        quit = true;
+        break;
+      }
+      events++;
+      if (batch + 1 == INPUT_BATCH_MAX)
+        break;
+      id = notcurses_get_nblock(state->nc, &ni);
+    }
+    if (quit || id == (uint32_t)-1)
       break;
-    else if (input == SWITCH_TAB)
-      state->focus = (state->focus + 1) % 2;
 
-    draw_list(state);
-    draw_input(state);
-    draw_info(state);
+    query_flush(state);
+
+    // Pollers mark what they changed
+    catalog_poll(state);
+    pkgdb_poll(state);
+    filter_poll(state, false);
+    files_poll(state);
+    owner_poll(state);
+    orphans_poll(state);
+    batch_poll(state);
+
+    // Key releases, moves past the end of the list and the like change
+    // nothing on screen
+    if (!draw_dirty(state))
+      continue;
+
+    render(state, events);
+    events = 0;
 
-    notcurses_render(state->nc);
+    // Frame is already on screen, warm up cache for the next one
+    prefetch_info(state);
   }
 
   return true;
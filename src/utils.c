@@ -1,9 +1,25 @@
 #include "utils.h"
 
-#include <ctype.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
 
-const char *strcasestr_portable(const char *haystack, const char *needle) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Only ASCII letters are folded, multibyte UTF-8 sequences are compared as is
+static inline bool equal_folded(const char *a, const char *b, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (fold_ascii((unsigned char)a[i]) != fold_ascii((unsigned char)b[i]))
+      return false;
+  }
+  return true;
+}
+
+static const char *strcasestr_scalar(const char *haystack, const char *needle) {
   if (!*needle) {
     return haystack;
   }
@@ -11,7 +27,7 @@ const char *strcasestr_portable(const char *haystack, const char *needle) {
     const char *h = haystack;
     const char *n = needle;
     while (*h && *n &&
-           tolower((unsigned char)*h) == tolower((unsigned char)*n)) {
+           fold_ascii((unsigned char)*h) == fold_ascii((unsigned char)*n)) {
       h++;
       n++;
     }
@@ -21,3 +37,150 @@ const char *strcasestr_portable(const char *haystack, const char *needle) {
   }
   return NULL;
 }
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * Both vector kernels compare the folded first and last needle bytes against
+ * a whole block of haystack positions at once, and only verify the middle of
+ * the needle for positions where both of them match. Positions that don't
+ * fit in a full block are left to the scalar loop.
+ */
+
+__attribute__((target("sse2"))) static inline __m128i fold_sse2(__m128i v) {
+  const __m128i offset = _mm_sub_epi8(v, _mm_set1_epi8('A'));
+  const __m128i upper =
+      _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(25)), offset);
+  return _mm_add_epi8(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+__attribute__((target("sse2"))) static const char *
+strcasestr_sse2(const char *haystack, size_t haystack_len, const char *needle,
+                size_t needle_len) {
+  const __m128i first =
+      _mm_set1_epi8((char)fold_ascii((unsigned char)needle[0]));
+  const __m128i last = _mm_set1_epi8(
+      (char)fold_ascii((unsigned char)needle[needle_len - 1]));
+
+  size_t i = 0;
+  for (; i + needle_len - 1 + 16 <= haystack_len; i += 16) {
+    const __m128i block_first =
+        fold_sse2(_mm_loadu_si128((const __m128i *)(haystack + i)));
+    const __m128i block_last = fold_sse2(
+        _mm_loadu_si128((const __m128i *)(haystack + i + needle_len - 1)));
+
+    unsigned mask = (unsigned)_mm_movemask_epi8(
+        _mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                      _mm_cmpeq_epi8(block_last, last)));
+    while (mask) {
+      unsigned bit = (unsigned)__builtin_ctz(mask);
+      if (equal_folded(haystack + i + bit + 1, needle + 1,
+                       needle_len > 2 ? needle_len - 2 : 0))
+        return haystack + i + bit;
+      mask &= mask - 1;
+    }
+  }
+
+  return strcasestr_scalar(haystack + i, needle);
+}
+
+__attribute__((target("avx2"))) static inline __m256i fold_avx2(__m256i v) {
+  const __m256i offset = _mm256_sub_epi8(v, _mm256_set1_epi8('A'));
+  const __m256i upper = _mm256_cmpeq_epi8(
+      _mm256_min_epu8(offset, _mm256_set1_epi8(25)), offset);
+  return _mm256_add_epi8(v, _mm256_and_si256(upper, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2"))) static const char *
+strcasestr_avx2(const char *haystack, size_t haystack_len, const char *needle,
+                size_t needle_len) {
+  // Most package names are shorter than a single block
+  if (needle_len - 1 + 32 > haystack_len)
+    return strcasestr_sse2(haystack, haystack_len, needle, needle_len);
+
+  const __m256i first =
+      _mm256_set1_epi8((char)fold_ascii((unsigned char)needle[0]));
+  const __m256i last = _mm256_set1_epi8(
+      (char)fold_ascii((unsigned char)needle[needle_len - 1]));
+
+  size_t i = 0;
+  for (; i + needle_len - 1 + 32 <= haystack_len; i += 32) {
+    const __m256i block_first =
+        fold_avx2(_mm256_loadu_si256((const __m256i *)(haystack + i)));
+    const __m256i block_last = fold_avx2(
+        _mm256_loadu_si256((const __m256i *)(haystack + i + needle_len - 1)));
+
+    unsigned mask = (unsigned)_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                         _mm256_cmpeq_epi8(block_last, last)));
+    while (mask) {
+      unsigned bit = (unsigned)__builtin_ctz(mask);
+      if (equal_folded(haystack + i + bit + 1, needle + 1,
+                       needle_len > 2 ? needle_len - 2 : 0))
+        return haystack + i + bit;
+      mask &= mask - 1;
+    }
+  }
+
+  // Less than a full AVX2 block left, SSE2 may still cover part of it. Upper
+  // halves are cleared first, legacy SSE code after dirty ones is slow
+  _mm256_zeroupper();
+  return strcasestr_sse2(haystack + i, haystack_len - i, needle, needle_len);
+}
+
+// Vector kernels get lengths of both strings, the needle is never longer
+typedef const char *(*kernel_fn)(const char *haystack, size_t haystack_len,
+                                 const char *needle, size_t needle_len);
+
+static const kernel_fn kernels[] = {
+    [STRCASESTR_SSE2] = strcasestr_sse2,
+    [STRCASESTR_AVX2] = strcasestr_avx2,
+};
+
+#endif
+
+STRCASESTR_KERNEL strcasestr_kernel(void) {
+  // CPU is asked once, every thread that races here resolves the same kernel
+  static _Atomic int resolved = -1;
+
+  int kernel = atomic_load_explicit(&resolved, memory_order_relaxed);
+  if (kernel >= 0)
+    return (STRCASESTR_KERNEL)kernel;
+
+  kernel = STRCASESTR_SCALAR;
+#ifdef HAVE_X86_SIMD
+  if (__builtin_cpu_supports("avx2"))
+    kernel = STRCASESTR_AVX2;
+  else if (__builtin_cpu_supports("sse2"))
+    kernel = STRCASESTR_SSE2;
+#endif
+
+  atomic_store_explicit(&resolved, kernel, memory_order_relaxed);
+  return (STRCASESTR_KERNEL)kernel;
+}
+
+const char *strcasestr_with(STRCASESTR_KERNEL kernel, const char *haystack,
+                            const char *needle) {
+  if (!*needle) {
+    return haystack;
+  }
+
+#ifdef HAVE_X86_SIMD
+  if (kernel != STRCASESTR_SCALAR) {
+    size_t haystack_len = strlen(haystack);
+    size_t needle_len = strlen(needle);
+    if (needle_len > haystack_len)
+      return NULL;
+
+    return kernels[kernel](haystack, haystack_len, needle, needle_len);
+  }
+#else
+  (void)kernel;
+#endif
+
+  return strcasestr_scalar(haystack, needle);
+}
+
+const char *strcasestr_portable(const char *haystack, const char *needle) {
+  return strcasestr_with(strcasestr_kernel(), haystack, needle);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/// @brief Exit status of a test that can't run here, e.g. without xbps tools
+#define CHECK_SKIP 77
+
+/// @brief Failed checks so far, every test is a binary of its own
+static int check_failures;
+
+/// @brief Report failed condition and go on, so one run shows every failure
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      check_failures++;                                                        \
+    }                                                                          \
+  } while (0)
+
+/// @brief Report failed condition and stop, later checks depend on it
+#define REQUIRE(cond)                                                          \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: requirement failed: %s\n", __FILE__,             \
+              __LINE__, #cond);                                                \
+      exit(EXIT_FAILURE);                                                      \
+    }                                                                          \
+  } while (0)
+
+/// @brief Exit status of the test
+static inline int check_status(const char *name) {
+  if (check_failures > 0)
+    fprintf(stderr, "%s: %d checks failed\n", name, check_failures);
+
+  return check_failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
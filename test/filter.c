@@ -0,0 +1,160 @@
+#include "check.h"
+#include "filter.h"
+#include "synthetic.h"
+#include "thread_pool.h"
+#include "trigram.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Random keystroke sequences give the same matches incrementally as a full
+// rescan of the catalog does, with and without the trigram index and threads
+
+#define PACKAGES 3000
+#define KEYSTROKES 400
+#define QUERY_LEN 12
+
+// Passes above it are split across threads, low so that short queries are too
+#define PARALLEL_THRESHOLD 1024
+
+// Keys typed in each mode, letters common in the synthetic names
+static const char *const alphabets[] = {
+    [MATCH_SUBSTRING] = "abdeilmnoprstxy-3",
+    [MATCH_FUZZY] = "abdeilmnoprstxy-3",
+    [MATCH_REGEX] = "abdeilnoprst-^$.*|",
+};
+
+static const char *const mode_names[] = {
+    [MATCH_SUBSTRING] = "substring",
+    [MATCH_FUZZY] = "fuzzy",
+    [MATCH_REGEX] = "regex",
+};
+
+static int compare_indices(const void *a, const void *b) {
+  size_t x = *(const size_t *)a, y = *(const size_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Matches in pkgdb order, caller frees
+static size_t *sorted_matches(const filter_t *filter) {
+  size_t *indices = malloc((filter->count > 0 ? filter->count : 1) *
+                           sizeof(size_t));
+  REQUIRE(indices);
+  memcpy(indices, filter->indices, filter->count * sizeof(size_t));
+  qsort(indices, filter->count, sizeof(size_t), compare_indices);
+  return indices;
+}
+
+static bool same_matches(const filter_t *a, const filter_t *b) {
+  if (a->count != b->count)
+    return false;
+
+  size_t *x = sorted_matches(a), *y = sorted_matches(b);
+  bool same = memcmp(x, y, a->count * sizeof(size_t)) == 0;
+
+  // Ranking relies on every current match being scored against the query, the
+  // empty one isn't ranked
+  bool scored = a->mode == MATCH_FUZZY && a->query_len > 0;
+  for (size_t i = 0; same && scored && i < a->count; i++)
+    same = a->scores[x[i]] == b->scores[x[i]];
+
+  free(x);
+  free(y);
+  return same;
+}
+
+// Next query: mostly typing, sometimes backspace, an edit in the middle or a
+// cleared line
+static void keystroke(synthetic_rng_t *rng, const char *alphabet,
+                      char *query) {
+  size_t len = strlen(query), keys = strlen(alphabet);
+  char key = alphabet[synthetic_next(rng) % keys];
+  unsigned roll = (unsigned)(synthetic_next(rng) % 100);
+
+  if (roll < 60 && len < QUERY_LEN) {
+    query[len] = key;
+    query[len + 1] = '\0';
+  } else if (roll < 85 && len > 0) {
+    query[len - 1] = '\0';
+  } else if (roll < 95 && len > 0) {
+    query[synthetic_next(rng) % len] = key;
+  } else {
+    query[0] = '\0';
+  }
+}
+
+static void run_sequence(const search_result_t *catalog,
+                         const trigram_index_t *index, thread_pool_t *pool,
+                         MATCH_MODE mode, uint64_t seed) {
+  filter_t incremental, rescan;
+  REQUIRE(filter_init(&incremental, catalog, index));
+  REQUIRE(filter_init(&rescan, catalog, NULL));
+  incremental.pool = pool;
+  incremental.parallel_threshold = PARALLEL_THRESHOLD;
+
+  _Atomic uint64_t latest = 0;
+  incremental.latest = &latest;
+
+  synthetic_rng_t rng = {.state = seed};
+  char query[QUERY_LEN + 1] = "";
+  for (int step = 0; step < KEYSTROKES; step++) {
+    keystroke(&rng, alphabets[mode], query);
+
+    // Canceled pass leaves the previous matches in place
+    if (synthetic_next(&rng) % 10 == 0) {
+      size_t count = incremental.count;
+      size_t *matches = sorted_matches(&incremental);
+
+      atomic_store(&latest, incremental.generation + 1);
+      if (!filter_run(&incremental, query, mode)) {
+        CHECK(incremental.count == count);
+        size_t *after = sorted_matches(&incremental);
+        CHECK(memcmp(after, matches, count * sizeof(size_t)) == 0);
+        free(after);
+      }
+      free(matches);
+      incremental.generation = atomic_load(&latest);
+    }
+
+    REQUIRE(filter_run(&incremental, query, mode));
+    filter_reset(&rescan);
+    REQUIRE(filter_run(&rescan, query, mode));
+
+    // Pattern that doesn't compile keeps whatever matched before
+    CHECK(incremental.invalid == rescan.invalid);
+    if (rescan.invalid)
+      continue;
+
+    if (!same_matches(&incremental, &rescan)) {
+      fprintf(stderr, "%s%s%s: \"%s\" after %d keys: %zu matches, %zu "
+              "expected\n", mode_names[mode], index ? ", index" : "",
+              pool ? ", threads" : "", query, step + 1, incremental.count,
+              rescan.count);
+      check_failures++;
+      break;
+    }
+  }
+
+  filter_cleanup(&incremental);
+  filter_cleanup(&rescan);
+}
+
+int main(void) {
+  search_result_t *catalog = synthetic_catalog(PACKAGES, 1);
+  REQUIRE(catalog);
+  trigram_index_t *index = trigram_index_build(catalog);
+  REQUIRE(index);
+  thread_pool_t *pool = thread_pool_create(4);
+  REQUIRE(pool);
+
+  for (MATCH_MODE mode = MATCH_SUBSTRING; mode <= MATCH_REGEX; mode++) {
+    run_sequence(catalog, NULL, NULL, mode, 1 + mode);
+    run_sequence(catalog, index, NULL, mode, 11 + mode);
+    run_sequence(catalog, index, pool, mode, 21 + mode);
+  }
+
+  thread_pool_destroy(pool);
+  trigram_index_cleanup(index);
+  search_result_cleanup(catalog);
+  return check_status("filter");
+}
@@ -0,0 +1,214 @@
+#include "check.h"
+#include "search_worker.h"
+#include "synthetic.h"
+#include "trigram.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Queries are fired at the worker far faster than it can finish them, the UI
+// side takes whatever is published now and then. Every result taken has to be
+// newer than the previous one and hold the matches of the query it's labeled
+// with, on the catalog that was current when it was submitted
+
+#define SUBMISSIONS 100000
+#define CATALOG_SWITCH_EVERY 10000
+#define WAIT_EVERY 100
+
+// Longest pause between two submissions, so that some passes get to finish
+#define PAUSE_MAX_US 50
+#define RANKED 50
+
+typedef struct query_t {
+  const char *text;
+  MATCH_MODE mode;
+
+} query_t;
+
+static const query_t queries[] = {
+    {"", MATCH_SUBSTRING},
+    {"l", MATCH_SUBSTRING},
+    {"li", MATCH_SUBSTRING},
+    {"lib", MATCH_SUBSTRING},
+    {"lib-", MATCH_SUBSTRING},
+    {"py", MATCH_SUBSTRING},
+    {"python3-", MATCH_SUBSTRING},
+    {"devel", MATCH_SUBSTRING},
+    {"x", MATCH_SUBSTRING},
+    {"bab", MATCH_SUBSTRING},
+    {"pyd", MATCH_FUZZY},
+    {"ldv", MATCH_FUZZY},
+    {"ba", MATCH_FUZZY},
+    {"^lib", MATCH_REGEX},
+    {"devel$", MATCH_REGEX},
+    {"^(perl|rust)-", MATCH_REGEX},
+    {"[", MATCH_REGEX},
+};
+#define QUERIES (sizeof(queries) / sizeof(queries[0]))
+
+// Sorted matches of every query on one catalog
+typedef struct expected_t {
+  size_t *indices[QUERIES];
+  size_t count[QUERIES];
+  bool invalid[QUERIES];
+
+} expected_t;
+
+// Catalog and query of each generation
+typedef struct request_t {
+  uint8_t catalog;
+  uint8_t query;
+
+} request_t;
+
+static int compare_indices(const void *a, const void *b) {
+  size_t x = *(const size_t *)a, y = *(const size_t *)b;
+  return (x > y) - (x < y);
+}
+
+static void expect(expected_t *expected, const search_result_t *catalog,
+                   const trigram_index_t *index) {
+  for (size_t q = 0; q < QUERIES; q++) {
+    filter_t filter;
+    REQUIRE(filter_init(&filter, catalog, index));
+    REQUIRE(filter_run(&filter, queries[q].text, queries[q].mode));
+
+    expected->count[q] = filter.count;
+    expected->invalid[q] = filter.invalid;
+    expected->indices[q] =
+        malloc((filter.count > 0 ? filter.count : 1) * sizeof(size_t));
+    REQUIRE(expected->indices[q]);
+    if (filter.count > 0)
+      memcpy(expected->indices[q], filter.indices,
+             filter.count * sizeof(size_t));
+    qsort(expected->indices[q], filter.count, sizeof(size_t),
+          compare_indices);
+    filter_cleanup(&filter);
+  }
+}
+
+typedef struct stress_t {
+  search_worker_t *worker;
+  expected_t expected[2];
+  request_t *requests; // Indexed by generation
+  uint64_t submitted;  // Newest generation
+  uint64_t switched;   // Generation of the last catalog switch
+  uint64_t taken;      // Generation of the last result taken
+
+} stress_t;
+
+static bool same_matches(const filter_result_t *result, const size_t *indices,
+                         size_t count) {
+  if (result->count != count)
+    return false;
+
+  size_t *sorted = malloc((count > 0 ? count : 1) * sizeof(size_t));
+  REQUIRE(sorted);
+  memcpy(sorted, result->indices, count * sizeof(size_t));
+  qsort(sorted, count, sizeof(size_t), compare_indices);
+
+  bool same = memcmp(sorted, indices, count * sizeof(size_t)) == 0;
+  free(sorted);
+  return same;
+}
+
+static void check_result(stress_t *stress, filter_result_t *result) {
+  uint64_t generation = result->generation;
+  CHECK(generation > stress->taken);
+  CHECK(generation >= stress->switched);
+  CHECK(generation <= stress->submitted);
+  stress->taken = generation;
+
+  if (generation > stress->submitted) {
+    filter_result_cleanup(result);
+    return;
+  }
+
+  request_t request = stress->requests[generation];
+  const expected_t *expected = &stress->expected[request.catalog];
+  CHECK(result->invalid == expected->invalid[request.query]);
+
+  // Regex that doesn't compile keeps the matches of whatever ran before
+  if (!result->invalid &&
+      !same_matches(result, expected->indices[request.query],
+                    expected->count[request.query])) {
+    fprintf(stderr, "generation %llu: \"%s\" has %zu matches, %zu expected\n",
+            (unsigned long long)generation, queries[request.query].text,
+            result->count, expected->count[request.query]);
+    check_failures++;
+  }
+
+  filter_result_cleanup(result);
+}
+
+int main(void) {
+  search_result_t *catalogs[2] = {synthetic_catalog(3000, 1),
+                                  synthetic_catalog(2500, 2)};
+  REQUIRE(catalogs[0] && catalogs[1]);
+  trigram_index_t *indexes[2] = {trigram_index_build(catalogs[0]),
+                                 trigram_index_build(catalogs[1])};
+  REQUIRE(indexes[0] && indexes[1]);
+
+  stress_t stress = {0};
+  expect(&stress.expected[0], catalogs[0], indexes[0]);
+  expect(&stress.expected[1], catalogs[1], indexes[1]);
+
+  // Every submission and catalog switch takes one generation
+  size_t generations = SUBMISSIONS + SUBMISSIONS / CATALOG_SWITCH_EVERY + 1;
+  stress.requests = calloc(generations, sizeof(request_t));
+  REQUIRE(stress.requests);
+
+  stress.worker = search_worker_start(catalogs[0], indexes[0]);
+  REQUIRE(stress.worker);
+
+  synthetic_rng_t rng = {.state = 0x5eed};
+  uint8_t catalog = 0, query = 0;
+  for (int i = 1; i <= SUBMISSIONS && check_failures < 16; i++) {
+    query = (uint8_t)(synthetic_next(&rng) % QUERIES);
+    stress.submitted = search_worker_submit(
+        stress.worker, queries[query].text, queries[query].mode, RANKED);
+    REQUIRE(stress.submitted < generations);
+    stress.requests[stress.submitted] = (request_t){catalog, query};
+
+    if (i % WAIT_EVERY == 0) {
+      // Nothing newer was submitted, so the newest query gets published
+      search_worker_wait(stress.worker, stress.submitted);
+      filter_result_t *result = search_worker_take(stress.worker);
+      REQUIRE(result);
+      CHECK(result->generation == stress.submitted);
+      check_result(&stress, result);
+    } else if (synthetic_next(&rng) % 4 == 0) {
+      usleep((useconds_t)(synthetic_next(&rng) % PAUSE_MAX_US));
+      filter_result_t *result = search_worker_take(stress.worker);
+      if (result)
+        check_result(&stress, result);
+    }
+
+    if (i % CATALOG_SWITCH_EVERY == CATALOG_SWITCH_EVERY / 2 + 1) {
+      // Result of the old catalog is left unclaimed, the switch drops it,
+      // cancels the pass in flight and reruns the last query
+      search_worker_wait(stress.worker, stress.submitted);
+      catalog ^= 1;
+      REQUIRE(search_worker_set_catalog(stress.worker, catalogs[catalog],
+                                        indexes[catalog]));
+      stress.submitted = stress.switched = atomic_load(&stress.worker->latest);
+      REQUIRE(stress.submitted < generations);
+      stress.requests[stress.submitted] = (request_t){catalog, query};
+
+      filter_result_t *result = search_worker_take(stress.worker);
+      if (result)
+        check_result(&stress, result);
+    }
+  }
+
+  search_worker_stop(stress.worker);
+  for (int c = 0; c < 2; c++) {
+    for (size_t q = 0; q < QUERIES; q++)
+      free(stress.expected[c].indices[q]);
+    trigram_index_cleanup(indexes[c]);
+    search_result_cleanup(catalogs[c]);
+  }
+  free(stress.requests);
+  return check_status("search_worker");
+}
@@ -0,0 +1,115 @@
+#include "check.h"
+#include "synthetic.h"
+#include "utils.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Vector kernels of strcasestr_portable find the same match as the scalar one
+// for random strings at every alignment and tail length, also when the string
+// ends right before an unmapped page
+
+#define ROUNDS 200000
+#define HAYSTACK_MAX 160
+#define NEEDLE_MAX 40
+
+// Letters around the folded range and a UTF-8 sequence, to catch kernels that
+// fold more than ASCII letters
+static const char alphabet[] = "aAbBzZ@[`{-_0\xc3\xa9";
+
+static const char *const kernel_names[] = {
+    [STRCASESTR_SCALAR] = "scalar",
+    [STRCASESTR_SSE2] = "sse2",
+    [STRCASESTR_AVX2] = "avx2",
+};
+#define KERNELS (sizeof(kernel_names) / sizeof(kernel_names[0]))
+
+// Kernel added to utils.h but not here still gets reported
+static const char *kernel_name(STRCASESTR_KERNEL kernel) {
+  return (size_t)kernel < KERNELS ? kernel_names[kernel] : "unknown kernel";
+}
+
+static void random_string(synthetic_rng_t *rng, char *out, size_t len) {
+  for (size_t i = 0; i < len; i++)
+    out[i] = alphabet[synthetic_next(rng) % (sizeof(alphabet) - 1)];
+  out[len] = '\0';
+}
+
+// Needle is mostly cut from the haystack with the case of some letters flipped,
+// so that matches are frequent, else it's random
+static void random_needle(synthetic_rng_t *rng, const char *haystack,
+                          size_t haystack_len, char *out, size_t len) {
+  if (haystack_len < len || synthetic_next(rng) % 4 == 0) {
+    random_string(rng, out, len);
+    return;
+  }
+
+  size_t at = synthetic_next(rng) % (haystack_len - len + 1);
+  for (size_t i = 0; i < len; i++) {
+    char c = haystack[at + i];
+    if (((c | 0x20) >= 'a' && (c | 0x20) <= 'z') && synthetic_next(rng) % 2)
+      c ^= 0x20;
+    out[i] = c;
+  }
+  out[len] = '\0';
+}
+
+static void check_kernels(const char *haystack, const char *needle) {
+  const char *expected = strcasestr_with(STRCASESTR_SCALAR, haystack, needle);
+
+  for (STRCASESTR_KERNEL kernel = STRCASESTR_SSE2;
+       kernel <= strcasestr_kernel(); kernel++) {
+    const char *found = strcasestr_with(kernel, haystack, needle);
+    if (found != expected) {
+      fprintf(stderr, "%s: \"%s\" in \"%s\": offset %td, expected %td\n",
+              kernel_name(kernel), needle, haystack,
+              found ? found - haystack : -1,
+              expected ? expected - haystack : -1);
+      check_failures++;
+    }
+  }
+}
+
+int main(void) {
+  if (strcasestr_kernel() == STRCASESTR_SCALAR) {
+    fprintf(stderr, "no vector kernel on this CPU, skipped\n");
+    return CHECK_SKIP;
+  }
+
+  // Strings are copied to the end of a page followed by an unmapped one, a
+  // kernel reading past the terminating NUL crashes
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  char *pages = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  REQUIRE(pages != MAP_FAILED);
+  REQUIRE(mprotect(pages + page, page, PROT_NONE) == 0);
+
+  char *middle = pages + page / 2, *end = pages + page;
+  synthetic_rng_t rng = {.state = 0x5eed};
+  char haystack[HAYSTACK_MAX + 1], needle[NEEDLE_MAX + 1];
+
+  for (int round = 0; round < ROUNDS && check_failures < 16; round++) {
+    size_t haystack_len = synthetic_next(&rng) % (HAYSTACK_MAX + 1);
+    size_t needle_len = 1 + synthetic_next(&rng) % NEEDLE_MAX;
+    random_string(&rng, haystack, haystack_len);
+    random_needle(&rng, haystack, haystack_len, needle, needle_len);
+
+    // Haystack at every alignment, or the needle, ends at the unmapped page
+    size_t shift = synthetic_next(&rng) % 64;
+    bool at_end = round % 2;
+    char *h = (at_end ? end : middle - shift) - haystack_len - 1;
+    char *n = (at_end ? middle : end) - needle_len - 1;
+    memcpy(h, haystack, haystack_len + 1);
+    memcpy(n, needle, needle_len + 1);
+
+    check_kernels(h, n);
+
+    // Match at the very end of the haystack, where vector blocks don't reach
+    size_t tail = needle_len < haystack_len ? needle_len : haystack_len;
+    check_kernels(h, h + haystack_len - tail);
+  }
+
+  munmap(pages, 2 * page);
+  return check_status("strcasestr");
+}
@@ -0,0 +1,174 @@
+#include "check.h"
+#include "model.h"
+#include "pkg_search.h"
+#include "transaction.h"
+
+#include <linux/limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Mark, resolve and commit against a temporary rootdir and a local
+// repository built with xbps-create and xbps-rindex, nothing is fetched
+
+#define APP "xui-test-app"
+#define LIB "xui-test-lib"
+
+// How long a transaction may take before the test gives up
+#define TIMEOUT_S 60
+
+// Run shell command, returns its exit status or -1
+static int run(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+static int run(const char *format, ...) {
+  char command[4096];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(command, sizeof(command), format, args);
+  va_end(args);
+
+  int status = system(command);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+// Repository holding `APP`, which depends on `LIB`. Returns false if xbps
+// tools aren't installed
+static bool make_repository(const char *dir) {
+  if (run("command -v xbps-create >/dev/null && "
+          "command -v xbps-rindex >/dev/null") != 0)
+    return false;
+
+  REQUIRE(run("mkdir -p %s/repo %s/lib/usr/share/" LIB " %s/app/usr/bin", dir,
+              dir, dir) == 0);
+  REQUIRE(run("echo lib > %s/lib/usr/share/" LIB "/data", dir) == 0);
+  REQUIRE(run("printf '#!/bin/sh\\n' > %s/app/usr/bin/" APP, dir) == 0);
+
+  REQUIRE(run("cd %s/repo && xbps-create -q -A noarch -n " LIB "-1.0_1 "
+              "-s 'xui test library' ../lib",
+              dir) == 0);
+  REQUIRE(run("cd %s/repo && xbps-create -q -A noarch -n " APP "-1.0_1 "
+              "-s 'xui test application' -D '" LIB ">=1.0_1' ../app",
+              dir) == 0);
+  REQUIRE(run("xbps-rindex -a %s/repo/*.xbps >/dev/null", dir) == 0);
+  return true;
+}
+
+// Index of package `pkgname` in the catalog
+static uint32_t find_package(const search_result_t *packages,
+                             const char *pkgname) {
+  size_t len = strlen(pkgname);
+  for (uint32_t i = 0; i < packages->count; i++) {
+    if (packages->packages[i].name_len == len &&
+        strncmp(search_result_pkgver(packages, i), pkgname, len) == 0)
+      return i;
+  }
+
+  return UINT32_MAX;
+}
+
+// Select package in the unfiltered list and mark it, like space does
+static bool mark(model_t *state, const char *pkgname) {
+  uint32_t idx = find_package(state->packages, pkgname);
+  if (idx == UINT32_MAX)
+    return false;
+
+  state->selected_idx = idx;
+  return batch_mark(state);
+}
+
+// Poll transaction like the main loop does, until it leaves `phase`
+static bool wait_past(model_t *state, TRANSACTION_PHASE phase) {
+  time_t deadline = time(NULL) + TIMEOUT_S;
+  while (state->batch.transaction && state->batch.status.phase == phase) {
+    if (time(NULL) > deadline)
+      return false;
+    if (!batch_poll(state))
+      usleep(1000);
+  }
+
+  return true;
+}
+
+static bool installed(model_t *state, const char *pkgname) {
+  return xbps_pkgdb_get_pkg(&state->xhp, pkgname) != NULL;
+}
+
+int main(void) {
+  char dir[] = "/tmp/xui-test-XXXXXX";
+  REQUIRE(mkdtemp(dir));
+  if (!make_repository(dir)) {
+    fprintf(stderr, "xbps-create or xbps-rindex is missing, skipped\n");
+    run("rm -rf %s", dir);
+    return CHECK_SKIP;
+  }
+
+  char root[PATH_MAX], repo[PATH_MAX];
+  snprintf(root, sizeof(root), "%s/root", dir);
+  snprintf(repo, sizeof(repo), "%s/repo", dir);
+  const char *repositories[] = {repo};
+
+  // Model without any planes, as in the benchmarks
+  model_t state = {0};
+  state.config = (search_config_t){.rootdir = root,
+                                   .repositories = repositories,
+                                   .repositories_count = 1};
+  REQUIRE(search_handle_init(&state.xhp, &state.config));
+  state.packages = search_packages(&state.xhp, "", REMOTE, false);
+  REQUIRE(state.packages && state.packages->count == 2);
+
+  state.filtered_indices = malloc(state.packages->count * sizeof(size_t));
+  REQUIRE(state.filtered_indices);
+  for (uint32_t i = 0; i < state.packages->count; i++)
+    state.filtered_indices[i] = i;
+  state.filtered_count = state.packages->count;
+
+  // Mark and resolve, the dependency is pulled in
+  REQUIRE(mark(&state, APP));
+  CHECK(state.batch.marked_count == 1);
+  REQUIRE(batch_submit(&state));
+  REQUIRE(wait_past(&state, TRANSACTION_RESOLVING));
+  REQUIRE(state.batch.status.phase == TRANSACTION_READY);
+
+  const transaction_summary_t *summary =
+      transaction_summary(state.batch.transaction);
+  REQUIRE(summary);
+  CHECK(summary->count == 2);
+  for (uint32_t i = 0; i < summary->count; i++)
+    CHECK(strcmp(transaction_step_label(&summary->steps[i]), "install") == 0);
+
+  // Mark made while it runs survives it
+  batch_answer(&state, true);
+  CHECK(state.batch.status.phase == TRANSACTION_RUNNING);
+  REQUIRE(mark(&state, LIB));
+  REQUIRE(wait_past(&state, TRANSACTION_RUNNING));
+  CHECK(state.batch.status.phase == TRANSACTION_DONE);
+  CHECK(state.batch.status.done == 2);
+  CHECK(state.batch.marked_count == 1);
+  CHECK(batch_marked(&state.batch, find_package(state.packages, LIB)));
+
+  CHECK(installed(&state, APP));
+  CHECK(installed(&state, LIB));
+  CHECK(run("test -f %s/usr/share/" LIB "/data", root) == 0);
+
+  batch_answer(&state, false);
+  CHECK(!state.batch.transaction);
+
+  // Canceling while resolving returns at once, the thread is reaped later
+  REQUIRE(batch_submit(&state));
+  batch_answer(&state, false);
+  CHECK(state.batch.canceled);
+  time_t deadline = time(NULL) + TIMEOUT_S;
+  while (state.batch.transaction && time(NULL) <= deadline) {
+    if (!batch_poll(&state))
+      usleep(1000);
+  }
+  CHECK(!state.batch.transaction);
+
+  model_t_cleanup(&state);
+  run("rm -rf %s", dir);
+  return check_status("transaction");
+}